@@ -1,5 +1,11 @@
 #version 330
 
+// The program is compiled with the definitions of its permutation (see "shader_permutations"), "LightMaterial" only asks for
+// the maps that it has: HAS_ALBEDO, HAS_SPECULAR, HAS_ROUGHNESS, HAS_AO & HAS_EMISSIVE. A missing map is not sampled at all
+// (its value is a constant), and without HAS_SPECULAR the specular term of the lights is not computed.
+// With TEXTURE_ARRAY, the maps are layers of a texture array (see "LightMaterial::textureArray"): every map is read from the
+// same "sampler2DArray" at the layer given by the material, so switching between such materials binds nothing.
+
 #define DIRECTIONAL 0
 #define POINT       1
 #define SPOT        2
@@ -14,25 +20,68 @@ struct Light {
     vec2 cone_angles;       // Cone angles (inner, outer) for spot lights
 };
 
-#define MAX_LIGHTS 50         // Maximum number of lights
-
-uniform Light lights[MAX_LIGHTS];      // Array of lights
-uniform int light_count;               // Number of lights
-
 struct Sky {
     vec3 top, horizon, bottom;         // Sky colors (top, horizon, bottom)
 };
 
-uniform Sky sky;                       // Sky uniform variable
+// The sky colors and the clustering parameters are uploaded by the renderer once per frame into a uniform buffer
+// which is bound to a fixed binding point and shared by every lit shader (the layout matches "LightBlock" in forward-renderer.hpp)
+layout(std140) uniform Lights {
+    Sky sky;                            // Sky colors
+    int light_count;                    // Number of lights in "light_data"
+    int global_light_count;             // The first lights in "light_data" affect every fragment (e.g. directional lights)
+    vec2 viewport_size;                 // The size of the viewport in pixels
+    ivec4 cluster_count;                // The number of clusters along x, y (screen) and z (depth)
+    vec4 cluster_depth;                 // x: scale, y: bias, z: 1 if the depth slices are logarithmic
+    vec4 view_depth;                    // dot(view_depth, vec4(world, 1)) is the distance along the camera forward direction
+};
+
+// The lights are stored in buffer textures so that there is no limit on their number (see "LightClusters" in light-clusters.hpp)
+uniform samplerBuffer light_data;       // 5 texels per light
+uniform usamplerBuffer light_grid;      // (offset, count) of the light list of every cluster
+uniform usamplerBuffer light_indices;   // The light lists of all the clusters
+
+// Reads the light at the given index from the light buffer texture
+Light fetch_light(int index) {
+    int base = index * 5;
+    vec4 position_type = texelFetch(light_data, base);
+    vec4 direction_inner = texelFetch(light_data, base + 1);
+    vec4 diffuse_outer = texelFetch(light_data, base + 2);
+    Light light;
+    light.type = int(position_type.w);
+    light.position = position_type.xyz;
+    light.direction = direction_inner.xyz;
+    light.diffuse = diffuse_outer.xyz;
+    light.specular = texelFetch(light_data, base + 3).xyz;
+    light.attenuation = texelFetch(light_data, base + 4).xyz;
+    light.cone_angles = vec2(direction_inner.w, diffuse_outer.w);
+    return light;
+}
 
 struct Material {
+#ifdef TEXTURE_ARRAY
+    sampler2DArray maps;                // The texture array that holds all the maps
+    int albedo;                         // Layer of the albedo map
+    int specular;                       // Layer of the specular map
+    int roughness;                      // Layer of the roughness map
+    int ambient_occlusion;              // Layer of the ambient occlusion map
+    int emissive;                       // Layer of the emissive map
+#else
     sampler2D albedo;                   // Albedo texture
     sampler2D specular;                 // Specular texture
     sampler2D roughness;                // Roughness texture
     sampler2D ambient_occlusion;        // Ambient occlusion texture
     sampler2D emissive;                 // Emissive texture
+#endif
 };
 
+// Reads the given map of the material at the texture coordinates of the fragment
+#ifdef TEXTURE_ARRAY
+#define SAMPLE_MAP(map) texture(material.maps, vec3(fs_in.tex_coord, material.map))
+#else
+#define SAMPLE_MAP(map) texture(material.map, fs_in.tex_coord)
+#endif
+
 uniform Material material;              // Material uniform variable
 
 in Varyings {
@@ -58,6 +107,56 @@ vec3 compute_sky_light(vec3 normal){
     return mix(sky.horizon, extreme, normal.y * normal.y);
 }
 
+// Computes the diffuse & specular contribution of the given light to the current fragment
+vec3 compute_light(Light light, vec3 normal, vec3 view, vec3 material_diffuse, vec3 material_specular, float shininess) {
+    vec3 world_to_light_dir;
+    // Attenuation factor, initially set to 1.0
+    float attenuation = 1.0;
+
+    if(light.type == DIRECTIONAL){
+        // Set the world-to-light direction as the opposite of the light direction
+        world_to_light_dir = -light.direction;
+    } else {
+        world_to_light_dir = light.position - fs_in.world;
+        // Compute the distance between the fragment and the light
+        float d = length(world_to_light_dir);
+        // Normalize the world-to-light direction
+        world_to_light_dir /= d;
+
+        // Compute the attenuation factor based on the distance and attenuation coefficients
+        attenuation = 1.0 / dot(light.attenuation, vec3(d*d, d, 1.0));
+
+        if(light.type == SPOT) {
+            // Compute the angle between the light direction and the opposite of the world-to-light direction
+            float angle = acos(dot(light.direction, -world_to_light_dir));
+            attenuation *= smoothstep(light.cone_angles.y, light.cone_angles.x, angle);
+        }
+    }
+
+    // Compute the diffuse light contribution using Lambertian reflection model
+    vec3 computed_diffuse = light.diffuse * material_diffuse * lambert(normal, world_to_light_dir);
+
+#ifdef HAS_SPECULAR
+    // Compute the reflection direction of the light
+    vec3 reflected = reflect(-world_to_light_dir, normal);
+    // Compute the specular light contribution using the Phong reflection model
+    vec3 computed_specular = light.specular * material_specular * phong(reflected, view, shininess);
+
+    return (computed_diffuse + computed_specular) * attenuation;
+#else
+    return computed_diffuse * attenuation;
+#endif
+}
+
+// Returns the index of the cluster that contains the current fragment
+int find_cluster() {
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / viewport_size * vec2(cluster_count.xy)), ivec2(0), cluster_count.xy - 1);
+    float depth = dot(view_depth, vec4(fs_in.world, 1.0));
+    float slice = (cluster_depth.z > 0.5 ? log(max(depth, 1e-6)) : depth) * cluster_depth.x + cluster_depth.y;
+    int z = clamp(int(floor(slice)), 0, cluster_count.z - 1);
+    return tile.x + cluster_count.x * (tile.y + cluster_count.y * z);
+}
+
 void main() {
     vec3 normal = normalize(fs_in.normal);      // Normalize the interpolated normal vector
     vec3 view = normalize(fs_in.view);          // Normalize the interpolated view vector
@@ -65,60 +164,54 @@ void main() {
 		// Compute the ambient light contribution based on the sky color and normal
     vec3 ambient_light = compute_sky_light(normal);
 
-		// Fetch the diffuse color from the albedo texture
-    vec3 material_diffuse = texture(material.albedo, fs_in.tex_coord).rgb;
+		// Fetch the diffuse color from the albedo texture (white without one)
+#ifdef HAS_ALBEDO
+    vec3 material_diffuse = SAMPLE_MAP(albedo).rgb;
+#else
+    vec3 material_diffuse = vec3(1.0);
+#endif
+#ifdef HAS_SPECULAR
 		// Fetch the specular color from the specular texture
-    vec3 material_specular = texture(material.specular, fs_in.tex_coord).rgb;
-		// Fetch the roughness value from the roughness texture
-    float material_roughness = texture(material.roughness, fs_in.tex_coord).r;
-		// Fetch the ambient color from the ambient occlusion texture
-    vec3 material_ambient = material_diffuse * texture(material.ambient_occlusion, fs_in.tex_coord).r;
-		// Fetch the emissive color from the emissive texture
-    vec3 material_emissive = texture(material.emissive, fs_in.tex_coord).rgb;
-
+    vec3 material_specular = SAMPLE_MAP(specular).rgb;
+		// Fetch the roughness value from the roughness texture (fully rough without one)
+#ifdef HAS_ROUGHNESS
+    float material_roughness = SAMPLE_MAP(roughness).r;
+#else
+    float material_roughness = 1.0;
+#endif
 		// Calculate the shininess factor based on the roughness
     float shininess = 2.0 / pow(clamp(material_roughness, 0.001, 0.999), 4.0) - 2.0;
+#else
+    // Without a specular map, the material has no highlights (so the roughness is not needed either)
+    vec3 material_specular = vec3(0.0);
+    float shininess = 0.0;
+#endif
+		// Fetch the ambient color from the ambient occlusion texture (not occluded without one)
+#ifdef HAS_AO
+    vec3 material_ambient = material_diffuse * SAMPLE_MAP(ambient_occlusion).r;
+#else
+    vec3 material_ambient = material_diffuse;
+#endif
+		// Fetch the emissive color from the emissive texture (black without one)
+#ifdef HAS_EMISSIVE
+    vec3 material_emissive = SAMPLE_MAP(emissive).rgb;
+#else
+    vec3 material_emissive = vec3(0.0);
+#endif
     
 		// Initialize the fragment color with the emissive and ambient light contributions
     vec3 color = material_emissive + ambient_light * material_ambient;
 
-    vec3 world_to_light_dir;
-
-    for(int light_idx = 0; light_idx < min(MAX_LIGHTS, light_count); light_idx++){
-				// Fetch the current light from the lights array
-        Light light = lights[light_idx];
-				// Attenuation factor, initially set to 1.0
-        float attenuation = 1.0;
-        
-        if(light.type == DIRECTIONAL){
-						// Set the world-to-light direction as the opposite of the light direction
-            world_to_light_dir = -light.direction;
-        } else {
-            world_to_light_dir = light.position - fs_in.world;
-						// Compute the distance between the fragment and the light
-            float d = length(world_to_light_dir);
-						// Normalize the world-to-light direction
-            world_to_light_dir /= d;
-
-						 // Compute the attenuation factor based on the distance and attenuation coefficients
-            attenuation = 1.0 / dot(light.attenuation, vec3(d*d, d, 1.0));
-
-            if(light.type == SPOT) {
-								// Compute the angle between the light direction and the opposite of the world-to-light direction
-                float angle = acos(dot(light.direction, -world_to_light_dir));
-                attenuation *= smoothstep(light.cone_angles.y, light.cone_angles.x, angle);
-            }
-        }
-
-				// Compute the diffuse light contribution using Lambertian reflection model
-        vec3 computed_diffuse = light.diffuse * material_diffuse * lambert(normal, world_to_light_dir);
-
-				// Compute the reflection direction of the light
-        vec3 reflected = reflect(-world_to_light_dir, normal);
-				// Compute the specular light contribution using the Phong reflection model
-        vec3 computed_specular = light.specular * material_specular * phong(reflected, view, shininess);
+    // The global lights affect every fragment
+    for(int light_idx = 0; light_idx < global_light_count; light_idx++){
+        color += compute_light(fetch_light(light_idx), normal, view, material_diffuse, material_specular, shininess);
+    }
 
-        color += (computed_diffuse + computed_specular) * attenuation; 
+    // Then we only shade the lights that were assigned to the cluster of this fragment
+    uvec2 cluster_lights = texelFetch(light_grid, find_cluster()).xy;
+    for(uint i = 0u; i < cluster_lights.y; i++){
+        int light_idx = int(texelFetch(light_indices, int(cluster_lights.x + i)).x);
+        color += compute_light(fetch_light(light_idx), normal, view, material_diffuse, material_specular, shininess);
     }
     
     frag_color = vec4(color, 1.0); 		// Set the fragment color
@@ -1,14 +1,24 @@
 #version 330
 
+// The program is compiled with the definitions of its permutation (see "shader_permutations"):
+// with INSTANCED, the model matrix and its inverse transpose are per instance attributes instead of uniforms,
+// so many objects that share the same mesh & material can be drawn by a single draw call
+
 layout(location = 0) in vec3 position;       // Vertex position attribute
 layout(location = 1) in vec4 color;          // Vertex color attribute
 layout(location = 2) in vec2 tex_coord;      // Texture coordinates attribute
 layout(location = 3) in vec3 normal;         // Vertex normal attribute
+#ifdef INSTANCED
+layout(location = 4) in mat4 M;              // Model matrix of the instance (locations 4 to 7)
+layout(location = 8) in mat4 M_IT;           // Inverse-transpose of the model matrix of the instance (locations 8 to 11)
+#endif
 
 uniform mat4 VP;                            // View-projection matrix
 uniform vec3 eye;               						// Position of the camera (eye)
+#ifndef INSTANCED
 uniform mat4 M;                             // Model matrix
 uniform mat4 M_IT;                          // Inverse-transpose of the model matrix
+#endif
 
 out Varyings {
     vec4 color;                             // Color to be passed to the fragment shader
@@ -0,0 +1,18 @@
+#version 330 core
+
+// The variant of "textured.frag" for the materials whose texture is a layer of a texture array (see "TexturedMaterial::textureArray")
+
+in Varyings {
+    vec4 color;
+    vec2 tex_coord;
+} fs_in;
+
+out vec4 frag_color;
+
+uniform vec4 tint;
+uniform sampler2DArray tex;
+uniform int layer;
+
+void main(){
+    frag_color = tint * fs_in.color * texture(tex, vec3(fs_in.tex_coord, layer));
+}
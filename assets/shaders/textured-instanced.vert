@@ -0,0 +1,22 @@
+#version 330 core
+
+// The instanced variant of "textured.vert": the model matrix is a per instance attribute instead of being part of a uniform,
+// so many objects that share the same mesh & material can be drawn by a single draw call
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec4 color;
+layout(location = 2) in vec2 tex_coord;
+layout(location = 4) in mat4 M;             // The model matrix of the instance (locations 4 to 7)
+
+out Varyings {
+    vec4 color;
+    vec2 tex_coord;
+} vs_out;
+
+uniform mat4 VP;
+
+void main(){
+    gl_Position = VP * (M * vec4(position, 1.0));
+    vs_out.color = color;
+    vs_out.tex_coord = tex_coord;
+}
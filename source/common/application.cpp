@@ -23,6 +23,9 @@
 #endif
 
 #include "texture/screenshot.hpp"
+#include "gl-state-cache.hpp"
+#include "asset-streamer.hpp"
+#include "shader/program-cache.hpp"
 
 std::string default_screenshot_filepath() {
     std::stringstream stream;
@@ -196,6 +199,9 @@ int our::Application::run(int run_for_frames) {
     glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
 
+    // "programCache" (optional, default=false) loads the linked shader programs from binaries saved by the previous runs (see "program_cache")
+    our::program_cache::configure(app_config.value("programCache", false));
+
     setupCallbacks();
     keyboard.enable(window);
     mouse.enable(window);
@@ -233,7 +239,11 @@ int our::Application::run(int run_for_frames) {
         nextState = nullptr;
     }
     // Call onInitialize if the scene needs to do some custom initialization (such as file loading, object creation, etc).
+    // We measure the time it takes & the time till the first frame is shown, since it is what the player waits for before seeing anything
+    double initialize_start_time = glfwGetTime();
     if(currentState) currentState->onInitialize();
+    double initialize_time = glfwGetTime() - initialize_start_time;
+    our::program_cache::report();
 
     // The time at which the last frame started. But there was no frames yet, so we'll just pick the current time.
     double last_frame_time = glfwGetTime();
@@ -264,6 +274,9 @@ int our::Application::run(int run_for_frames) {
         auto frame_buffer_size = getFrameBufferSize();
         glViewport(0, 0, frame_buffer_size.x, frame_buffer_size.y);
 
+        // Apply the assets that finished loading in the background (within the upload budget of a frame)
+        our::AssetStreamer::get().processUploads();
+
         // Get the current time (the time at which we are starting the current frame).
         double current_frame_time = glfwGetTime();
 
@@ -277,6 +290,8 @@ int our::Application::run(int run_for_frames) {
         glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
 #endif
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData()); // Render the ImGui to the framebuffer
+        // ImGui changes the program, the textures, the blending and more without going through the state cache, so the cache forgets everything
+        our::GLStateCache::get().invalidate();
 #if defined(ENABLE_OPENGL_DEBUG_MESSAGES)
         // Re-enable the debug messages
         glEnable(GL_DEBUG_OUTPUT);
@@ -308,6 +323,11 @@ int our::Application::run(int run_for_frames) {
         // Swap the frame buffers
         glfwSwapBuffers(window);
 
+        if(current_frame == 0){
+            std::cout << "Time to first frame: " << (glfwGetTime() - initialize_start_time) * 1000.0 << " ms ("
+                      << initialize_time * 1000.0 << " ms in onInitialize)" << std::endl;
+        }
+
         // Update the keyboard and mouse data
         keyboard.update();
         mouse.update();
@@ -321,6 +341,7 @@ int our::Application::run(int run_for_frames) {
             nextState = nullptr;
             // Initialize the new scene
             currentState->onInitialize();
+            our::program_cache::report();
         }
 
         ++current_frame;
@@ -1,7 +1,10 @@
 #include "asset-loader.hpp"
+#include "asset-streamer.hpp"
 
 #include "shader/shader.hpp"
+#include "shader/shader-permutations.hpp"
 #include "texture/texture2d.hpp"
+#include "texture/texture-array.hpp"
 #include "texture/texture-utils.hpp"
 #include "texture/sampler.hpp"
 #include "mesh/mesh.hpp"
@@ -9,6 +12,11 @@
 #include "material/material.hpp"
 #include "deserialize-utils.hpp"
 
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <vector>
+
 namespace our {
 
     // This will load all the shaders defined in "data"
@@ -35,13 +43,95 @@ namespace our {
     template<>
     void AssetLoader<Texture2D>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
+            AssetStreamer& streamer = AssetStreamer::get();
             for(auto& [name, desc] : data.items()){
                 std::string path = desc.get<std::string>();
-                assets[name] = texture_utils::loadImage(path);
+                if(!streamer.isEnabled()){
+                    assets[name] = texture_utils::loadImage(path);
+                    continue;
+                }
+                // The texture is a grey pixel until its image is decoded on a worker and uploaded by the OpenGL thread
+                Texture2D* texture = new Texture2D();
+                texture_utils::fillPlaceholder(texture);
+                assets[name] = texture;
+                streamer.submit([texture, path]() -> AssetUpload {
+                    texture_utils::Image image;
+                    if(!texture_utils::decodeImage(path, image)) return {};
+                    return {[texture, image]{ texture_utils::uploadImage(texture, image); }, image.getByteCount()};
+                });
             }
         }
     };
 
+    // Prints the memory of every texture (largest first) and the total
+    template<>
+    size_t AssetLoader<Texture2D>::reportMemoryUsage() {
+        std::vector<std::pair<size_t, std::string>> textures;
+        size_t total = 0;
+        for(auto& [name, texture] : assets){
+            textures.emplace_back(texture->getByteCount(), name);
+            total += texture->getByteCount();
+        }
+        std::sort(textures.begin(), textures.end(), std::greater<>());
+        std::cout << "Texture memory: " << total / (1024.0 * 1024.0) << " MB in " << textures.size() << " textures" << std::endl;
+        for(auto& [bytes, name] : textures)
+            std::cout << "  " << name << ": " << bytes / 1024.0 << " KB" << std::endl;
+        return total;
+    }
+
+    // This will load all the texture arrays defined in "data"
+    // data must be in the form:
+    //    { array_name : { "size": {"width": ..., "height": ...}, "layers": { layer_name : "path/to/image", ... } }, ... }
+    // The images are resized to the size of the array, and the materials refer to the layers by their names (see "LightMaterial")
+    template<>
+    void AssetLoader<TextureArray>::deserialize(const nlohmann::json& data) {
+        if(data.is_object()){
+            AssetStreamer& streamer = AssetStreamer::get();
+            for(auto& [name, desc] : data.items()){
+                if(!desc.is_object() || !desc.contains("layers")) continue;
+                glm::ivec2 size(1024, 1024);
+                if(auto it = desc.find("size"); it != desc.end()){
+                    size.x = std::max(1, it->value("width", size.x));
+                    size.y = std::max(1, it->value("height", size.y));
+                }
+                std::vector<std::string> layerNames, paths;
+                for(auto& [layerName, path] : desc["layers"].items()){
+                    layerNames.push_back(layerName);
+                    paths.push_back(path.get<std::string>());
+                }
+                if(!streamer.isEnabled()){
+                    TextureArray* array = texture_utils::loadArray(paths, size);
+                    array->setLayerNames(layerNames);
+                    assets[name] = array;
+                    continue;
+                }
+                // Like the textures, the layers are grey until their images are decoded & resized on a worker
+                TextureArray* array = new TextureArray();
+                array->setLayerNames(layerNames);
+                texture_utils::fillArrayPlaceholder(array, (int)layerNames.size());
+                assets[name] = array;
+                streamer.submit([array, paths, size]() -> AssetUpload {
+                    auto layers = std::make_shared<std::vector<texture_utils::Image>>(texture_utils::decodeArrayLayers(paths, size));
+                    size_t bytes = 0;
+                    for(const auto& layer : *layers) bytes += layer.getByteCount();
+                    return {[array, layers]{ texture_utils::uploadArray(array, *layers); }, bytes};
+                });
+            }
+        }
+    };
+
+    // Prints the memory of every texture array and returns their total
+    template<>
+    size_t AssetLoader<TextureArray>::reportMemoryUsage() {
+        size_t total = 0;
+        for(auto& [name, array] : assets){
+            std::cout << "Texture array memory: " << name << ": " << array->getByteCount() / (1024.0 * 1024.0) << " MB in "
+                      << array->getLayerCount() << " layers" << std::endl;
+            total += array->getByteCount();
+        }
+        return total;
+    }
+
     // This will load all the samplers defined in "data"
     // data must be in the form:
     //    { sampler_name : parameters, ... }
@@ -66,9 +156,25 @@ namespace our {
     template<>
     void AssetLoader<Mesh>::deserialize(const nlohmann::json& data) {
         if(data.is_object()){
+            AssetStreamer& streamer = AssetStreamer::get();
+            // The static models are put in the mesh arena (if it is enabled) so that they share a single vertex array
+            MeshArena* arena = MeshArena::get().isEnabled() ? &MeshArena::get() : nullptr;
             for(auto& [name, desc] : data.items()){
                 std::string path = desc.get<std::string>();
-                assets[name] = mesh_utils::loadOBJ(path);
+                if(!streamer.isEnabled()){
+                    assets[name] = mesh_utils::loadOBJ(path, arena);
+                    continue;
+                }
+                // The mesh is empty (draws nothing) until its file is parsed on a worker and its data is uploaded by the OpenGL thread
+                Mesh* mesh = new Mesh();
+                assets[name] = mesh;
+                streamer.submit([mesh, path, arena]() -> AssetUpload {
+                    auto vertices = std::make_shared<std::vector<Vertex>>();
+                    auto elements = std::make_shared<std::vector<GLuint>>();
+                    if(!mesh_utils::readOBJ(path, *vertices, *elements)) return {};
+                    size_t bytes = vertices->size() * sizeof(Vertex) + elements->size() * sizeof(GLuint);
+                    return {[mesh, vertices, elements, arena]{ mesh->setData(*vertices, *elements, arena); }, bytes};
+                });
             }
         }
     };
@@ -99,24 +205,48 @@ namespace our {
 
     void deserializeAllAssets(const nlohmann::json& assetData){
         if(!assetData.is_object()) return;
+        // "async" (optional, default=false) loads the textures, the texture arrays & the meshes in the background (see "AssetStreamer").
+        // It must be configured before any loader runs, otherwise the first scene would decode its textures on this thread
+        // (and the next scenes would use the setting of the previous one).
+        AssetStreamer::get().configure(assetData);
         if(assetData.contains("shaders"))
             AssetLoader<ShaderProgram>::deserialize(assetData["shaders"]);
+        // "compressedTextures" (optional, default=false) loads the textures from their cooked block compressed mip chains (made by the texture cooker)
+        texture_compression::setEnabled(assetData.value("compressedTextures", false));
         if(assetData.contains("textures"))
             AssetLoader<Texture2D>::deserialize(assetData["textures"]);
+        if(assetData.contains("textureArrays"))
+            AssetLoader<TextureArray>::deserialize(assetData["textureArrays"]);
         if(assetData.contains("samplers"))
             AssetLoader<Sampler>::deserialize(assetData["samplers"]);
+        // "meshArena" (optional, default=false) puts all the meshes in a single vertex & element buffer (see "MeshArena")
+        MeshArena::get().setEnabled(assetData.value("meshArena", false));
+        // "meshCache" (optional, default=false) loads the models from their binary cache (written next to them the first time they are parsed)
+        mesh_cache::setEnabled(assetData.value("meshCache", false));
         if(assetData.contains("meshes"))
             AssetLoader<Mesh>::deserialize(assetData["meshes"]);
         if(assetData.contains("materials"))
             AssetLoader<Material>::deserialize(assetData["materials"]);
+        if(size_t permutationCount = shader_permutations::getCount(); permutationCount > 0)
+            std::cout << "Shader permutations: " << permutationCount << " programs" << std::endl;
+        // The streamed textures are still placeholders at this point, so the memory is reported once they are uploaded
+        AssetStreamer::get().whenIdle([]{
+            AssetLoader<Texture2D>::reportMemoryUsage();
+            AssetLoader<TextureArray>::reportMemoryUsage();
+        });
     }
 
     void clearAllAssets(){
+        // The loads that are still running point to the assets, so they must be stopped first
+        AssetStreamer::get().cancel();
         AssetLoader<ShaderProgram>::clear();
         AssetLoader<Texture2D>::clear();
+        AssetLoader<TextureArray>::clear();
         AssetLoader<Sampler>::clear();
         AssetLoader<Mesh>::clear();
         AssetLoader<Material>::clear();
+        // The permutations are made by the materials, so they go with them
+        shader_permutations::clear();
     }
 
 }
\ No newline at end of file
@@ -32,6 +32,9 @@ namespace our {
             }
             return nullptr;
         };
+        // Prints the GPU memory taken by every asset and their total, and returns the total in bytes.
+        // It is only defined for the asset types that know their memory (see the specialization for Texture2D in "asset-loader.cpp")
+        static size_t reportMemoryUsage();
         // This function deletes all the assets held by this class and clear the assets map 
         static void clear(){
             for(auto& [name, asset] : assets){
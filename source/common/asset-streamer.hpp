@@ -0,0 +1,128 @@
+#pragma once
+
+#include "thread-pool.hpp"
+
+#include <json/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace our {
+
+    // The result of a background load: a function that moves the loaded data into its asset (it runs on the OpenGL thread)
+    // and the number of bytes it uploads (counted against the upload budget of the frame).
+    // An empty "apply" means the load failed (the asset keeps its placeholder).
+    struct AssetUpload {
+        std::function<void()> apply;
+        size_t bytes = 0;
+    };
+
+    // The asset streamer loads the assets in the background so that the first frame does not wait for every file.
+    // The loader creates every asset as a placeholder right away (so the pointers given by "AssetLoader<T>::get" never change)
+    // and submits a job that decodes or parses the file on a worker thread. The job returns an "AssetUpload" which is pushed to
+    // a lock-free queue, and every frame the OpenGL thread applies the ready uploads until the frame budget (milliseconds & bytes) is spent.
+    class AssetStreamer {
+        std::unique_ptr<ThreadPool> pool;
+        MPSCQueue<AssetUpload> uploads;
+        std::atomic<size_t> pendingCount{0}; // The submitted loads whose upload was not applied yet
+        bool enabled = false;
+        double budgetMilliseconds = 2.0;
+        size_t budgetBytes = 16 << 20;
+        size_t version = 0;                  // The number of applied uploads (see "getVersion")
+        size_t streamedCount = 0;            // The number of loads since the streamer became busy (for the final report)
+        std::chrono::high_resolution_clock::time_point streamStart;
+        std::vector<std::function<void()>> idleCallbacks; // Run once the pending loads are all applied (see "whenIdle")
+
+        AssetStreamer() = default;
+
+        void runIdleCallbacks() {
+            auto callbacks = std::move(idleCallbacks);
+            idleCallbacks.clear();
+            for(auto& callback : callbacks) callback();
+        }
+    public:
+        // Returns the streamer of the application
+        static AssetStreamer& get() {
+            static AssetStreamer streamer;
+            return streamer;
+        }
+
+        // Reads the options of the streamer from the assets config:
+        //      "async" (optional, default=false): whether the textures & meshes are loaded in the background
+        //      "uploadBudget" (optional): {"milliseconds": ..., "bytes": ...} the most upload work done in a single frame
+        void configure(const nlohmann::json& data) {
+            enabled = data.value("async", false);
+            if(auto it = data.find("uploadBudget"); it != data.end() && it->is_object()){
+                budgetMilliseconds = it->value("milliseconds", budgetMilliseconds);
+                budgetBytes = it->value("bytes", budgetBytes);
+            }
+        }
+
+        // Returns whether the asset loader should load in the background
+        bool isEnabled() const { return enabled; }
+
+        // Runs "load" on a worker thread then queues the upload it returns. Must be called from the OpenGL thread.
+        void submit(std::function<AssetUpload()> load) {
+            if(!pool) pool = std::make_unique<ThreadPool>();
+            if(pendingCount.fetch_add(1) == 0){
+                streamStart = std::chrono::high_resolution_clock::now();
+                streamedCount = 0;
+            }
+            streamedCount++;
+            pool->submit([this, load = std::move(load)]{ uploads.push(load()); });
+        }
+
+        // Applies the ready uploads, stopping once the time or the byte budget of the frame is spent
+        // (at least one upload is applied per call, so a big asset cannot stall the queue). Returns the number of applied uploads.
+        size_t processUploads() {
+            if(pendingCount.load() == 0) return 0;
+            auto start = std::chrono::high_resolution_clock::now();
+            size_t applied = 0, bytes = 0;
+            AssetUpload upload;
+            while(uploads.pop(upload)){
+                if(upload.apply) upload.apply();
+                bytes += upload.bytes;
+                applied++;
+                version++;
+                if(pendingCount.fetch_sub(1) == 1){
+                    double total = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - streamStart).count();
+                    std::cout << "Streamed " << streamedCount << " assets in " << total << " ms" << std::endl;
+                    runIdleCallbacks();
+                    break;
+                }
+                double elapsed = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+                if(elapsed >= budgetMilliseconds || bytes >= budgetBytes) break;
+            }
+            return applied;
+        }
+
+        // Waits for the running loads and drops their uploads. It must be called before the assets are deleted
+        // since the queued uploads still point to them.
+        void cancel() {
+            if(pool) pool->wait();
+            AssetUpload upload;
+            while(uploads.pop(upload)) pendingCount--;
+            idleCallbacks.clear();
+        }
+
+        // Runs the callback once every submitted load is applied (right away if none is pending), e.g. to report what the loaded assets take.
+        // Must be called from the OpenGL thread.
+        void whenIdle(std::function<void()> callback) {
+            idleCallbacks.push_back(std::move(callback));
+            if(pendingCount.load() == 0) runIdleCallbacks();
+        }
+
+        // Returns the number of loads that are not applied yet
+        size_t getPendingCount() const { return pendingCount.load(); }
+        // Returns a number that changes whenever an upload is applied (e.g. the renderer rebuilds anything that depends on the mesh bounds)
+        size_t getVersion() const { return version; }
+
+        AssetStreamer(const AssetStreamer&) = delete;
+        AssetStreamer& operator=(const AssetStreamer&) = delete;
+    };
+
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+namespace our {
+
+    // An axis aligned bounding box defined by its min & max corners
+    struct AABB {
+        glm::vec3 min = glm::vec3(0), max = glm::vec3(0);
+
+        // Returns whether the two boxes overlap (touching counts as overlapping)
+        bool overlaps(const AABB& other) const {
+            return max.x >= other.min.x && min.x <= other.max.x &&
+                   max.y >= other.min.y && min.y <= other.max.y &&
+                   max.z >= other.min.z && min.z <= other.max.z;
+        }
+
+        // Returns the box that contains this box after it is transformed by the given matrix
+        // (its half extents are the absolute matrix times the half extents of this box)
+        AABB transformed(const glm::mat4& matrix) const {
+            glm::vec3 center = glm::vec3(matrix * glm::vec4((min + max) * 0.5f, 1.0f));
+            glm::vec3 extent = (max - min) * 0.5f;
+            extent = glm::abs(glm::vec3(matrix[0])) * extent.x
+                   + glm::abs(glm::vec3(matrix[1])) * extent.y
+                   + glm::abs(glm::vec3(matrix[2])) * extent.z;
+            return {center - extent, center + extent};
+        }
+    };
+
+}
@@ -0,0 +1,176 @@
+#include "collider.hpp"
+#include "../ecs/entity.hpp"
+#include "../deserialize-utils.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <unordered_map>
+
+namespace our {
+
+    // Returns the bit of the collision layer with the given name (the layers are numbered the first time they are seen, at most 32)
+    uint32_t getCollisionLayer(const std::string& name) {
+        static std::unordered_map<std::string, uint32_t> layers;
+        if(auto it = layers.find(name); it != layers.end()) return it->second;
+        if(layers.size() >= 32){
+            std::cerr << "Too many collision layers, the layer \"" << name << "\" will not collide with anything" << std::endl;
+            return 0;
+        }
+        uint32_t bit = 1u << layers.size();
+        layers[name] = bit;
+        return bit;
+    }
+
+    // Reads a layer mask from a json value that could be a single layer name or an array of layer names
+    static uint32_t readLayers(const nlohmann::json& data, uint32_t defaultMask) {
+        if(data.is_string()) return getCollisionLayer(data.get<std::string>());
+        if(!data.is_array()) return defaultMask;
+        uint32_t mask = 0;
+        for(auto& name : data) if(name.is_string()) mask |= getCollisionLayer(name.get<std::string>());
+        return mask;
+    }
+
+    // Reads the collider parameters from the given json object
+    void ColliderComponent::deserialize(const nlohmann::json& data){
+        if(!data.is_object()) return;
+        std::string shapeName = data.value("shape", "box");
+        if(shapeName == "sphere") shape = ColliderShape::SPHERE;
+        else if(shapeName == "capsule") shape = ColliderShape::CAPSULE;
+        else shape = ColliderShape::BOX;
+        offset = data.value("offset", offset);
+        size = data.value("size", size);
+        radius = data.value("radius", radius);
+        height = data.value("height", height);
+        scaleWithEntity = data.value("scaleWithEntity", scaleWithEntity);
+        padding = data.value("padding", padding);
+        if(data.contains("layer")) layer = readLayers(data["layer"], layer);
+        if(data.contains("collidesWith")) collidesWith = readLayers(data["collidesWith"], collidesWith);
+        trigger = data.value("trigger", trigger);
+        isStatic = data.value("static", isStatic);
+        // Force the world space shape to be recomputed with the new parameters
+        cachedWorldVersion = 0;
+    }
+
+    // Recomputes the cached world space shape if the entity moved
+    void ColliderComponent::refresh() const {
+        const glm::mat4& localToWorld = getOwner()->getLocalToWorldMatrix();
+        if(cachedWorldVersion == getOwner()->getWorldVersion()) return;
+        cachedWorldVersion = getOwner()->getWorldVersion();
+
+        glm::vec3 scale = glm::vec3(glm::length(localToWorld[0]), glm::length(localToWorld[1]), glm::length(localToWorld[2]));
+        glm::vec3 sizeScale = scaleWithEntity ? scale : glm::vec3(1.0f);
+        // A hidden entity (scaled to zero) should not collide with anything
+        active = !scaleWithEntity || (scale.x > 0 && scale.y > 0 && scale.z > 0);
+
+        worldCenter = glm::vec3(localToWorld * glm::vec4(offset, 1.0f));
+        switch(shape){
+        case ColliderShape::BOX: {
+            glm::vec3 halfSize = size * sizeScale + padding;
+            worldBounds = {worldCenter - halfSize, worldCenter + halfSize};
+            worldRadius = 0;
+            break;
+        }
+        case ColliderShape::SPHERE:
+            worldRadius = radius * std::max(sizeScale.x, std::max(sizeScale.y, sizeScale.z));
+            worldBounds = {worldCenter - worldRadius, worldCenter + worldRadius};
+            break;
+        case ColliderShape::CAPSULE: {
+            // The capsule keeps its radius round, so it is scaled by the larger of the scales across its axis
+            worldRadius = radius * std::max(sizeScale.x, sizeScale.z);
+            glm::vec3 axis = scale.y > 0 ? glm::vec3(localToWorld[1]) / scale.y : glm::vec3(0, 1, 0);
+            glm::vec3 halfSegment = axis * (0.5f * height * sizeScale.y);
+            worldSegment[0] = worldCenter - halfSegment;
+            worldSegment[1] = worldCenter + halfSegment;
+            worldBounds = {glm::min(worldSegment[0], worldSegment[1]) - worldRadius, glm::max(worldSegment[0], worldSegment[1]) + worldRadius};
+            break;
+        }
+        }
+    }
+
+    // Returns the point on the segment [a, b] that is closest to the point p
+    static glm::vec3 closestPointOnSegment(const glm::vec3& p, const glm::vec3& a, const glm::vec3& b) {
+        glm::vec3 ab = b - a;
+        float lengthSquared = glm::dot(ab, ab);
+        if(lengthSquared <= 0.0f) return a;
+        float t = glm::clamp(glm::dot(p - a, ab) / lengthSquared, 0.0f, 1.0f);
+        return a + t * ab;
+    }
+
+    // Returns the squared distance between the closest points of the segments [a0, a1] and [b0, b1]
+    static float segmentDistanceSquared(const glm::vec3& a0, const glm::vec3& a1, const glm::vec3& b0, const glm::vec3& b1) {
+        glm::vec3 d1 = a1 - a0, d2 = b1 - b0, r = a0 - b0;
+        float a = glm::dot(d1, d1), e = glm::dot(d2, d2), f = glm::dot(d2, r);
+        float s = 0, t = 0;
+        if(a <= 0.0f && e <= 0.0f){
+            // Both segments are points
+        } else if(a <= 0.0f){
+            t = glm::clamp(f / e, 0.0f, 1.0f);
+        } else {
+            float c = glm::dot(d1, r);
+            if(e <= 0.0f){
+                s = glm::clamp(-c / a, 0.0f, 1.0f);
+            } else {
+                float b = glm::dot(d1, d2);
+                float denominator = a * e - b * b;
+                // If the segments are parallel, any s works, so we start from 0
+                s = denominator > 0.0f ? glm::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+                t = (b * s + f) / e;
+                if(t < 0.0f){
+                    t = 0.0f;
+                    s = glm::clamp(-c / a, 0.0f, 1.0f);
+                } else if(t > 1.0f){
+                    t = 1.0f;
+                    s = glm::clamp((b - c) / a, 0.0f, 1.0f);
+                }
+            }
+        }
+        glm::vec3 difference = (a0 + d1 * s) - (b0 + d2 * t);
+        return glm::dot(difference, difference);
+    }
+
+    // Returns the squared distance between the point and the box
+    static float boxDistanceSquared(const glm::vec3& p, const AABB& box) {
+        glm::vec3 difference = p - glm::clamp(p, box.min, box.max);
+        return glm::dot(difference, difference);
+    }
+
+    // Returns whether the two colliders overlap (the capsule against box test is an approximation)
+    bool ColliderComponent::intersects(const ColliderComponent* other) const {
+        if(!isActive() || !other->isActive()) return false;
+        // The bounds contain the shapes, so if they don't overlap, the shapes don't either (and for two boxes, that is the exact test)
+        if(!worldBounds.overlaps(other->worldBounds)) return false;
+
+        // Order the pair so that we only handle the combinations where a's shape <= b's shape
+        const ColliderComponent* a = this;
+        const ColliderComponent* b = other;
+        if(a->shape > b->shape) std::swap(a, b);
+
+        switch(a->shape){
+        case ColliderShape::BOX:
+            if(b->shape == ColliderShape::BOX) return true;
+            if(b->shape == ColliderShape::SPHERE) return boxDistanceSquared(b->worldCenter, a->worldBounds) <= b->worldRadius * b->worldRadius;
+            {
+                // Capsule against box: we alternate between the closest point on the segment and the closest point in the box.
+                // Two rounds are enough for the boxes & capsules of a game (it could miss by a little at the edges of the box).
+                glm::vec3 point = closestPointOnSegment(a->worldCenter, b->worldSegment[0], b->worldSegment[1]);
+                for(int round = 0; round < 2; round++){
+                    glm::vec3 inBox = glm::clamp(point, a->worldBounds.min, a->worldBounds.max);
+                    point = closestPointOnSegment(inBox, b->worldSegment[0], b->worldSegment[1]);
+                }
+                return boxDistanceSquared(point, a->worldBounds) <= b->worldRadius * b->worldRadius;
+            }
+        case ColliderShape::SPHERE: {
+            float radiusSum = a->worldRadius + b->worldRadius;
+            glm::vec3 target = b->shape == ColliderShape::SPHERE ? b->worldCenter
+                             : closestPointOnSegment(a->worldCenter, b->worldSegment[0], b->worldSegment[1]);
+            glm::vec3 difference = a->worldCenter - target;
+            return glm::dot(difference, difference) <= radiusSum * radiusSum;
+        }
+        case ColliderShape::CAPSULE: {
+            float radiusSum = a->worldRadius + b->worldRadius;
+            return segmentDistanceSquared(a->worldSegment[0], a->worldSegment[1], b->worldSegment[0], b->worldSegment[1]) <= radiusSum * radiusSum;
+        }
+        }
+        return false;
+    }
+}
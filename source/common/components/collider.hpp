@@ -0,0 +1,72 @@
+#pragma once
+
+#include "../ecs/component.hpp"
+#include "../bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+
+namespace our {
+
+    // The shapes a collider could have
+    enum class ColliderShape {
+        BOX,    // An axis aligned box (the rotation of the entity is ignored, so the box never grows when the entity spins)
+        SPHERE, // A sphere
+        CAPSULE // A cylinder with hemispherical ends along the local Y axis
+    };
+
+    // Returns the bit of the collision layer with the given name (the layers are numbered the first time they are seen, at most 32)
+    uint32_t getCollisionLayer(const std::string& name);
+
+    // This component gives the owning entity a shape that the systems can test for collisions (see "common/systems/crashing.hpp").
+    // The layers decide which colliders interact: two colliders are tested only if each one's layer is in the other's "collidesWith" mask,
+    // so the systems filter the pairs with bit operations instead of comparing names.
+    // The world space shape is cached and only recomputed when the local to world matrix of the entity changes.
+    class ColliderComponent : public Component {
+        // The cached world space shape and the world version of the entity it was computed from
+        mutable uint64_t cachedWorldVersion = 0;
+        mutable AABB worldBounds;
+        mutable glm::vec3 worldCenter = {0, 0, 0}; // The center of a box or a sphere
+        mutable glm::vec3 worldSegment[2];         // The end points of the capsule segment
+        mutable float worldRadius = 0;
+        mutable bool active = true;
+
+        // Recomputes the cached world space shape if the entity moved
+        void refresh() const;
+    public:
+        ColliderShape shape = ColliderShape::BOX;
+        glm::vec3 offset = {0, 0, 0};   // The center of the shape relative to the entity (in the local space)
+        glm::vec3 size = {1, 1, 1};     // The half size of the box
+        float radius = 0.5f;            // The radius of the sphere & the capsule
+        float height = 1.0f;            // The distance between the centers of the two ends of the capsule
+        bool scaleWithEntity = true;    // If true, the size & radius are multiplied by the world scale of the entity
+        glm::vec3 padding = {0, 0, 0};  // A margin added to the half size of the box in world units (after scaling)
+        uint32_t layer = 1;             // The layers this collider belongs to (bit mask)
+        uint32_t collidesWith = ~0u;    // The layers this collider collides with (bit mask)
+        bool trigger = false;           // Triggers only report overlaps (pick ups, checkpoints), the others are solid obstacles
+        bool isStatic = false;          // Static colliders never move, so the systems can add them to their broad-phase once
+
+        // The ID of this component type is "Collider"
+        static std::string getID() { return "Collider"; }
+
+        // Reads the collider parameters from the given json object
+        void deserialize(const nlohmann::json& data) override;
+
+        // Returns the axis aligned box that contains the collider in the world space
+        const AABB& getWorldBounds() const { refresh(); return worldBounds; }
+
+        // Returns false if the collider is disabled because the entity is hidden (scaled to zero, which is how this game hides entities)
+        bool isActive() const { refresh(); return active; }
+
+        // Returns whether the layers of the two colliders allow them to collide
+        bool canCollideWith(const ColliderComponent* other) const {
+            return (layer & other->collidesWith) != 0 && (other->layer & collidesWith) != 0;
+        }
+
+        // Returns whether the two colliders overlap (the capsule against box test is an approximation)
+        bool intersects(const ColliderComponent* other) const;
+    };
+
+}
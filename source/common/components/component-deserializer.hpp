@@ -8,6 +8,7 @@
 #include "light.hpp"
 #include "battery.hpp"
 #include "position-point.hpp"
+#include "collider.hpp"
 
 namespace our {
 
@@ -33,6 +34,8 @@ namespace our {
 						component = entity->addComponent<BatteryComponent>();
 				} else if (type == PositionPointComponent::getID()) {
 						component = entity->addComponent<PositionPointComponent>();
+				} else if (type == ColliderComponent::getID()) {
+						component = entity->addComponent<ColliderComponent>();
 				}
         //serialization -> taking our world with its entities to a file
         //deserialization-> opening a JSON file and filling our entities and their components
@@ -15,5 +15,7 @@ namespace our {
 				// Read the mesh and material objects from the AssetLoader
         mesh = AssetLoader<Mesh>::get(data["mesh"].get<std::string>());
         material = AssetLoader<Material>::get(data["material"].get<std::string>());
+        // "static" (optional, default=false) promises that the entity (and its parents) will never move
+        isStatic = data.value("static", false);
     }
 }
\ No newline at end of file
@@ -12,6 +12,7 @@ namespace our {
     public:
         Mesh* mesh; // The mesh that should be drawn
         Material* material; // The material used to draw the mesh
+        bool isStatic = false; // Static mesh renderers never move, so the renderer puts them in a bounding volume hierarchy once
 
         // The ID of this component type is "Mesh Renderer"
         static std::string getID() { return "Mesh Renderer"; }
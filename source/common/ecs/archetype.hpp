@@ -0,0 +1,92 @@
+#pragma once
+
+#include "component.hpp"
+
+#include <array>
+#include <vector>
+
+namespace our {
+
+    class Entity; // A forward declaration of the Entity Class
+
+    // An archetype groups all the entities that have exactly the same set of component types (the same component mask).
+    // The data is stored as a structure of arrays: one array for the entities and one column for every component type in the mask,
+    // where row i of each column holds the (first) component of that type attached to entity i.
+    // Systems can walk the columns of the matching archetypes (see "World::query") instead of visiting every entity in the world.
+    // The components themselves are still owned by their entities (so pointers to them stay valid), the columns only reference them.
+    class Archetype {
+        ComponentMask mask;
+        // For every component type ID, the index of its column (or -1 if the type is not in the mask)
+        std::array<int, MAX_COMPONENT_TYPES> columnIndices;
+        std::vector<Entity*> entities;
+        std::vector<std::vector<Component*>> columns;
+
+    public:
+        explicit Archetype(ComponentMask mask) : mask(mask) {
+            columnIndices.fill(-1);
+            for(ComponentTypeId typeId = 0; typeId < MAX_COMPONENT_TYPES; typeId++){
+                if(mask & (ComponentMask(1) << typeId)){
+                    columnIndices[typeId] = (int)columns.size();
+                    columns.emplace_back();
+                }
+            }
+        }
+
+        // Returns the component mask shared by all the entities of this archetype
+        ComponentMask getMask() const { return mask; }
+
+        // Returns whether this archetype contains all the component types in the given mask
+        bool matches(ComponentMask required) const { return (mask & required) == required; }
+
+        // Returns the number of entities in this archetype
+        size_t size() const { return entities.size(); }
+
+        // Returns the entity at the given row
+        Entity* getEntity(size_t row) const { return entities[row]; }
+
+        // Returns the component of type T at the given row (T must be in the mask of this archetype)
+        template<typename T>
+        T* get(size_t row) const {
+            return static_cast<T*>(columns[columnIndices[getComponentTypeId<T>()]][row]);
+        }
+
+        // Appends an entity with the given components (indexed by type ID) and returns its row
+        size_t add(Entity* entity, const std::array<Component*, MAX_COMPONENT_TYPES>& components) {
+            entities.push_back(entity);
+            set(entities.size() - 1, components);
+            return entities.size() - 1;
+        }
+
+        // Replaces the components stored at the given row (used when the first component of a type changes)
+        void set(size_t row, const std::array<Component*, MAX_COMPONENT_TYPES>& components) {
+            for(ComponentTypeId typeId = 0; typeId < MAX_COMPONENT_TYPES; typeId++){
+                int column = columnIndices[typeId];
+                if(column < 0) continue;
+                if(columns[column].size() <= row) columns[column].resize(row + 1);
+                columns[column][row] = components[typeId];
+            }
+        }
+
+        // Removes the entity at the given row by moving the last entity into its place
+        // Returns the entity that was moved into the row (or nullptr if the removed entity was the last one)
+        Entity* remove(size_t row) {
+            size_t last = entities.size() - 1;
+            Entity* moved = nullptr;
+            if(row != last){
+                moved = entities[last];
+                entities[row] = moved;
+                for(auto& column : columns) column[row] = column[last];
+            }
+            entities.pop_back();
+            for(auto& column : columns) column.pop_back();
+            return moved;
+        }
+
+        // Removes all the entities from this archetype
+        void clear() {
+            entities.clear();
+            for(auto& column : columns) column.clear();
+        }
+    };
+
+}
@@ -2,17 +2,48 @@
 
 #include <json/json.hpp>
 #include <string>
+#include <cstdint>
+#include <cassert>
 
 namespace our {
 
     class Entity; // A forward declaration of the Entity Class
 
+    // Every component type gets a small integer ID the first time it is used (a template static counter).
+    // The entity uses it to find its components by indexing an array instead of walking a list and using dynamic_cast.
+    using ComponentTypeId = uint32_t;
+    // A bitmask with one bit for every component type (bit i is set if a component whose type ID is i is present)
+    using ComponentMask = uint32_t;
+    // The maximum number of component types (the number of bits in the component mask)
+    #define MAX_COMPONENT_TYPES 32
+
+    // Returns a new component type ID every time it is called (used by "getComponentTypeId" only)
+    inline ComponentTypeId nextComponentTypeId() {
+        static ComponentTypeId next = 0;
+        assert(next < MAX_COMPONENT_TYPES && "Too many component types, increase MAX_COMPONENT_TYPES");
+        return next++;
+    }
+
+    // Returns the ID of the component type T. The ID is assigned once and never changes while the program runs.
+    template<typename T>
+    ComponentTypeId getComponentTypeId() {
+        static const ComponentTypeId id = nextComponentTypeId();
+        return id;
+    }
+
+    // Returns the mask that contains the bits of all the given component types
+    template<typename... T>
+    ComponentMask getComponentMask() {
+        return (ComponentMask(0) | ... | (ComponentMask(1) << getComponentTypeId<T>()));
+    }
+
     // A component is a data container that can be added to an entity.
     // The role of the entity in the world is defined by the components it holds.
     // For example, an entity with a camera component specifies that this entity should be used as a camera
     // Thus any renderer system should look for an entity holding a camera component in order to compute the camera related uniforms (e.g. VP matrix)
     class Component {
         Entity* owner; // A pointer to the entity that owns this component
+        ComponentTypeId typeId = 0; // The type ID of the concrete component type (set by the entity when the component is added)
         friend Entity; // The entity is a friend since it is the only one allowed to set itself as an owner of a certain component.
     public:
         // This static method returns a unique string that identifies each type of components
@@ -25,6 +56,8 @@ namespace our {
         // Returns the owner of this component
         Entity* getOwner() const { return owner; }
         void setOwner(Entity * newOwner) { this->owner = newOwner; }
+        // Returns the type ID of this component
+        ComponentTypeId getTypeId() const { return typeId; }
 
         // Define a virtual destructor
         virtual ~Component(){}
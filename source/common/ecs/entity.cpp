@@ -1,4 +1,5 @@
 #include "entity.hpp"
+#include "world.hpp"
 #include "../deserialize-utils.hpp"
 #include "../components/component-deserializer.hpp"
 
@@ -8,33 +9,49 @@ namespace our {
 
     // This function returns the transformation matrix from the entity's local space to the world space
     // Remember that you can get the transformation matrix from this entity to its parent from "localTransform"
-    // To get the local to world matrix, you need to combine this entities matrix with its parent's matrix and
-    // its parent's parent's matrix and so on till you reach the root.
-    glm::mat4 Entity::getLocalToWorldMatrix() const {
-        //TODO: (Req 8) Write this function
+    // To get the local to world matrix, you need to combine this entities matrix with its parent's local to world matrix.
+    // Both matrices are cached, so we only recompute ours if our transform, our parent or our parent's matrix changed.
+    const glm::mat4& Entity::getLocalToWorldMatrix() const {
+        // Every entity gets a unique world version whenever its matrix is recomputed
+        static uint64_t nextWorldVersion = 1;
 
-				// Create a temporary entity pointer to the current entity's parent
-        Entity* temp  = parent;
-
-				// Create a tranformation matrix for the localToWorld
-        glm::mat4 localToWorld = localTransform.toMat4();
-
-				// Keep going up to all the parents until we reach the root
-        while(temp) {
-						// Update the localToWorld matrix by multiplying it with the parent's localTransform matrix 
-            localToWorld  = temp->localTransform.toMat4() * localToWorld;
+        bool outdated = worldVersion == 0 || cachedTransformVersion != localTransform.getVersion() || cachedParent != parent;
+        if(parent){
+            // The parent refreshes its own matrix first (and so on till we reach the root)
+            const glm::mat4& parentLocalToWorld = parent->getLocalToWorldMatrix();
+            outdated = outdated || cachedParentWorldVersion != parent->worldVersion;
+            if(outdated) localToWorld = parentLocalToWorld * localTransform.getMatrix();
+            cachedParentWorldVersion = parent->worldVersion;
+        } else if(outdated) {
+            localToWorld = localTransform.getMatrix();
+        }
 
-						// Move the pointer up to the parent of the entity
-            temp = temp->parent;
+        if(outdated){
+            cachedTransformVersion = localTransform.getVersion();
+            cachedParent = parent;
+            worldVersion = nextWorldVersion++;
+            TransformCounters::get().worldMatrices++;
         }
-				
         return localToWorld;
     }
 
+    // Moves this entity to the archetype that matches its components (the world is only declared in the header)
+    void Entity::notifyComponentsChanged() {
+        if(world) world->updateArchetype(this);
+    }
+
+    // Changes the name & the tag of the entity then tells the world to move the entity in its name index
+    void Entity::setName(const std::string& newName) {
+        Tag oldTag = tag;
+        name = newName;
+        tag = internTag(name);
+        if(world && oldTag != tag) world->updateTag(this, oldTag);
+    }
+
     // Deserializes the entity data and components from a json object
     void Entity::deserialize(const nlohmann::json& data){
         if(!data.is_object()) return;
-        name = data.value("name", name);
+        setName(data.value("name", name));
         localTransform.deserialize(data);
         if(data.contains("components")){
             if(const auto& components = data["components"]; components.is_array()){
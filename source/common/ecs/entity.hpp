@@ -2,8 +2,14 @@
 
 #include "component.hpp"
 #include "transform.hpp"
+#include "archetype.hpp"
+#include "tag.hpp"
 #include <list>
+#include <vector>
+#include <array>
+#include <algorithm>
 #include <iterator>
+#include <type_traits>
 #include <string>
 #include <glm/glm.hpp>
 
@@ -13,31 +19,101 @@ namespace our {
 
     class Entity{
         World *world; // This defines what world own this entity
-        std::list<Component*> components; // A list of components that are owned by this entity
+        std::vector<Component*> components; // A list of components that are owned by this entity (in the order they were added)
+
+        // The components are also indexed by their type ID so that finding a component is O(1) without any dynamic_cast:
+        // "componentMask" has the bit of every attached component type set and "firstComponents" holds the first component of each type
+        ComponentMask componentMask = 0;
+        std::array<Component*, MAX_COMPONENT_TYPES> firstComponents = {};
+
+        // The archetype (in the world) that holds this entity and the row of this entity in it
+        Archetype* archetype = nullptr;
+        size_t archetypeRow = 0;
+
+        // Tells the world that the components of this entity changed so that it can move the entity to the right archetype
+        void notifyComponentsChanged();
+
+        // The interned version of "name" (kept in sync by "setName")
+        Tag tag = 0;
+
+        // The cached local to world matrix and what it was computed from. It is outdated if the version of the local transform,
+        // the parent or the world version of the parent changed since then.
+        mutable glm::mat4 localToWorld = glm::mat4(1.0f);
+        mutable uint32_t cachedTransformVersion = 0;
+        mutable const Entity* cachedParent = nullptr;
+        mutable uint64_t cachedParentWorldVersion = 0;
+        // A globally unique number assigned whenever the cached local to world matrix is recomputed (so the children can tell that it changed)
+        mutable uint64_t worldVersion = 0;
+
+        // Returns whether the given component is of type T (every component type is matched by "Component" itself)
+        template<typename T>
+        static bool isOfType(const Component* component) {
+            if constexpr (std::is_same_v<T, Component>) return true;
+            else return component->typeId == getComponentTypeId<T>();
+        }
+
+        // Removes the component at the given position from the list and the type index, then deletes it
+        void removeComponent(std::vector<Component*>::iterator it) {
+            Component* component = *it;
+            components.erase(it);
+            ComponentTypeId typeId = component->typeId;
+            if(firstComponents[typeId] == component){
+                // Another component of the same type (if any) becomes the first one
+                auto next = std::find_if(components.begin(), components.end(), [typeId](Component* other){ return other->typeId == typeId; });
+                firstComponents[typeId] = next != components.end() ? *next : nullptr;
+                if(!firstComponents[typeId]) componentMask &= ~(ComponentMask(1) << typeId);
+            }
+            delete component;
+            notifyComponentsChanged();
+        }
 
         friend World; // The world is a friend since it is the only class that is allowed to instantiate an entity
         Entity() = default; // The entity constructor is private since only the world is allowed to instantiate an entity
     public:
-        std::string name; // The name of the entity. It could be useful to refer to an entity by its name
+        std::string name; // The name of the entity. It could be useful to refer to an entity by its name (use "setName" to change it)
         Entity* parent;   // The parent of the entity. The transform of the entity is relative to its parent.
                           // If parent is null, the entity is a root entity (has no parent).
         Transform localTransform; // The transform of this entity relative to its parent.
 
         World* getWorld() const { return world; } // Returns the world to which this entity belongs
 
-        glm::mat4 getLocalToWorldMatrix() const; // Computes and returns the transformation from the entities local space to the world space
+        // Returns the transformation from the entities local space to the world space
+        // The matrix is cached and only recomputed if the transform of the entity or one of its ancestors changed
+        const glm::mat4& getLocalToWorldMatrix() const;
+        // Returns a number that changes whenever the local to world matrix is recomputed (call "getLocalToWorldMatrix" first to refresh it)
+        // Anything derived from the matrix can be cached and only recomputed when this number changes
+        uint64_t getWorldVersion() const { return worldVersion; }
         void deserialize(const nlohmann::json&); // Deserializes the entity data and components from a json object
+
+        // Changes the name of the entity and updates its tag and the name index of its world
+        void setName(const std::string& newName);
+        // Returns the tag of the entity (the interned name), comparing tags is much cheaper than comparing names
+        Tag getTag() const { return tag; }
+
+        // Returns the mask of the component types attached to this entity
+        ComponentMask getComponentMask() const { return componentMask; }
+
+        // Returns whether this entity has at least one component of each of the given types
+        template<typename... T>
+        bool hasComponents() const {
+            ComponentMask mask = our::getComponentMask<T...>();
+            return (componentMask & mask) == mask;
+        }
         
 				// Function to get the list of components
 				template<typename T>
 				std::list<T*> getComponents() const {
 						std::list<T*> list;
-						
-						// Loop through the components list
-            for(auto it = components.begin(); it != components.end(); it++) {
-                // Search for the first component that can be dynamically cast to T* and return it
-                if(dynamic_cast<T*>(*it) != nullptr)
-                    list.push_back(dynamic_cast<T*>(*it));
+
+						// If there is no component of this type, there is no need to walk the list
+						if constexpr (!std::is_same_v<T, Component>) {
+								if(!(componentMask & our::getComponentMask<T>())) return list;
+						}
+
+						// Loop through the components list and collect the components of type T
+            for(auto component : components) {
+                if(isOfType<T>(component))
+                    list.push_back(static_cast<T*>(component));
             }
 
 						return list;
@@ -51,12 +127,18 @@ namespace our {
             //TODO: (Req 8) Create an component of type T, set its "owner" to be this entity, then push it into the component's list
             // Don't forget to return a pointer to the new component
 
-						// Create the component object and set it's owner to the current entity
+						// Create the component object and set it's owner & type ID
             T * newComponent = new T();
             newComponent->owner = this;
+            newComponent->typeId = getComponentTypeId<T>();
 
-						// Add the component to the components list then return it
+						// Add the component to the components list and (if it is the first of its type) to the type index then return it
             components.push_back(newComponent);
+            if(!firstComponents[newComponent->typeId]){
+                firstComponents[newComponent->typeId] = newComponent;
+                componentMask |= ComponentMask(1) << newComponent->typeId;
+                notifyComponentsChanged();
+            }
             return newComponent;
         }
 
@@ -67,23 +149,20 @@ namespace our {
             //TODO: (Req 8) Go through the components list and find the first component that can be dynamically cast to "T*".
             // Return the component you found, or return null of nothing was found.
 
-						// Loop through the components list
-            for(auto it = components.begin(); it != components.end(); it++) {
-                // Search for the first component that can be dynamically cast to T* and return it
-                if(dynamic_cast<T*>(*it) != nullptr)
-                    return dynamic_cast<T*>(*it);
-            }
-            return nullptr;
+						// The first component of every type is indexed by the type ID, so this is a single array read
+						if constexpr (std::is_same_v<T, Component>) {
+								return components.empty() ? nullptr : components.front();
+						} else {
+								return static_cast<T*>(firstComponents[getComponentTypeId<T>()]);
+						}
         }
 
-        // This template method dynamic and returns a pointer to it
-        // If no component of type T was found, it returns a nullptr 
+        // This template method returns the component at the given index if it is of type T
+        // If there is no such component or it is not of type T, it returns a nullptr 
         template<typename T>
         T* getComponent(size_t index){
-            auto it = components.begin();
-            std::advance(it, index);
-            if(it != components.end())
-                return dynamic_cast<T*>(*it);
+            if(index < components.size() && isOfType<T>(components[index]))
+                return static_cast<T*>(components[index]);
             return nullptr;
         }
 
@@ -93,23 +172,16 @@ namespace our {
             //TODO: (Req 8) Go through the components list and find the first component that can be dynamically cast to "T*".
             // If found, delete the found component and remove it from the components list
 
-						// Loop through the components list
-            for(auto it = components.begin(); it != components.end(); it++) {
-								// Find the first component that can be dynamically cast to T* then remove it from the list and delete it
-                if(dynamic_cast<T*>(*it) != nullptr){
-                    components.erase(it);
-                    delete *it;
-                }
+						// Find the first component of type T then remove it from the list and delete it
+            if(T* component = getComponent<T>(); component) {
+                deleteComponent(component);
             }
         }
 
         // This template method searhes for a component of type T and deletes it
         void deleteComponent(size_t index){
-            auto it = components.begin();
-            std::advance(it, index);
-            if(it != components.end()) {
-                components.erase(it);
-                delete *it;
+            if(index < components.size()) {
+                removeComponent(components.begin() + index);
             }
         }
 
@@ -119,21 +191,18 @@ namespace our {
             //TODO: (Req 8) Go through the components list and find the given component "component".
             // If found, delete the found component and remove it from the components list
 
-						// Loop through the components list
-            for(auto it = components.begin(); it != components.end(); it++) {
-								// Search for the given component then remove it from the list and delete it
-                if(*it == component){
-                    components.erase(it);
-                    delete *it;
-                }
+						// Search for the given component then remove it from the list and delete it
+            auto it = std::find(components.begin(), components.end(), component);
+            if(it != components.end()) {
+                removeComponent(it);
             }
         }
 
         // Since the entity owns its components, they should be deleted alongside the entity
         ~Entity(){
             //TODO: (Req 8) Delete all the components in "components".
-            for(auto it = components.begin(); it != components.end(); it++){
-                delete *it;
+            for(auto component : components){
+                delete component;
             }
         }
 
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace our {
+
+    // A tag is an interned entity name: every distinct name is mapped once to a small integer,
+    // so that systems can compare entities by tag (one integer compare) instead of comparing strings.
+    // The empty name is always the tag 0.
+    using Tag = uint32_t;
+
+    // This class holds the name <-> tag mapping. It is shared by all the worlds.
+    // The map is keyed by views of the names it owns (a deque never moves its elements, unlike a vector whose short strings
+    // would move with it), so looking a name up never builds a std::string.
+    class TagRegistry {
+        std::unordered_map<std::string_view, Tag> tags;
+        std::deque<std::string> names;
+
+        TagRegistry() {
+            names.emplace_back();
+            tags.emplace(names.back(), 0);
+        }
+    public:
+        // Returns the only instance of the registry
+        static TagRegistry& get() {
+            static TagRegistry registry;
+            return registry;
+        }
+
+        // Returns the tag of the given name (a new tag is created if the name was never seen before)
+        Tag intern(std::string_view name) {
+            if(auto it = tags.find(name); it != tags.end()) return it->second;
+            Tag tag = (Tag)names.size();
+            names.emplace_back(name);
+            tags.emplace(names.back(), tag);
+            return tag;
+        }
+
+        // Returns the tag of the given name without creating one. If the name was never interned, it returns false.
+        bool find(std::string_view name, Tag& tag) const {
+            auto it = tags.find(name);
+            if(it == tags.end()) return false;
+            tag = it->second;
+            return true;
+        }
+
+        // Returns the name of the given tag
+        const std::string& getName(Tag tag) const { return names[tag]; }
+
+        TagRegistry(const TagRegistry&) = delete;
+        TagRegistry& operator=(const TagRegistry&) = delete;
+    };
+
+    // Returns the tag of the given name (systems usually call it once and store the result)
+    inline Tag internTag(std::string_view name) { return TagRegistry::get().intern(name); }
+
+    // Returns the name of the given tag
+    inline const std::string& getTagName(Tag tag) { return TagRegistry::get().getName(tag); }
+
+}
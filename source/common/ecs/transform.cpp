@@ -24,10 +24,21 @@ namespace our {
         return translationMat * rotationMat * scaleMat;
     }
 
+    // This function returns the cached matrix and recomputes it only if one of the setters was called since the last time
+    const glm::mat4& Transform::getMatrix() const {
+        if(dirty){
+            matrix = toMat4();
+            dirty = false;
+            TransformCounters::get().localMatrices++;
+        }
+        return matrix;
+    }
+
     // Deserializes the entity data and components from a json object
     void Transform::deserialize(const nlohmann::json& data) {
         position = data.value("position", position);
         rotation = glm::radians(data.value("rotation", glm::degrees(rotation)));
         scale    = data.value("scale", scale);
+        markDirty();
     }
 }
\ No newline at end of file
@@ -3,15 +3,60 @@
 #include <glm/glm.hpp>
 #include <json/json.hpp>
 
+#include <cstdint>
+
 namespace our {
 
+    // Counts how many transformation matrices get recomputed, so that we can verify that the matrix caches work.
+    // The counters are never reset automatically, call "reset" (e.g. at the start of a frame) to get the counts per frame.
+    struct TransformCounters {
+        size_t localMatrices = 0; // The number of local (transform to parent) matrices that were recomputed
+        size_t worldMatrices = 0; // The number of local to world matrices that were recomputed
+
+        void reset() { localMatrices = worldMatrices = 0; }
+
+        // Returns the counters shared by all the transforms
+        static TransformCounters& get() {
+            static TransformCounters counters;
+            return counters;
+        }
+    };
+
     // A transform defines the translation, rotation & scale of an object relative to its parent
+    // The transform caches its matrix, so the position, rotation & scale can only be changed through the setters
+    // which mark the cached matrix as dirty and increment the version of the transform.
     struct Transform {
-    public:
+    private:
         glm::vec3 position = glm::vec3(0, 0, 0); // The position is defined as a vec3. (0,0,0) means no translation
         glm::vec3 rotation = glm::vec3(0, 0, 0); // The rotation is defined using euler angles (y: yaw, x: pitch, z: roll). (0,0,0) means no rotation
         glm::vec3 scale = glm::vec3(1, 1, 1); // The scale is defined as a vec3. (1,1,1) means no scaling.
 
+        mutable glm::mat4 matrix = glm::mat4(1.0f); // The cached result of "toMat4"
+        mutable bool dirty = true; // Whether the cached matrix is outdated
+        uint32_t version = 1; // Incremented on every change, so that the entities can tell whether their cached world matrix is outdated
+
+        void markDirty() { dirty = true; ++version; }
+    public:
+        const glm::vec3& getPosition() const { return position; }
+        const glm::vec3& getRotation() const { return rotation; }
+        const glm::vec3& getScale() const { return scale; }
+
+        void setPosition(const glm::vec3& value) { position = value; markDirty(); }
+        void setRotation(const glm::vec3& value) { rotation = value; markDirty(); }
+        void setScale(const glm::vec3& value) { scale = value; markDirty(); }
+
+        // Adds the given offset to the position
+        void translate(const glm::vec3& offset) { setPosition(position + offset); }
+        // Adds the given euler angles to the rotation
+        void rotate(const glm::vec3& angles) { setRotation(rotation + angles); }
+
+        // Returns whether the matrix needs to be recomputed
+        bool isDirty() const { return dirty; }
+        // Returns a number that changes whenever the transform changes
+        uint32_t getVersion() const { return version; }
+
+        // This function returns the cached matrix that represents this transform (it is recomputed only if the transform changed)
+        const glm::mat4& getMatrix() const;
         // This function computes and returns a matrix that represents this transform
         glm::mat4 toMat4() const;
          // Deserializes the entity data and components from a json object
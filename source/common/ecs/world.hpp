@@ -1,15 +1,135 @@
 #pragma once
 
 #include <unordered_set>
+#include <unordered_map>
+#include <memory>
+#include <tuple>
+#include <vector>
+#include <algorithm>
+#include <string_view>
 #include "entity.hpp"
+#include "archetype.hpp"
 
 namespace our {
 
+    // A query visits every entity that has all the component types T... (see "World::query").
+    // It can be used in a range-based for loop, where each element is a tuple of the entity and its components:
+    //      for(auto [entity, meshRenderer, movement] : world->query<MeshRendererComponent, MovementComponent>()) { ... }
+    // or through "forEach" which calls the given function with the same arguments.
+    // Only the archetypes that contain all the requested types are visited, in the order their entities are stored.
+    // Components should not be added to or removed from the visited entities while iterating.
+    template<typename... T>
+    class Query {
+        std::vector<Archetype*> archetypes; // The archetypes that contain all the requested component types
+    public:
+        explicit Query(std::vector<Archetype*> archetypes) : archetypes(std::move(archetypes)) {}
+
+        class iterator {
+            const std::vector<Archetype*>* archetypes;
+            size_t archetype, row;
+            // Skips the empty archetypes so that the iterator always points to an entity (or to the end)
+            void skipEmpty() {
+                while(archetype < archetypes->size() && row >= (*archetypes)[archetype]->size()){
+                    archetype++;
+                    row = 0;
+                }
+            }
+        public:
+            iterator(const std::vector<Archetype*>* archetypes, size_t archetype) : archetypes(archetypes), archetype(archetype), row(0) { skipEmpty(); }
+            std::tuple<Entity*, T*...> operator*() const {
+                Archetype* current = (*archetypes)[archetype];
+                return {current->getEntity(row), current->template get<T>(row)...};
+            }
+            iterator& operator++() { row++; skipEmpty(); return *this; }
+            bool operator!=(const iterator& other) const { return archetype != other.archetype || row != other.row; }
+            bool operator==(const iterator& other) const { return !(*this != other); }
+        };
+
+        iterator begin() const { return iterator(&archetypes, 0); }
+        iterator end() const { return iterator(&archetypes, archetypes.size()); }
+
+        // Calls the given function with (Entity*, T*...) for every matching entity
+        template<typename Function>
+        void forEach(Function&& function) const {
+            for(Archetype* archetype : archetypes){
+                for(size_t row = 0; row < archetype->size(); row++){
+                    function(archetype->getEntity(row), archetype->template get<T>(row)...);
+                }
+            }
+        }
+
+        // Returns the number of matching entities
+        size_t size() const {
+            size_t count = 0;
+            for(Archetype* archetype : archetypes) count += archetype->size();
+            return count;
+        }
+
+        // Returns whether there is no matching entity
+        bool empty() const { return size() == 0; }
+    };
+
     // This class holds a set of entities
     class World {
         std::unordered_set<Entity*> entities; // These are the entities held by this world
         std::unordered_set<Entity*> markedForRemoval; // These are the entities that are awaiting to be deleted
                                                       // when deleteMarkedEntities is called
+
+        // The entities are also grouped by their component mask into archetypes, so that a query only visits the entities it needs
+        std::unordered_map<ComponentMask, std::unique_ptr<Archetype>> archetypes;
+        std::vector<Archetype*> archetypeList; // The same archetypes in the order they were created (used by the queries)
+
+        // Returns the archetype of the given component mask (it is created if it does not exist)
+        Archetype* getArchetype(ComponentMask mask) {
+            auto& archetype = archetypes[mask];
+            if(!archetype){
+                archetype = std::make_unique<Archetype>(mask);
+                archetypeList.push_back(archetype.get());
+            }
+            return archetype.get();
+        }
+
+        // Removes the given entity from its archetype (if any)
+        void removeFromArchetype(Entity* entity) {
+            if(!entity->archetype) return;
+            if(Entity* moved = entity->archetype->remove(entity->archetypeRow); moved)
+                moved->archetypeRow = entity->archetypeRow;
+            entity->archetype = nullptr;
+        }
+
+        // The entities indexed by their tag (the interned name) so that finding entities by name does not scan the world.
+        // The entities without a name (tag 0) are not indexed.
+        std::unordered_map<Tag, std::vector<Entity*>> entitiesByTag;
+
+        // Removes the given entity from the list of the given tag
+        void removeFromTag(Entity* entity, Tag tag) {
+            if(tag == 0) return;
+            auto it = entitiesByTag.find(tag);
+            if(it == entitiesByTag.end()) return;
+            auto& list = it->second;
+            if(auto position = std::find(list.begin(), list.end(), entity); position != list.end())
+                list.erase(position);
+        }
+
+        // Moves the given entity from the list of its old tag to the list of its current tag
+        void updateTag(Entity* entity, Tag oldTag) {
+            removeFromTag(entity, oldTag);
+            if(entity->tag != 0) entitiesByTag[entity->tag].push_back(entity);
+        }
+
+        friend Entity; // The entity notifies the world whenever its components or its name change
+        // Moves the given entity to the archetype of its current component mask (or refreshes its row if the mask did not change)
+        void updateArchetype(Entity* entity) {
+            ComponentMask mask = entity->getComponentMask();
+            if(entity->archetype && entity->archetype->getMask() == mask){
+                entity->archetype->set(entity->archetypeRow, entity->firstComponents);
+                return;
+            }
+            removeFromArchetype(entity);
+            entity->archetype = getArchetype(mask);
+            entity->archetypeRow = entity->archetype->add(entity, entity->firstComponents);
+        }
+
     public:
 
         World() = default;
@@ -31,11 +151,59 @@ namespace our {
             Entity * newEntity = new Entity();
             newEntity->world = this;
 
-						// Add the new entity to entities list then return it
+						// Add the new entity to entities list (and to the archetype of entities without components) then return it
             entities.insert(newEntity);
+            updateArchetype(newEntity);
             return newEntity;
         }
 
+        // Returns the first entity (in the order they got their names) with the given name or nullptr if there is none
+        Entity* findByName(std::string_view name) const {
+            Tag tag;
+            if(!TagRegistry::get().find(name, tag)) return nullptr;
+            const auto& list = findAllByTag(tag);
+            return list.empty() ? nullptr : list.front();
+        }
+
+        // Returns all the entities with the given tag
+        const std::vector<Entity*>& findAllByTag(Tag tag) const {
+            static const std::vector<Entity*> none;
+            if(tag == 0) return none;
+            auto it = entitiesByTag.find(tag);
+            return it == entitiesByTag.end() ? none : it->second;
+        }
+
+        // Calls the given function for every entity with the given tag
+        // The function is allowed to rename or delete the entity it receives (it iterates over a copy of the list),
+        // but it should not delete the other entities of the same tag
+        template<typename Function>
+        void forEachWithTag(Tag tag, Function&& function) {
+            std::vector<Entity*> list = findAllByTag(tag);
+            for(Entity* entity : list) function(entity);
+        }
+
+        // Returns a query that visits only the entities that have all the component types T...
+        // For example: for(auto [entity, movement] : world->query<MovementComponent>()) { ... }
+        template<typename... T>
+        Query<T...> query() {
+            ComponentMask required = getComponentMask<T...>();
+            std::vector<Archetype*> matching;
+            for(Archetype* archetype : archetypeList){
+                if(archetype->size() > 0 && archetype->matches(required))
+                    matching.push_back(archetype);
+            }
+            return Query<T...>(std::move(matching));
+        }
+
+        // Refreshes the cached local to world matrices of all the entities whose transform (or the transform of one of their ancestors) changed.
+        // Every entity refreshes its parent before itself, so the matrices are updated top-down and the clean subtrees are only checked.
+        // This should be called once per frame after the systems moved the entities. Returns the number of recomputed world matrices.
+        size_t updateTransforms() {
+            size_t before = TransformCounters::get().worldMatrices;
+            for(Entity* entity : entities) entity->getLocalToWorldMatrix();
+            return TransformCounters::get().worldMatrices - before;
+        }
+
         // This returns and immutable reference to the set of all entites in the world.
         const std::unordered_set<Entity*>& getEntities() {
             return entities;
@@ -58,8 +226,10 @@ namespace our {
 
 						// Loop through markedForRemoval list
             for(Entity * entity : markedForRemoval){
-								// Remove the entity from the list then delete it
+								// Remove the entity from the list & its archetype then delete it
                 entities.erase(entity);
+                removeFromArchetype(entity);
+                removeFromTag(entity, entity->tag);
                 delete entity;
             }
 						markedForRemoval.clear();
@@ -69,14 +239,15 @@ namespace our {
         void clear(){
             //TODO: (Req 8) Delete all the entities and make sure that the containers are empty
 
-						// Loop through entities list
+						// Loop through entities list and delete every entity (the containers are cleared afterwards since erasing while iterating is not allowed)
             for(Entity * entity : entities){
-								// Remove the entity from the list then delete it
-                entities.erase(entity);
                 delete entity;
             }
 						entities.clear();
             markedForRemoval.clear();
+            archetypes.clear();
+            archetypeList.clear();
+            entitiesByTag.clear();
         }
 
         //Since the world owns all of its entities, they should be deleted alongside it.
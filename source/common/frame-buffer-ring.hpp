@@ -0,0 +1,195 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+
+namespace our {
+
+    // A slice of the ring that was given to a caller for the current frame
+    struct FrameAllocation {
+        void* data = nullptr;   // Where the caller should write its data (nullptr if the allocation failed)
+        GLintptr offset = 0;    // The offset of the slice in the buffer (to pass to glBindBufferRange, glVertexAttribPointer, etc.)
+        GLsizeiptr size = 0;
+
+        explicit operator bool() const { return data != nullptr; }
+    };
+
+    // A buffer for the data that is streamed to the GPU every frame (instance matrices, uniform blocks, ...).
+    // The buffer is split into "FRAME_COUNT" regions and every frame writes to the next region, so the CPU can fill a region
+    // while the GPU is still reading the regions of the previous frames. A fence is placed after the draws of every frame and
+    // the CPU only waits for it when it comes back to the same region (which only happens when the GPU is "FRAME_COUNT" frames behind).
+    // If the driver supports buffer storage (OpenGL 4.4 or GL_ARB_buffer_storage), the whole buffer is mapped once with a persistent & coherent
+    // mapping, so a frame only has to point at its region (no map or unmap call at all). Otherwise (OpenGL 3.3), the region of every frame is
+    // mapped with GL_MAP_UNSYNCHRONIZED_BIT since it is known to be unused, so the driver never stalls on the mapping.
+    // Usage per frame: beginFrame -> allocate (any number of times) -> flush (before any draw that reads the data) -> draws -> endFrame
+    class FrameBufferRing {
+    public:
+        static constexpr int FRAME_COUNT = 3;
+    private:
+        GLuint buffer = 0;
+        GLsizeiptr regionSize = 0;      // The size of every region in bytes
+        bool persistent = false;        // Whether the buffer has immutable storage that stays mapped
+        uint8_t* persistentData = nullptr; // The persistent mapping of the whole buffer (nullptr if the buffer is mapped every frame)
+        int region = 0;                 // The region of the current frame
+        GLsync fences[FRAME_COUNT] = {};
+        uint8_t* mapped = nullptr;      // The mapped region of the current frame (nullptr if it is not mapped)
+        GLsizeiptr used = 0;            // How many bytes of the current region were allocated
+        GLsizeiptr requested = 0;       // How many bytes were requested in the current frame (including the failed allocations)
+
+        // Statistics
+        GLsizeiptr lastFrameBytes = 0;
+        size_t stalls = 0;
+
+        // Waits until the GPU is done with the given region
+        void waitForRegion(int index) {
+            GLsync& fence = fences[index];
+            if(!fence) return;
+            // First, we check without waiting. If the fence is not signaled yet, the GPU is genuinely behind so we have to wait
+            GLenum result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if(result == GL_TIMEOUT_EXPIRED){
+                stalls++;
+                GLuint64 timeout = 1000000000; // 1 second per try (in nanoseconds)
+                do {
+                    result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout);
+                } while(result == GL_TIMEOUT_EXPIRED);
+            }
+            glDeleteSync(fence);
+            fence = nullptr;
+        }
+
+        // Creates the storage of the buffer for all the regions (and maps it once if the storage is persistent)
+        void createStorage() {
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            if(persistent){
+                const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                glBufferStorage(GL_COPY_WRITE_BUFFER, regionSize * FRAME_COUNT, nullptr, flags);
+                persistentData = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, regionSize * FRAME_COUNT, flags);
+                if(!persistentData){
+                    // The storage is immutable, so the buffer is replaced by one that is mapped every frame
+                    std::cerr << "Failed to map the frame buffer ring persistently, it will be mapped every frame" << std::endl;
+                    persistent = false;
+                    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+                    glDeleteBuffers(1, &buffer);
+                    createStorage();
+                    return;
+                }
+            } else {
+                glBufferData(GL_COPY_WRITE_BUFFER, regionSize * FRAME_COUNT, nullptr, GL_STREAM_DRAW);
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        }
+
+        // Deletes the buffer (which also ends its persistent mapping)
+        void deleteStorage() {
+            glDeleteBuffers(1, &buffer);
+            buffer = 0;
+            persistentData = nullptr;
+        }
+
+    public:
+        // Creates the buffer with room for "bytesPerFrame" bytes in every frame
+        void initialize(GLsizeiptr bytesPerFrame) {
+            regionSize = bytesPerFrame;
+            persistent = GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage;
+            createStorage();
+            region = 0;
+        }
+
+        // Deletes the buffer and the fences
+        void destroy() {
+            flush();
+            for(auto& fence : fences){
+                if(fence) glDeleteSync(fence);
+                fence = nullptr;
+            }
+            deleteStorage();
+        }
+
+        // Waits for the region of this frame to be free (if the GPU is still reading it) then maps it
+        void beginFrame() {
+            if(!buffer) return;
+            // If the last frame asked for more than a region, the regions are made big enough before they are mapped again
+            // (replacing the buffer is safe without waiting since OpenGL keeps the old storage alive until the GPU is done with it,
+            // the storage is immutable in the persistent case so a new buffer is made, the callers get its name from "getBuffer" every frame)
+            if(requested > regionSize){
+                for(auto& fence : fences){
+                    if(fence) glDeleteSync(fence);
+                    fence = nullptr;
+                }
+                regionSize = requested + requested / 2;
+                deleteStorage();
+                createStorage();
+            }
+            waitForRegion(region);
+            used = requested = 0;
+            if(persistentData){
+                // The coherent mapping makes the writes visible to the GPU without any flush
+                mapped = persistentData + region * regionSize;
+                return;
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            mapped = (uint8_t*)glMapBufferRange(GL_COPY_WRITE_BUFFER, region * regionSize, regionSize,
+                GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            if(!mapped) std::cerr << "Failed to map the frame buffer ring" << std::endl;
+        }
+
+        // Returns a slice of "size" bytes whose offset in the buffer is a multiple of "alignment".
+        // If the region is full (or not mapped), the returned allocation is empty and the caller should upload its data in another way,
+        // the region will be big enough in the next frames.
+        FrameAllocation allocate(GLsizeiptr size, GLsizeiptr alignment = 16) {
+            GLsizeiptr start = (used + alignment - 1) / alignment * alignment;
+            requested = std::max(requested, start) + size;
+            if(!mapped || start + size > regionSize) return {};
+            used = start + size;
+            return {mapped + start, region * regionSize + start, size};
+        }
+
+        // Allocates a slice and copies the given data to it
+        FrameAllocation upload(const void* data, GLsizeiptr size, GLsizeiptr alignment = 16) {
+            FrameAllocation allocation = allocate(size, alignment);
+            if(allocation) std::memcpy(allocation.data, data, size);
+            return allocation;
+        }
+
+        // Makes the written data visible to the GPU. It must be called before the draws that read the data (and no allocation works after it)
+        void flush() {
+            if(!mapped) return;
+            if(persistentData){
+                mapped = nullptr;
+                return;
+            }
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+            if(used > 0) glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, used);
+            glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            mapped = nullptr;
+        }
+
+        // Places a fence after the draws of this frame and moves to the next region
+        void endFrame() {
+            if(!buffer) return;
+            flush();
+            fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            region = (region + 1) % FRAME_COUNT;
+            lastFrameBytes = used;
+        }
+
+        // Returns the OpenGL name of the buffer
+        GLuint getBuffer() const { return buffer; }
+        // Returns the number of bytes that were streamed in the last frame
+        GLsizeiptr getLastFrameBytes() const { return lastFrameBytes; }
+        // Returns the size of a region in bytes
+        GLsizeiptr getRegionSize() const { return regionSize; }
+        // Returns whether the buffer stays mapped (buffer storage) instead of being mapped every frame
+        bool isPersistent() const { return persistentData != nullptr; }
+        // Returns how many times the CPU had to wait for the GPU to be done with a region
+        size_t getStallCount() const { return stalls; }
+    };
+
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/vec4.hpp>
+
+#include <cstdint>
+
+namespace our {
+
+    // Counts the OpenGL state calls that went through the state cache
+    struct GLStateCounters {
+        size_t issued = 0; // The calls that were sent to the driver
+        size_t elided = 0; // The calls that were skipped since they would not change anything
+
+        void reset() { issued = elided = 0; }
+    };
+
+    // A shadow copy of the OpenGL state that the materials & the meshes change (capabilities, depth, culling & blending options, the program,
+    // the texture unit, the textures & samplers bound to every unit and the vertex array). Every call goes through this class which skips it if the
+    // value is already set, so setting up a material that shares most of its state with the previous one costs almost nothing.
+    // The application has a single OpenGL context, so there is a single cache (see "get").
+    // Any code that changes the same state without going through the cache (e.g. ImGui) must be followed by "invalidate",
+    // otherwise the cache would skip calls that are actually needed.
+    class GLStateCache {
+    public:
+        static constexpr int MAX_TEXTURE_UNITS = 32;
+    private:
+        // A value that no cached state can have, it means that we don't know the current value
+        static constexpr uint32_t UNKNOWN = 0xFFFFFFFFu;
+
+        // The capabilities handled by the cache
+        enum Capability { CULL_FACE, DEPTH_TEST, BLEND, CAPABILITY_COUNT };
+        uint32_t capabilities[CAPABILITY_COUNT];
+        uint32_t cullFace, frontFace, depthFunction, depthMask, colorMask;
+        uint32_t blendEquation, blendSource, blendDestination;
+        glm::vec4 blendColor; bool blendColorKnown;
+        uint32_t program, activeUnit, vertexArray;
+        uint32_t textures[MAX_TEXTURE_UNITS]; // The texture bound to GL_TEXTURE_2D in every unit
+        uint32_t textureArrays[MAX_TEXTURE_UNITS]; // The texture bound to GL_TEXTURE_2D_ARRAY in every unit
+        uint32_t samplers[MAX_TEXTURE_UNITS];
+
+        GLStateCounters counters;
+
+        GLStateCache() { invalidate(); }
+
+        static int capabilityIndex(GLenum capability) {
+            switch(capability){
+                case GL_CULL_FACE: return CULL_FACE;
+                case GL_DEPTH_TEST: return DEPTH_TEST;
+                case GL_BLEND: return BLEND;
+                default: return -1;
+            }
+        }
+
+        // Stores the value and returns true if it differs from the cached one (and counts the call either way)
+        bool change(uint32_t& cached, uint32_t value) {
+            if(cached == value){
+                counters.elided++;
+                return false;
+            }
+            cached = value;
+            counters.issued++;
+            return true;
+        }
+
+    public:
+        // Returns the cache of the application's OpenGL context
+        static GLStateCache& get() {
+            static GLStateCache cache;
+            return cache;
+        }
+
+        // Forgets the whole shadow state, so the next call of every kind will reach the driver
+        void invalidate() {
+            for(auto& capability : capabilities) capability = UNKNOWN;
+            cullFace = frontFace = depthFunction = depthMask = colorMask = UNKNOWN;
+            blendEquation = blendSource = blendDestination = UNKNOWN;
+            blendColorKnown = false;
+            program = activeUnit = vertexArray = UNKNOWN;
+            for(int unit = 0; unit < MAX_TEXTURE_UNITS; unit++) textures[unit] = textureArrays[unit] = samplers[unit] = UNKNOWN;
+        }
+
+        // glEnable or glDisable (only GL_CULL_FACE, GL_DEPTH_TEST & GL_BLEND are cached, the rest are always sent)
+        void setEnabled(GLenum capability, bool enabled) {
+            int index = capabilityIndex(capability);
+            if(index >= 0 && !change(capabilities[index], enabled)) return;
+            if(enabled) glEnable(capability); else glDisable(capability);
+        }
+
+        void cullFaceMode(GLenum face) { if(change(cullFace, face)) glCullFace(face); }
+        void frontFaceMode(GLenum face) { if(change(frontFace, face)) glFrontFace(face); }
+        void depthFunc(GLenum function) { if(change(depthFunction, function)) glDepthFunc(function); }
+        void setDepthMask(bool enabled) { if(change(depthMask, enabled)) glDepthMask(enabled); }
+        void setColorMask(bool r, bool g, bool b, bool a) {
+            if(change(colorMask, (uint32_t)r | (uint32_t)g << 1 | (uint32_t)b << 2 | (uint32_t)a << 3)) glColorMask(r, g, b, a);
+        }
+        void blendEquationMode(GLenum equation) { if(change(blendEquation, equation)) glBlendEquation(equation); }
+        void blendFunc(GLenum source, GLenum destination) {
+            // Both factors are set by a single call, so we count it once
+            if(blendSource == source && blendDestination == destination){
+                counters.elided++;
+                return;
+            }
+            blendSource = source; blendDestination = destination;
+            counters.issued++;
+            glBlendFunc(source, destination);
+        }
+        void setBlendColor(const glm::vec4& color) {
+            if(blendColorKnown && blendColor == color){
+                counters.elided++;
+                return;
+            }
+            blendColor = color; blendColorKnown = true;
+            counters.issued++;
+            glBlendColor(color.r, color.g, color.b, color.a);
+        }
+
+        void useProgram(GLuint name) { if(change(program, name)) glUseProgram(name); }
+
+        // Binds the vertex array (the meshes that share a vertex array are drawn one after the other without rebinding it)
+        void bindVertexArray(GLuint name) { if(change(vertexArray, name)) glBindVertexArray(name); }
+
+        // Selects the texture unit that the following texture binds will affect
+        void activeTexture(GLuint unit) { if(change(activeUnit, unit)) glActiveTexture(GL_TEXTURE0 + unit); }
+
+        // Binds the texture to GL_TEXTURE_2D in the active texture unit
+        void bindTexture2D(GLuint name) {
+            if(activeUnit >= MAX_TEXTURE_UNITS){
+                // The active unit is unknown (or not tracked), so we cannot know what is bound there
+                counters.issued++;
+                glBindTexture(GL_TEXTURE_2D, name);
+                return;
+            }
+            if(change(textures[activeUnit], name)) glBindTexture(GL_TEXTURE_2D, name);
+        }
+
+        // Binds the texture to GL_TEXTURE_2D_ARRAY in the active texture unit (every unit has a separate binding for each target)
+        void bindTexture2DArray(GLuint name) {
+            if(activeUnit >= MAX_TEXTURE_UNITS){
+                counters.issued++;
+                glBindTexture(GL_TEXTURE_2D_ARRAY, name);
+                return;
+            }
+            if(change(textureArrays[activeUnit], name)) glBindTexture(GL_TEXTURE_2D_ARRAY, name);
+        }
+
+        void bindSampler(GLuint unit, GLuint name) {
+            if(unit < MAX_TEXTURE_UNITS && !change(samplers[unit], name)) return;
+            if(unit >= MAX_TEXTURE_UNITS) counters.issued++;
+            glBindSampler(unit, name);
+        }
+
+        // The following functions should be called when an object is deleted, since OpenGL unbinds it and could give its name to a new object
+        void forgetTexture(GLuint name) {
+            for(auto& texture : textures) if(texture == name) texture = UNKNOWN;
+            for(auto& texture : textureArrays) if(texture == name) texture = UNKNOWN;
+        }
+        void forgetSampler(GLuint name) {
+            for(auto& sampler : samplers) if(sampler == name) sampler = UNKNOWN;
+        }
+        void forgetProgram(GLuint name) {
+            if(program == name) program = UNKNOWN;
+        }
+        void forgetVertexArray(GLuint name) {
+            if(vertexArray == name) vertexArray = UNKNOWN;
+        }
+
+        // Returns the number of issued & elided calls since the last reset
+        const GLStateCounters& getCounters() const { return counters; }
+        void resetCounters() { counters.reset(); }
+    };
+
+}
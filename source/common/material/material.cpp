@@ -1,19 +1,33 @@
 #include "material.hpp"
 
 #include "../asset-loader.hpp"
+#include "../shader/shader-permutations.hpp"
 #include "deserialize-utils.hpp"
 
+#include <algorithm>
+#include <iostream>
+
 namespace our {
 
+    // Finds the layer of a material's texture in its texture array. Returns -1 if the material has no such texture
+    // (an empty name) or if the array has no layer with that name (which is reported).
+    static int getArrayLayer(const TextureArray* array, const std::string& arrayName, const std::string& layerName) {
+        if(layerName.empty()) return -1;
+        int layer = array->getLayer(layerName);
+        if(layer < 0)
+            std::cerr << "The texture array \"" << arrayName << "\" has no layer named \"" << layerName << "\"" << std::endl;
+        return layer;
+    }
+
     // This function should setup the pipeline state and set the shader to be used
-    void Material::setup() const {
+    void Material::setup(bool instanced) const {
         //TODO: (Req 7) Write this function
 
 				// Start the the pipeline state
         pipelineState.setup();
 
         // Set the shader to be used
-				shader->use();
+				getShader(instanced)->use();
     }
 
     // This function read the material data from a json object
@@ -24,19 +38,21 @@ namespace our {
             pipelineState.deserialize(data["pipelineState"]);
         }
         shader = AssetLoader<ShaderProgram>::get(data["shader"].get<std::string>());
+        // The instanced variant is optional, without it the objects using this material are always drawn one by one
+        instancedShader = AssetLoader<ShaderProgram>::get(data.value("instancedShader", ""));
         transparent = data.value("transparent", false);
     }
 
     // This function should call the setup of its parent and
     // set the "tint" uniform to the value in the member variable tint 
-    void TintedMaterial::setup() const {
+    void TintedMaterial::setup(bool instanced) const {
         //TODO: (Req 7) Write this function
 
 				// Setup the material
-        Material::setup();
+        Material::setup(instanced);
 				
         // Set the "tint" uniform in the shader
-				shader->set("tint", tint);
+				getShader(instanced)->set("tint", tint);
     }
 
     // This function read the material data from a json object
@@ -49,23 +65,27 @@ namespace our {
     // This function should call the setup of its parent and
     // set the "alphaThreshold" uniform to the value in the member variable alphaThreshold
     // Then it should bind the texture and sampler to a texture unit and send the unit number to the uniform variable "tex"
-    void TexturedMaterial::setup() const {
+    void TexturedMaterial::setup(bool instanced) const {
         //TODO: (Req 7) Write this function
 
 				// Setup the material
-				TintedMaterial::setup();
+				TintedMaterial::setup(instanced);
+				ShaderProgram* program = getShader(instanced);
 
 				// Set the "alphaThreshold" uniform in the shader
-				shader->set("alphaThreshold", alphaThreshold);
+				program->set("alphaThreshold", alphaThreshold);
 
 				// Bind the texture and sampler to a texture unit 0 and send the unit number to the uniform variable "tex"
-        if (texture) {
+        if (textureArray) {
+          textureArray->bind();
+          program->set("layer", layer);
+        } else if (texture) {
 				  texture->bind();
         }
         if (sampler) {
 				  sampler->bind(0);
         }
-				shader->set("tex", 0);
+				program->set("tex", 0);
     }
 
     // This function read the material data from a json object
@@ -73,67 +93,92 @@ namespace our {
         TintedMaterial::deserialize(data);
         if(!data.is_object()) return;
         alphaThreshold = data.value("alphaThreshold", 0.0f);
-        texture = AssetLoader<Texture2D>::get(data.value("texture", ""));
+        std::string arrayName = data.value("textureArray", "");
+        textureArray = AssetLoader<TextureArray>::get(arrayName);
+        if(textureArray){
+            // The texture is the name of a layer of the array
+            texture = nullptr;
+            // A missing layer is replaced by the first one
+            layer = std::max(getArrayLayer(textureArray, arrayName, data.value("texture", "")), 0);
+        } else {
+            texture = AssetLoader<Texture2D>::get(data.value("texture", ""));
+        }
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
     }
 
     // setup of the lightMaterial to create the needed textures based on the type
-    void LightMaterial::setup() const
+    void LightMaterial::setup(bool instanced) const
     {
 				// Setup the material
-        Material::setup();
+        Material::setup(instanced);
+        ShaderProgram* program = getShader(instanced);
+
+        if (textureArray != nullptr) {
+            // Every map is a layer of the same array, so a single bind serves all of them
+            GLStateCache::get().activeTexture(0);
+            textureArray->bind();
+            sampler->bind(0);
+            program->set("material.maps", 0);
+            // The permutation of the shader only has the layer uniforms of the maps that were found
+            if (albedoLayer >= 0) program->set("material.albedo", albedoLayer);
+            if (specularLayer >= 0) program->set("material.specular", specularLayer);
+            if (emissiveLayer >= 0) program->set("material.emissive", emissiveLayer);
+            if (roughnessLayer >= 0) program->set("material.roughness", roughnessLayer);
+            if (ambientOcclusionLayer >= 0) program->set("material.ambient_occlusion", ambientOcclusionLayer);
+            return;
+        }
 
         if (albedo != nullptr) {
             // select an active texture unit -> 0
-            glActiveTexture(GL_TEXTURE0);
+            GLStateCache::get().activeTexture(0);
             // bind the texture to unit 0
             albedo->bind();
             // bind the sampler to unit 0
             sampler->bind(0);
-            shader->set("material.albedo", 0);
+            program->set("material.albedo", 0);
         }
 
         if (specular != nullptr) {
             // Select an active texture unit -> 1
-            glActiveTexture(GL_TEXTURE1);
+            GLStateCache::get().activeTexture(1);
             // Bind the texture to unit 1
             specular->bind();
             // Bind the sampler to unit 1
             sampler->bind(1);
-            shader->set("material.specular", 1);
+            program->set("material.specular", 1);
         }
 
         if (emissive != nullptr) {
             // Select an active texture unit -> 2
-            glActiveTexture(GL_TEXTURE2);
+            GLStateCache::get().activeTexture(2);
             // Bind the texture to unit 2
             emissive->bind();
             // Bind the sampler to unit 2
             sampler->bind(2);
-            shader->set("material.emissive", 2);
+            program->set("material.emissive", 2);
         }
 
         if (roughness != nullptr) {
             // Select an active texture unit -> 3
-            glActiveTexture(GL_TEXTURE3);
+            GLStateCache::get().activeTexture(3);
             // Bind the texture to unit 3
             roughness->bind();
             // Bind the sampler to unit 3
             sampler->bind(3);
-            shader->set("material.roughness", 3);
+            program->set("material.roughness", 3);
         }
 
         if (ambient_occlusion != nullptr) {
             // Select an active texture unit -> 4
-            glActiveTexture(GL_TEXTURE4);
+            GLStateCache::get().activeTexture(4);
             // Bbind the texture to unit 4
             ambient_occlusion->bind();
             // Bind the sampler to unit 4
             sampler->bind(4);
-            shader->set("material.ambient_occlusion", 4);
+            program->set("material.ambient_occlusion", 4);
 				}
 
-				glActiveTexture(GL_TEXTURE0);
+				GLStateCache::get().activeTexture(0);
     }
 
     // This function read the material data from a json object
@@ -145,10 +190,43 @@ namespace our {
             return;
 
         sampler = AssetLoader<Sampler>::get(data.value("sampler", ""));
-        albedo = AssetLoader<Texture2D>::get(data.value("albedo", ""));
-        specular = AssetLoader<Texture2D>::get(data.value("specular", ""));
-        emissive = AssetLoader<Texture2D>::get(data.value("emissive", ""));
-        roughness = AssetLoader<Texture2D>::get(data.value("roughness", ""));
-        ambient_occlusion = AssetLoader<Texture2D>::get(data.value("ambient_occlusion", ""));
+        std::string arrayName = data.value("textureArray", "");
+        textureArray = AssetLoader<TextureArray>::get(arrayName);
+        ShaderDefines defines;
+        if (textureArray != nullptr) {
+            // The maps are the names of layers of the array (a map whose layer is not found is treated as missing, so it is not sampled)
+            albedo = specular = emissive = roughness = ambient_occlusion = nullptr;
+            albedoLayer = getArrayLayer(textureArray, arrayName, data.value("albedo", ""));
+            specularLayer = getArrayLayer(textureArray, arrayName, data.value("specular", ""));
+            emissiveLayer = getArrayLayer(textureArray, arrayName, data.value("emissive", ""));
+            roughnessLayer = getArrayLayer(textureArray, arrayName, data.value("roughness", ""));
+            ambientOcclusionLayer = getArrayLayer(textureArray, arrayName, data.value("ambient_occlusion", ""));
+            defines.push_back("TEXTURE_ARRAY");
+            if (albedoLayer >= 0) defines.push_back("HAS_ALBEDO");
+            if (specularLayer >= 0) defines.push_back("HAS_SPECULAR");
+            if (emissiveLayer >= 0) defines.push_back("HAS_EMISSIVE");
+            if (roughnessLayer >= 0) defines.push_back("HAS_ROUGHNESS");
+            if (ambientOcclusionLayer >= 0) defines.push_back("HAS_AO");
+        } else {
+            albedo = AssetLoader<Texture2D>::get(data.value("albedo", ""));
+            specular = AssetLoader<Texture2D>::get(data.value("specular", ""));
+            emissive = AssetLoader<Texture2D>::get(data.value("emissive", ""));
+            roughness = AssetLoader<Texture2D>::get(data.value("roughness", ""));
+            ambient_occlusion = AssetLoader<Texture2D>::get(data.value("ambient_occlusion", ""));
+            if (albedo != nullptr) defines.push_back("HAS_ALBEDO");
+            if (specular != nullptr) defines.push_back("HAS_SPECULAR");
+            if (emissive != nullptr) defines.push_back("HAS_EMISSIVE");
+            if (roughness != nullptr) defines.push_back("HAS_ROUGHNESS");
+            if (ambient_occlusion != nullptr) defines.push_back("HAS_AO");
+        }
+
+        // The shader only samples the maps that this material has, so a material without (for example) an emissive map
+        // doesn't pay for reading one. The materials with the same maps share the same permutation.
+        ShaderProgram* base = shader;
+        shader = shader_permutations::get(base, defines);
+        if (data.value("instanced", false)) {
+            defines.push_back("INSTANCED");
+            instancedShader = shader_permutations::get(base, defines);
+        }
     }
 }
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "pipeline-state.hpp"
 #include "../texture/texture2d.hpp"
+#include "../texture/texture-array.hpp"
 #include "../texture/sampler.hpp"
 #include "../shader/shader.hpp"
 
@@ -16,14 +17,23 @@ namespace our {
     // 2- The shader program used to draw objects using this material
     // 3- Whether this material is transparent or not
     // Materials that send uniforms to the shader should inherit from the is material and add the required uniforms
+    // A material can also have an instanced variant of its shader which reads the model matrices from per instance attributes
+    // (see "Mesh::drawInstanced"), so the renderer can draw many objects sharing the material & the mesh in a single draw call
     class Material {
     public:
         PipelineState pipelineState;
         ShaderProgram* shader;
+        ShaderProgram* instancedShader = nullptr;
         bool transparent;
+
+        // Returns the shader used to draw with this material (the instanced variant if "instanced" is true and the material has one)
+        ShaderProgram* getShader(bool instanced) const {
+            return instanced && instancedShader ? instancedShader : shader;
+        }
         
         // This function does 2 things: setup the pipeline state and set the shader program to be used
-        virtual void setup() const;
+        // If "instanced" is true, the instanced shader is used and the uniforms are sent to it
+        virtual void setup(bool instanced = false) const;
         // This function read a material from a json object
         virtual void deserialize(const nlohmann::json& data);
     };
@@ -34,7 +44,7 @@ namespace our {
     public:
         glm::vec4 tint;
 
-        void setup() const override;
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
     };
 
@@ -43,23 +53,35 @@ namespace our {
     // - "tex" which is a Sampler2D. "texture" and "sampler" will be bound to it.
     // - "alphaThreshold" which defined the alpha limit below which the pixel should be discarded
     // An example where this material can be used is when the object has a texture
+    // If "textureArray" is set, the texture is the layer "layer" of the array instead, and the shader reads it from the
+    // "sampler2DArray" uniform "tex" with the layer in the "layer" uniform (see "textured-array.frag")
     class TexturedMaterial : public TintedMaterial {
     public:
         Texture2D* texture;
+        TextureArray* textureArray = nullptr;
+        int layer = 0;
         Sampler* sampler;
         float alphaThreshold;
 
-        void setup() const override;
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
     };
 
 		// Light material will inherit from the  material and define all texture types for the light material.
+    // If "textureArray" is set, the maps are layers of that array instead of separate textures: the array is bound once to unit 0
+    // and the shader gets the layer of every map (see TEXTURE_ARRAY in "lighted.frag"). The materials that share an array
+    // (e.g. the buildings) are switched without binding any texture.
+    // The shader is replaced by its permutation that only samples the maps the material has (see "shader_permutations"),
+    // and "instanced" (optional, default=false) makes the INSTANCED permutation the instanced shader.
     class LightMaterial : public Material {
     public:
         Texture2D *albedo, *specular, *emissive, *roughness, *ambient_occlusion;
+        TextureArray* textureArray = nullptr;
+        // The layers of the maps in "textureArray" (-1 for the maps the material doesn't have)
+        int albedoLayer = -1, specularLayer = -1, emissiveLayer = -1, roughnessLayer = -1, ambientOcclusionLayer = -1;
         Sampler* sampler;
 
-        void setup() const override;
+        void setup(bool instanced = false) const override;
         void deserialize(const nlohmann::json& data) override;
     };
 
@@ -4,6 +4,8 @@
 #include <glm/vec4.hpp>
 #include <json/json.hpp>
 
+#include "../gl-state-cache.hpp"
+
 namespace our {
     // There are some options in the render pipeline that we cannot control via shaders
     // such as blending, depth testing and so on
@@ -40,8 +42,10 @@ namespace our {
 
         // This function should set the OpenGL options to the values specified by this structure
         // For example, if faceCulling.enabled is true, you should call glEnable(GL_CULL_FACE), otherwise, you should call glDisable(GL_CULL_FACE)
+        // All the calls go through the state cache, so only the options that differ from the current OpenGL state reach the driver
         void setup() const {
             // TODO: (Req 4) Write this function
+            GLStateCache& state = GLStateCache::get();
             // Check if face culling is enabled then set the culling face and front face
             // We know the culling face and front face as we send to it if it's a CCW or CW
             // Counter clockwise-> Front Face
@@ -49,47 +53,47 @@ namespace our {
             // If we rotated the object 180 degree then the faces will be changed
             if (faceCulling.enabled) {
                 // Firstly we need to enable GL_CULL_FACE
-                glEnable(GL_CULL_FACE);
+                state.setEnabled(GL_CULL_FACE, true);
                 // Which faces we will remove
-                glCullFace(faceCulling.culledFace);
+                state.cullFaceMode(faceCulling.culledFace);
                 // Direction of the front face that won't be removed
-                glFrontFace(faceCulling.frontFace);
+                state.frontFaceMode(faceCulling.frontFace);
             }
             else {
                 // Else disable face culling
-                glDisable(GL_CULL_FACE);
+                state.setEnabled(GL_CULL_FACE, false);
             }
 
             // Check if depth testing is enabled then set the depth function
             // and specify the color and depth mask
             if (depthTesting.enabled) {
                 // Firstly we need to enable GL_DEPTH_TEST
-                glEnable(GL_DEPTH_TEST);
+                state.setEnabled(GL_DEPTH_TEST, true);
                 // Which method should we choose to make the depth testing
-                glDepthFunc(depthTesting.function);
+                state.depthFunc(depthTesting.function);
                 // Set the color & depth mask using the GL functions & simply passing them
-                glColorMask(colorMask.r, colorMask.g, colorMask.b, colorMask.a);
-                glDepthMask(depthMask);
+                state.setColorMask(colorMask.r, colorMask.g, colorMask.b, colorMask.a);
+                state.setDepthMask(depthMask);
             }
             else {
                 // Else disable depth testing
-                glDisable(GL_DEPTH_TEST);
+                state.setEnabled(GL_DEPTH_TEST, false);
             }
 
             // Check if blending is enabled then set the blending equation, source factor and destination factor
             // and specify the constant color
             if (blending.enabled) {
                 // Firstly we need to enable GL_BLEND
-                glEnable(GL_BLEND);
+                state.setEnabled(GL_BLEND, true);
                 // Set the blending equation, source factor and destination factor
-                glBlendEquation(blending.equation);
-                glBlendFunc(blending.sourceFactor, blending.destinationFactor);
+                state.blendEquationMode(blending.equation);
+                state.blendFunc(blending.sourceFactor, blending.destinationFactor);
                 // Retrieve the constant color from blending and set as our blend color
-                glBlendColor(blending.constantColor.r, blending.constantColor.g, blending.constantColor.b, blending.constantColor.a);
+                state.setBlendColor(blending.constantColor);
             }
             else {
                 // Else disable blending
-                glDisable(GL_BLEND);
+                state.setEnabled(GL_BLEND, false);
             }
         }
 
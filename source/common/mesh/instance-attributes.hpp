@@ -0,0 +1,41 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include "vertex.hpp"
+
+#include <cstddef>
+
+namespace our {
+
+    // Points the per instance attributes of the bound vertex array at "offset" (in bytes) of "instanceBuffer": every instance has its
+    // model matrix (ATTRIB_LOC_MODEL) followed by the inverse transpose of the model matrix if "normalMatrix" is true (ATTRIB_LOC_MODEL_IT).
+    // The attributes are pointed at the data of every draw since the buffer is shared by all the meshes.
+    inline void setupInstanceAttributes(GLuint instanceBuffer, size_t offset, bool normalMatrix) {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        GLsizei stride = (GLsizei)((normalMatrix ? 2 : 1) * sizeof(glm::mat4));
+        for(GLuint column = 0; column < 4; column++){
+            glVertexAttribPointer(ATTRIB_LOC_MODEL + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + column * sizeof(glm::vec4)));
+            glVertexAttribDivisor(ATTRIB_LOC_MODEL + column, 1);
+            glEnableVertexAttribArray(ATTRIB_LOC_MODEL + column);
+            if(normalMatrix){
+                glVertexAttribPointer(ATTRIB_LOC_MODEL_IT + column, 4, GL_FLOAT, GL_FALSE, stride, (void*)(offset + sizeof(glm::mat4) + column * sizeof(glm::vec4)));
+                glVertexAttribDivisor(ATTRIB_LOC_MODEL_IT + column, 1);
+                glEnableVertexAttribArray(ATTRIB_LOC_MODEL_IT + column);
+            } else {
+                glDisableVertexAttribArray(ATTRIB_LOC_MODEL_IT + column);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // Disables the per instance attributes of the bound vertex array after an instanced draw. The vertex array of the mesh arena is shared
+    // by all its meshes, so the attributes would otherwise stay enabled for the regular draws that follow.
+    inline void disableInstanceAttributes() {
+        for(GLuint column = 0; column < 4; column++){
+            glDisableVertexAttribArray(ATTRIB_LOC_MODEL + column);
+            glDisableVertexAttribArray(ATTRIB_LOC_MODEL_IT + column);
+        }
+    }
+
+}
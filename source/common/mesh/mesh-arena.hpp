@@ -0,0 +1,192 @@
+#pragma once
+
+#include <glad/gl.h>
+#include "vertex.hpp"
+#include "instance-attributes.hpp"
+#include "../gl-state-cache.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+namespace our {
+
+    // A draw in an indirect command buffer, in the layout that glMultiDrawElementsIndirect reads.
+    // "baseInstance" is the index of the first instance of the draw in the per instance attributes.
+    struct DrawElementsIndirectCommand {
+        GLuint count;
+        GLuint instanceCount;
+        GLuint firstIndex;
+        GLint baseVertex;
+        GLuint baseInstance;
+    };
+    static_assert(sizeof(DrawElementsIndirectCommand) == 20, "The indirect commands must be tightly packed");
+
+    // The mesh arena is a single vertex buffer & element buffer (with a single vertex array) that holds the data of many static meshes.
+    // A mesh in the arena only remembers where its vertices & elements start, and it is drawn with a base vertex draw call.
+    // Since all the meshes in the arena share the same vertex array, drawing them one after the other never rebinds a vertex array
+    // (the state cache skips the bind), and consecutive draws only differ by their offsets.
+    // The arena only grows: the space of a deleted mesh is not reused, but the arena is reset when its last mesh is deleted.
+    // Since every mesh of the arena is just a range of the same buffers, many of them can be drawn by a single multi draw (see "drawIndirect").
+    class MeshArena {
+        GLuint VAO = 0, VBO = 0, EBO = 0;
+        size_t vertexCapacity = 0, elementCapacity = 0; // The sizes of the buffers (in vertices & elements)
+        size_t vertexCount = 0, elementCount = 0;       // How many vertices & elements are used
+        size_t meshCount = 0;                            // The number of meshes that live in the arena
+        bool enabled = false;
+
+        // Creates the buffers with the given capacities and points the vertex array at them
+        void create(size_t vertices, size_t elements) {
+            glGenVertexArrays(1, &VAO);
+            GLStateCache::get().bindVertexArray(VAO);
+            glGenBuffers(1, &VBO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferData(GL_ARRAY_BUFFER, vertices * sizeof(Vertex), nullptr, GL_STATIC_DRAW);
+            glGenBuffers(1, &EBO);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, elements * sizeof(GLuint), nullptr, GL_STATIC_DRAW);
+            vertexCapacity = vertices;
+            elementCapacity = elements;
+            setupAttributes();
+        }
+
+        // Points the vertex attributes of the vertex array at the vertex buffer (which must be bound to GL_ARRAY_BUFFER)
+        static void setupAttributes() {
+            glVertexAttribPointer(ATTRIB_LOC_POSITION, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, position));
+            glEnableVertexAttribArray(ATTRIB_LOC_POSITION);
+            glVertexAttribPointer(ATTRIB_LOC_COLOR, 3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex), (void*)offsetof(Vertex, color));
+            glEnableVertexAttribArray(ATTRIB_LOC_COLOR);
+            glVertexAttribPointer(ATTRIB_LOC_TEXCOORD, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coord));
+            glEnableVertexAttribArray(ATTRIB_LOC_TEXCOORD);
+            glVertexAttribPointer(ATTRIB_LOC_NORMAL, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
+            glEnableVertexAttribArray(ATTRIB_LOC_NORMAL);
+        }
+
+        // Moves the content of the buffer to a new bigger buffer (the old one is deleted)
+        static GLuint grow(GLenum target, GLuint buffer, size_t usedBytes, size_t newBytes) {
+            GLuint grown;
+            glGenBuffers(1, &grown);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, grown);
+            glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+            if(usedBytes > 0) glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, usedBytes);
+            glBindBuffer(GL_COPY_READ_BUFFER, 0);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+            glDeleteBuffers(1, &buffer);
+            // The new buffer is bound to the target so that the vertex array can be pointed at it
+            glBindBuffer(target, grown);
+            return grown;
+        }
+
+        // Makes sure that the buffers have room for the given number of extra vertices & elements
+        void reserve(size_t vertices, size_t elements) {
+            if(!VAO){
+                // The first allocation is big enough for a few typical models
+                create(std::max<size_t>(vertices, 1 << 16), std::max<size_t>(elements, 1 << 18));
+                return;
+            }
+            GLStateCache::get().bindVertexArray(VAO);
+            if(vertexCount + vertices > vertexCapacity){
+                size_t capacity = std::max(vertexCapacity * 2, vertexCount + vertices);
+                VBO = grow(GL_ARRAY_BUFFER, VBO, vertexCount * sizeof(Vertex), capacity * sizeof(Vertex));
+                vertexCapacity = capacity;
+                setupAttributes();
+            }
+            if(elementCount + elements > elementCapacity){
+                size_t capacity = std::max(elementCapacity * 2, elementCount + elements);
+                // The element buffer binding is part of the vertex array state, so binding the new buffer also updates the vertex array
+                EBO = grow(GL_ELEMENT_ARRAY_BUFFER, EBO, elementCount * sizeof(GLuint), capacity * sizeof(GLuint));
+                elementCapacity = capacity;
+            }
+        }
+
+    public:
+        // Where the data of a mesh starts in the arena
+        struct Range {
+            GLint baseVertex = 0;   // The index of the first vertex (added to every element by the draw call)
+            GLuint firstElement = 0;
+        };
+
+        // Returns the arena of the application's OpenGL context
+        static MeshArena& get() {
+            static MeshArena arena;
+            return arena;
+        }
+
+        // The asset loader only puts the meshes in the arena if it is enabled (see "deserializeAllAssets")
+        void setEnabled(bool enabled) { this->enabled = enabled; }
+        bool isEnabled() const { return enabled; }
+
+        // Copies the vertices & elements to the arena and returns where they start
+        Range add(const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements) {
+            reserve(vertices.size(), elements.size());
+            GLStateCache::get().bindVertexArray(VAO);
+            glBindBuffer(GL_ARRAY_BUFFER, VBO);
+            glBufferSubData(GL_ARRAY_BUFFER, vertexCount * sizeof(Vertex), vertices.size() * sizeof(Vertex), vertices.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, elementCount * sizeof(GLuint), elements.size() * sizeof(GLuint), elements.data());
+            Range range;
+            range.baseVertex = (GLint)vertexCount;
+            range.firstElement = (GLuint)elementCount;
+            vertexCount += vertices.size();
+            elementCount += elements.size();
+            meshCount++;
+            return range;
+        }
+
+        // Should be called when a mesh in the arena is deleted, the buffers are deleted with the last mesh
+        void release() {
+            if(meshCount == 0 || --meshCount > 0) return;
+            GLStateCache::get().forgetVertexArray(VAO);
+            glDeleteVertexArrays(1, &VAO);
+            glDeleteBuffers(1, &VBO);
+            glDeleteBuffers(1, &EBO);
+            VAO = VBO = EBO = 0;
+            vertexCapacity = elementCapacity = vertexCount = elementCount = 0;
+        }
+
+        // Returns whether the driver can submit a whole list of indirect commands in one call (OpenGL 4.3 or GL_ARB_multi_draw_indirect)
+        static bool supportsMultiDrawIndirect() {
+            return (GLAD_GL_VERSION_4_3 || GLAD_GL_ARB_multi_draw_indirect) && glMultiDrawElementsIndirect != nullptr;
+        }
+
+        // Draws the given commands (whose ranges are meshes of this arena) with the instance data at "instanceOffset" of "instanceBuffer"
+        // (see "setupInstanceAttributes"), the instances of a command start at its "baseInstance". If the driver supports it, all the commands
+        // are submitted by a single glMultiDrawElementsIndirect that reads them from "indirectBuffer" at "indirectOffset" (where the same
+        // commands must have been uploaded). Otherwise (OpenGL 3.3 has neither multi draws nor base instances), the commands are drawn by
+        // a loop of instanced draws that point the instance attributes at the first instance of every command.
+        // Returns the number of draw calls that were made.
+        size_t drawIndirect(const DrawElementsIndirectCommand* commands, GLsizei count, GLuint indirectBuffer, GLintptr indirectOffset,
+                            GLuint instanceBuffer, size_t instanceOffset, bool normalMatrix) {
+            if(!VAO || count == 0) return 0;
+            GLStateCache::get().bindVertexArray(VAO);
+            size_t drawCalls = 0;
+            if(indirectBuffer != 0 && supportsMultiDrawIndirect()){
+                setupInstanceAttributes(instanceBuffer, instanceOffset, normalMatrix);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)indirectOffset, count, 0);
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+                drawCalls = 1;
+            } else {
+                size_t instanceSize = (normalMatrix ? 2 : 1) * sizeof(glm::mat4);
+                for(GLsizei index = 0; index < count; index++){
+                    const DrawElementsIndirectCommand& command = commands[index];
+                    setupInstanceAttributes(instanceBuffer, instanceOffset + command.baseInstance * instanceSize, normalMatrix);
+                    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, (GLsizei)command.count, GL_UNSIGNED_INT,
+                        (void*)(command.firstIndex * sizeof(GLuint)), (GLsizei)command.instanceCount, command.baseVertex);
+                }
+                drawCalls = count;
+            }
+            disableInstanceAttributes();
+            return drawCalls;
+        }
+
+        // Returns the vertex array shared by all the meshes in the arena
+        GLuint getVertexArray() const { return VAO; }
+        // Returns the number of meshes, vertices & elements in the arena
+        size_t getMeshCount() const { return meshCount; }
+        size_t getVertexCount() const { return vertexCount; }
+        size_t getElementCount() const { return elementCount; }
+    };
+
+}
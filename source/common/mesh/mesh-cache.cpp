@@ -0,0 +1,172 @@
+#include "mesh-cache.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace our::mesh_cache {
+
+    // The cache files are copied to and from memory as they are, so everything in them must be plain data
+    static_assert(std::is_trivially_copyable_v<MeshCacheHeader> && std::is_trivially_copyable_v<Vertex> && std::is_trivially_copyable_v<Submesh>);
+
+    static std::atomic<bool> enabled{false};
+
+    void setEnabled(bool value) { enabled = value; }
+    bool isEnabled() { return enabled; }
+
+    std::string getPath(const std::string& source) { return source + ".mesh"; }
+
+    // Gets the size & the last write time of the source file (they tie the cache to the current version of the source)
+    static bool getSourceStamp(const std::string& source, int64_t& time, uint64_t& size) {
+        std::error_code error;
+        auto writeTime = std::filesystem::last_write_time(source, error);
+        if(error) return false;
+        auto fileSize = std::filesystem::file_size(source, error);
+        if(error) return false;
+        time = (int64_t)writeTime.time_since_epoch().count();
+        size = (uint64_t)fileSize;
+        return true;
+    }
+
+    // A read-only memory map of a whole file. The pages are read by the OS when they are touched,
+    // so the file is read once (straight into the page cache) instead of through a stream buffer.
+    class MappedFile {
+        const unsigned char* data = nullptr;
+        size_t size = 0;
+#if defined(_WIN32)
+        HANDLE file = INVALID_HANDLE_VALUE, mapping = nullptr;
+#endif
+    public:
+        explicit MappedFile(const std::string& path) {
+#if defined(_WIN32)
+            file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if(file == INVALID_HANDLE_VALUE) return;
+            LARGE_INTEGER fileSize;
+            if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) return;
+            mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if(!mapping) return;
+            data = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if(data) size = (size_t)fileSize.QuadPart;
+#else
+            int descriptor = open(path.c_str(), O_RDONLY);
+            if(descriptor < 0) return;
+            struct stat status;
+            if(fstat(descriptor, &status) == 0 && status.st_size > 0){
+                void* mapped = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+                if(mapped != MAP_FAILED){
+                    data = (const unsigned char*)mapped;
+                    size = (size_t)status.st_size;
+                }
+            }
+            // The mapping stays valid after the file is closed
+            close(descriptor);
+#endif
+        }
+
+        ~MappedFile() {
+#if defined(_WIN32)
+            if(data) UnmapViewOfFile(data);
+            if(mapping) CloseHandle(mapping);
+            if(file != INVALID_HANDLE_VALUE) CloseHandle(file);
+#else
+            if(data) munmap((void*)data, size);
+#endif
+        }
+
+        const unsigned char* getData() const { return data; }
+        size_t getSize() const { return size; }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+    };
+
+    bool read(const std::string& source, std::vector<Vertex>& vertices, std::vector<GLuint>& elements, std::vector<Submesh>* submeshes) {
+        int64_t sourceTime; uint64_t sourceSize;
+        if(!getSourceStamp(source, sourceTime, sourceSize)) return false;
+
+        MappedFile file(getPath(source));
+        if(file.getSize() < sizeof(MeshCacheHeader)) return false;
+        MeshCacheHeader header;
+        std::memcpy(&header, file.getData(), sizeof(header));
+        if(std::memcmp(header.magic, "OMSH", 4) != 0 || header.version != VERSION || header.vertexSize != sizeof(Vertex)) return false;
+        // The source changed since the cache was written
+        if(header.sourceTime != sourceTime || header.sourceSize != sourceSize) return false;
+        size_t submeshBytes = (size_t)header.submeshCount * sizeof(Submesh);
+        size_t vertexBytes = (size_t)header.vertexCount * sizeof(Vertex);
+        size_t elementBytes = (size_t)header.elementCount * sizeof(GLuint);
+        if(file.getSize() != sizeof(MeshCacheHeader) + submeshBytes + vertexBytes + elementBytes) return false;
+
+        const unsigned char* cursor = file.getData() + sizeof(MeshCacheHeader);
+        if(submeshes){
+            submeshes->resize(header.submeshCount);
+            std::memcpy(submeshes->data(), cursor, submeshBytes);
+        }
+        cursor += submeshBytes;
+        vertices.resize(header.vertexCount);
+        std::memcpy(vertices.data(), cursor, vertexBytes);
+        cursor += vertexBytes;
+        elements.resize(header.elementCount);
+        std::memcpy(elements.data(), cursor, elementBytes);
+        return true;
+    }
+
+    bool write(const std::string& source, const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, const std::vector<Submesh>& submeshes) {
+        MeshCacheHeader header = {};
+        std::memcpy(header.magic, "OMSH", 4);
+        header.version = VERSION;
+        if(!getSourceStamp(source, header.sourceTime, header.sourceSize)){
+            std::cerr << "Failed to write the mesh cache of \"" << source << "\": the source file does not exist" << std::endl;
+            return false;
+        }
+        header.vertexSize = sizeof(Vertex);
+        header.vertexCount = (uint32_t)vertices.size();
+        header.elementCount = (uint32_t)elements.size();
+        header.submeshCount = (uint32_t)submeshes.size();
+        header.boundsMin = header.boundsMax = vertices.empty() ? glm::vec3(0) : vertices[0].position;
+        for(const Vertex& vertex : vertices){
+            header.boundsMin = glm::min(header.boundsMin, vertex.position);
+            header.boundsMax = glm::max(header.boundsMax, vertex.position);
+        }
+
+        // The file is written under a temporary name then renamed, so a reader never maps a half written cache
+        std::string path = getPath(source), temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!file){
+                std::cerr << "Failed to write the mesh cache: couldn't open \"" << temporaryPath << "\"" << std::endl;
+                return false;
+            }
+            file.write((const char*)&header, sizeof(header));
+            file.write((const char*)submeshes.data(), submeshes.size() * sizeof(Submesh));
+            file.write((const char*)vertices.data(), vertices.size() * sizeof(Vertex));
+            file.write((const char*)elements.data(), elements.size() * sizeof(GLuint));
+            if(!file){
+                std::cerr << "Failed to write the mesh cache \"" << temporaryPath << "\"" << std::endl;
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if(error){
+            std::cerr << "Failed to write the mesh cache \"" << path << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "vertex.hpp"
+
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    // A range of elements that came from a single shape of the source file (e.g. an "o" or "g" block in an ".obj")
+    struct Submesh {
+        GLuint firstElement = 0;
+        GLuint elementCount = 0;
+    };
+
+    // The binary mesh cache stores the vertices & elements of a model exactly as the mesh uploads them, so loading a model
+    // is a memory map and two copies instead of parsing the text file and removing the duplicated vertices again.
+    // The cache of "assets/models/car.obj" is "assets/models/car.obj.mesh" and it is laid out as follows:
+    //      MeshCacheHeader, Submesh[submeshCount], Vertex[vertexCount], GLuint[elementCount]
+    // The header remembers the size & the last write time of the source, so a cache whose source was edited is not used.
+    namespace mesh_cache {
+
+        struct MeshCacheHeader {
+            char magic[4];          // "OMSH"
+            uint32_t version;       // VERSION when the file was written
+            int64_t sourceTime;     // The last write time of the source file
+            uint64_t sourceSize;    // The size of the source file in bytes
+            uint32_t vertexSize;    // sizeof(Vertex) when the file was written (the vertices are stored as they are in memory)
+            uint32_t vertexCount, elementCount, submeshCount;
+            glm::vec3 boundsMin, boundsMax; // The bounding box of the vertices
+        };
+
+        // Increase it whenever the layout of the file (or of the vertex) changes
+        constexpr uint32_t VERSION = 1;
+
+        // Enables or disables the cache for "mesh_utils::loadOBJ" (it is disabled by default)
+        void setEnabled(bool enabled);
+        bool isEnabled();
+
+        // Returns the path of the cache file of the given source file
+        std::string getPath(const std::string& source);
+
+        // Reads the cache of the given source file. Returns false if there is no cache or if it is out of date or invalid
+        // (in that case, the source should be parsed then written to the cache).
+        bool read(const std::string& source, std::vector<Vertex>& vertices, std::vector<GLuint>& elements, std::vector<Submesh>* submeshes = nullptr);
+
+        // Writes the cache of the given source file. Returns false (and prints the reason) if the file could not be written.
+        bool write(const std::string& source, const std::vector<Vertex>& vertices, const std::vector<GLuint>& elements, const std::vector<Submesh>& submeshes);
+    }
+
+}
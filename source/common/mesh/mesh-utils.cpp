@@ -4,15 +4,432 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tinyobj/tiny_obj_loader.h>
 
+#include "../thread-pool.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <limits>
 #include <vector>
 #include <unordered_map>
 
-our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
+our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename, MeshArena* arena) {
 
     // The data that we will use to initialize our mesh
     std::vector<our::Vertex> vertices;
     std::vector<GLuint> elements;
+    if(!readOBJ(filename, vertices, elements)) return nullptr;
+
+    if(arena) return new our::Mesh(vertices, elements, *arena);
+    return new our::Mesh(vertices, elements);
+}
+
+bool our::mesh_utils::readOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements) {
+    if(!mesh_cache::isEnabled()) return parseOBJ(filename, vertices, elements);
+    if(mesh_cache::read(filename, vertices, elements)) return true;
+    std::vector<Submesh> submeshes;
+    if(!parseOBJ(filename, vertices, elements, &submeshes)) return false;
+    // A failed write only costs parsing the file again next time, so the mesh is still loaded
+    mesh_cache::write(filename, vertices, elements, submeshes);
+    return true;
+}
+
+// The parallel OBJ parser works in the following passes, each of them spread over the threads of the parse pool:
+// 1- The file is split into chunks of whole lines and every chunk is parsed on its own (positions, colors, normals, texture coordinates & faces).
+//    The numbers are read with the same function as Tiny OBJ Loader so every float gets the exact same bits.
+// 2- The chunks are joined: the attributes of every chunk are copied after those of the previous chunks and the relative (negative) indices are resolved.
+// 3- The faces are split into triangles (polygons go through the triangulation of Tiny OBJ Loader, so the triangles are the same).
+// 4- Every triangle corner is hashed, and the corners are sorted into shards by their hash. Every shard removes its duplicates
+//    with its own open addressing table, walking its corners in the order of the file so it finds the first corner of every vertex.
+// 5- Finally, the vertices are numbered in the order of their first corner, which gives the exact same output as the old single threaded loader.
+namespace {
+
+    using namespace our;
+
+    // Files smaller than this are parsed as a single chunk (splitting them costs more than it saves)
+    constexpr size_t MIN_CHUNK_SIZE = 256 * 1024;
+    // The number of shards used to remove the duplicated vertices (a power of 2, since it is picked from the top bits of the hash)
+    constexpr size_t DEDUPLICATION_SHARD_BITS = 6;
+    constexpr size_t DEDUPLICATION_SHARDS = size_t(1) << DEDUPLICATION_SHARD_BITS;
+
+    // The workers that parse the models. It is not the pool of the asset streamer, since a streamer job waits for this pool to parse its model
+    // (if it was the same pool, the jobs of the streamer could be waiting for each other).
+    ThreadPool& getParsePool() {
+        static ThreadPool pool;
+        return pool;
+    }
+
+    // The indices of the attributes of a face corner (-1 if the corner doesn't have the attribute)
+    struct Corner {
+        int position = -1, texcoord = -1, normal = -1;
+    };
+
+    // What a chunk of lines contains
+    struct ObjChunk {
+        const char *begin, *end;
+        std::vector<float> positions, colors, normals, texcoords;
+        std::vector<Corner> corners;            // The corners of all the faces, one face after the other
+        std::vector<uint32_t> faceSizes;        // The number of corners of every face
+        std::vector<uint8_t> relative;          // For every corner, a bit per attribute whose index is relative to the attributes before the chunk
+        std::vector<uint32_t> shapeStarts;      // The faces that start a new shape (an "o" or a "g" line came before them)
+        size_t lineCount = 0;
+        size_t errorLine = 0;                   // The line (in the chunk, starting at 1) that could not be parsed, 0 if there is none
+        // Filled by the triangulation
+        std::vector<Corner> triangles;          // 3 corners per triangle
+        std::vector<uint32_t> shapeElements;    // The element (in "triangles") at which every shape of "shapeStarts" starts
+        size_t firstCorner = 0;                 // The index of the first triangle corner of the chunk in the whole file
+    };
+
+    inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+    // Reads a number like Tiny OBJ Loader's "parseReal", returns false (and leaves "value" unchanged) if there is no number
+    inline bool parseReal(const char*& cursor, const char* end, float& value) {
+        while(cursor < end && isBlank(*cursor)) cursor++;
+        const char* tokenEnd = cursor;
+        while(tokenEnd < end && !isBlank(*tokenEnd) && *tokenEnd != '\r') tokenEnd++;
+        double parsed;
+        bool found = tinyobj::tryParseDouble(cursor, tokenEnd, &parsed);
+        if(found) value = static_cast<float>(parsed);
+        cursor = tokenEnd;
+        return found;
+    }
+
+    // Reads an integer like "atoi" (0 if there is no number)
+    inline int parseIndex(const char*& cursor, const char* end) {
+        while(cursor < end && (isBlank(*cursor) || *cursor == '\v' || *cursor == '\f' || *cursor == '\r')) cursor++;
+        bool negative = false;
+        if(cursor < end && (*cursor == '-' || *cursor == '+')) negative = *cursor++ == '-';
+        int value = 0;
+        while(cursor < end && *cursor >= '0' && *cursor <= '9') value = value * 10 + (*cursor++ - '0');
+        return negative ? -value : value;
+    }
+
+    // Reads an index and makes it 0 based (like Tiny OBJ Loader's "fixIndex"). Negative indices are relative to "count" (the attributes read so far),
+    // since the count only includes this chunk, the index is marked in "relative" so the attributes of the previous chunks can be added later.
+    inline bool parseCornerIndex(const char*& cursor, const char* end, int count, int& index, uint8_t& relative, uint8_t bit) {
+        int value = parseIndex(cursor, end);
+        if(value == 0) return false; // Zero is not allowed by the format
+        if(value > 0) index = value - 1;
+        else { index = count + value; relative |= bit; }
+        while(cursor < end && *cursor != '/' && !isBlank(*cursor) && *cursor != '\r') cursor++;
+        return true;
+    }
+
+    // Parses a line (without its line break) into the chunk. Returns false if the line is invalid.
+    bool parseLine(ObjChunk& chunk, const char* cursor, const char* end) {
+        while(cursor < end && isBlank(*cursor)) cursor++;
+        // Every statement we need is a letter (or two) followed by a blank, the others (comments, materials, lines, ...) are skipped
+        if(end - cursor < 2) return true;
+        bool oneLetter = isBlank(cursor[1]), twoLetters = end - cursor >= 3 && isBlank(cursor[2]);
+
+        if(cursor[0] == 'v' && oneLetter){
+            cursor += 2;
+            float x = 0, y = 0, z = 0, r, g, b;
+            parseReal(cursor, end, x); parseReal(cursor, end, y); parseReal(cursor, end, z);
+            // Like Tiny OBJ Loader, a vertex without a color is white
+            if(!(parseReal(cursor, end, r) && parseReal(cursor, end, g) && parseReal(cursor, end, b))) r = g = b = 1;
+            chunk.positions.insert(chunk.positions.end(), {x, y, z});
+            chunk.colors.insert(chunk.colors.end(), {r, g, b});
+        } else if(cursor[0] == 'v' && cursor[1] == 'n' && twoLetters){
+            cursor += 3;
+            float x = 0, y = 0, z = 0;
+            parseReal(cursor, end, x); parseReal(cursor, end, y); parseReal(cursor, end, z);
+            chunk.normals.insert(chunk.normals.end(), {x, y, z});
+        } else if(cursor[0] == 'v' && cursor[1] == 't' && twoLetters){
+            cursor += 3;
+            float u = 0, v = 0;
+            parseReal(cursor, end, u); parseReal(cursor, end, v);
+            chunk.texcoords.insert(chunk.texcoords.end(), {u, v});
+        } else if(cursor[0] == 'f' && oneLetter){
+            cursor += 2;
+            while(cursor < end && isBlank(*cursor)) cursor++;
+            uint32_t size = 0;
+            while(cursor < end){
+                // The corner is "v", "v/vt", "v//vn" or "v/vt/vn"
+                Corner corner;
+                uint8_t relative = 0;
+                if(!parseCornerIndex(cursor, end, (int)chunk.positions.size() / 3, corner.position, relative, 1)) return false;
+                if(cursor < end && *cursor == '/'){
+                    cursor++;
+                    if(cursor < end && *cursor == '/'){
+                        cursor++;
+                        if(!parseCornerIndex(cursor, end, (int)chunk.normals.size() / 3, corner.normal, relative, 4)) return false;
+                    } else {
+                        if(!parseCornerIndex(cursor, end, (int)chunk.texcoords.size() / 2, corner.texcoord, relative, 2)) return false;
+                        if(cursor < end && *cursor == '/'){
+                            cursor++;
+                            if(!parseCornerIndex(cursor, end, (int)chunk.normals.size() / 3, corner.normal, relative, 4)) return false;
+                        }
+                    }
+                }
+                chunk.corners.push_back(corner);
+                chunk.relative.push_back(relative);
+                size++;
+                while(cursor < end && (isBlank(*cursor) || *cursor == '\r')) cursor++;
+            }
+            chunk.faceSizes.push_back(size);
+        } else if((cursor[0] == 'o' || cursor[0] == 'g') && oneLetter){
+            chunk.shapeStarts.push_back((uint32_t)chunk.faceSizes.size());
+        }
+        return true;
+    }
+
+    void parseChunk(ObjChunk& chunk) {
+        const char* cursor = chunk.begin;
+        while(cursor < chunk.end){
+            const char* lineEnd = cursor;
+            while(lineEnd < chunk.end && *lineEnd != '\n' && *lineEnd != '\r') lineEnd++;
+            if(lineEnd < chunk.end && *lineEnd == '\n') chunk.lineCount++;
+            if(!parseLine(chunk, cursor, lineEnd)){
+                chunk.errorLine = chunk.lineCount + (lineEnd < chunk.end && *lineEnd == '\n' ? 0 : 1);
+                return;
+            }
+            cursor = lineEnd + 1;
+        }
+    }
+
+    // Splits the faces of the chunk into triangles. "positions" are the positions of the whole file (polygons need them to find their ears).
+    void triangulateChunk(ObjChunk& chunk, const std::vector<float>& positions) {
+        chunk.triangles.reserve(chunk.corners.size());
+        // Tiny OBJ Loader's triangulation works on groups of faces, so a polygon is put in a group of its own
+        tinyobj::PrimGroup group;
+        group.faceGroup.resize(1);
+        tinyobj::shape_t shape;
+        std::vector<tinyobj::tag_t> tags;
+        size_t corner = 0, nextShape = 0;
+        for(size_t face = 0; face < chunk.faceSizes.size(); face++){
+            while(nextShape < chunk.shapeStarts.size() && chunk.shapeStarts[nextShape] <= face){
+                chunk.shapeElements.push_back((uint32_t)chunk.triangles.size());
+                nextShape++;
+            }
+            uint32_t size = chunk.faceSizes[face];
+            if(size == 3){
+                // Triangles are kept as they are
+                chunk.triangles.insert(chunk.triangles.end(), chunk.corners.begin() + corner, chunk.corners.begin() + corner + 3);
+            } else if(size > 3){
+                auto& indices = group.faceGroup[0].vertex_indices;
+                indices.clear();
+                for(uint32_t index = 0; index < size; index++){
+                    const Corner& polygonCorner = chunk.corners[corner + index];
+                    indices.emplace_back(polygonCorner.position, polygonCorner.texcoord, polygonCorner.normal);
+                }
+                shape.mesh.indices.clear();
+                tinyobj::exportGroupsToShape(&shape, group, tags, -1, std::string(), true, positions);
+                for(const tinyobj::index_t& index : shape.mesh.indices)
+                    chunk.triangles.push_back({index.vertex_index, index.texcoord_index, index.normal_index});
+            }
+            corner += size;
+        }
+        while(nextShape < chunk.shapeStarts.size()){
+            chunk.shapeElements.push_back((uint32_t)chunk.triangles.size());
+            nextShape++;
+        }
+    }
+
+    // A well distributed 64 bit hash of the vertex value (every 32 bit word is mixed in, then the result goes through the finalizer of MurmurHash3).
+    // The floats are hashed after adding 0 so that -0 and +0 (which are equal) get the same hash.
+    inline uint64_t hashVertex(const Vertex& vertex) {
+        float floats[8] = {
+            vertex.position.x + 0.0f, vertex.position.y + 0.0f, vertex.position.z + 0.0f,
+            vertex.tex_coord.x + 0.0f, vertex.tex_coord.y + 0.0f,
+            vertex.normal.x + 0.0f, vertex.normal.y + 0.0f, vertex.normal.z + 0.0f
+        };
+        uint32_t words[9];
+        std::memcpy(words, floats, sizeof(floats));
+        std::memcpy(words + 8, &vertex.color, sizeof(uint32_t));
+        uint64_t hash = 0x9E3779B97F4A7C15ull;
+        for(uint32_t word : words){
+            hash ^= word;
+            hash *= 0xFF51AFD7ED558CCDull;
+            hash ^= hash >> 32;
+        }
+        hash ^= hash >> 33;
+        hash *= 0xC4CEB9FE1A85EC53ull;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+}
+
+bool our::mesh_utils::parseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements, std::vector<Submesh>* submeshes) {
+
+    // The whole file is read at once, then the chunks point into it
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
+    if(!file){
+        std::cerr << "Failed to load obj file \"" << filename << "\" due to error: Cannot open file" << std::endl;
+        return false;
+    }
+    std::vector<char> text((size_t)file.tellg());
+    file.seekg(0);
+    file.read(text.data(), text.size());
+    file.close();
+
+    ThreadPool& pool = getParsePool();
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+
+    // 1- Split the file into chunks of whole lines (a few per thread, so a slow chunk doesn't keep the other threads waiting) and parse them
+    size_t chunkCount = std::max<size_t>(1, std::min(text.size() / MIN_CHUNK_SIZE, (pool.getThreadCount() + 1) * 4));
+    std::vector<ObjChunk> chunks(chunkCount);
+    const char* chunkBegin = begin;
+    for(size_t index = 0; index < chunkCount; index++){
+        const char* chunkEnd = index + 1 == chunkCount ? end : std::max(chunkBegin, begin + text.size() * (index + 1) / chunkCount);
+        while(chunkEnd < end && *chunkEnd != '\n') chunkEnd++;
+        if(chunkEnd < end) chunkEnd++;
+        chunks[index].begin = chunkBegin;
+        chunks[index].end = chunkEnd;
+        chunkBegin = chunkEnd;
+    }
+    pool.parallelFor(chunkCount, [&](size_t index){ parseChunk(chunks[index]); });
+
+    size_t lineCount = 0;
+    for(const ObjChunk& chunk : chunks){
+        if(chunk.errorLine != 0){
+            std::cerr << "Failed to load obj file \"" << filename << "\" due to error: Failed to parse line " << lineCount + chunk.errorLine
+                      << " (e.g. zero value for an index)" << std::endl;
+            return false;
+        }
+        lineCount += chunk.lineCount;
+    }
+
+    // 2- Join the attributes of the chunks
+    std::vector<size_t> positionStarts(chunkCount), normalStarts(chunkCount), texcoordStarts(chunkCount);
+    size_t positionCount = 0, normalCount = 0, texcoordCount = 0;
+    for(size_t index = 0; index < chunkCount; index++){
+        positionStarts[index] = positionCount; positionCount += chunks[index].positions.size();
+        normalStarts[index] = normalCount; normalCount += chunks[index].normals.size();
+        texcoordStarts[index] = texcoordCount; texcoordCount += chunks[index].texcoords.size();
+    }
+    std::vector<float> positions(positionCount), colors(positionCount), normals(normalCount), texcoords(texcoordCount);
+    pool.parallelFor(chunkCount, [&](size_t index){
+        ObjChunk& chunk = chunks[index];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionStarts[index]);
+        std::copy(chunk.colors.begin(), chunk.colors.end(), colors.begin() + positionStarts[index]);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalStarts[index]);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + texcoordStarts[index]);
+        for(size_t corner = 0; corner < chunk.corners.size(); corner++){
+            uint8_t relative = chunk.relative[corner];
+            if(relative & 1) chunk.corners[corner].position += (int)(positionStarts[index] / 3);
+            if(relative & 2) chunk.corners[corner].texcoord += (int)(texcoordStarts[index] / 2);
+            if(relative & 4) chunk.corners[corner].normal += (int)(normalStarts[index] / 3);
+        }
+    });
+
+    // 3- Split the faces into triangles
+    pool.parallelFor(chunkCount, [&](size_t index){ triangulateChunk(chunks[index], positions); });
+    size_t cornerCount = 0;
+    for(ObjChunk& chunk : chunks){
+        chunk.firstCorner = cornerCount;
+        cornerCount += chunk.triangles.size();
+    }
+    if(cornerCount > std::numeric_limits<GLuint>::max()){
+        std::cerr << "Failed to load obj file \"" << filename << "\" due to error: Too many faces" << std::endl;
+        return false;
+    }
+
+    // The vertex of a triangle corner (a missing or out of range attribute is 0)
+    auto makeVertex = [&](const Corner& corner) {
+        Vertex vertex = {};
+        if(corner.position >= 0 && size_t(corner.position) * 3 + 2 < positions.size()){
+            const float* position = &positions[size_t(corner.position) * 3];
+            const float* color = &colors[size_t(corner.position) * 3];
+            vertex.position = {position[0], position[1], position[2]};
+            vertex.color = {color[0] * 255, color[1] * 255, color[2] * 255, 255};
+        }
+        if(corner.normal >= 0 && size_t(corner.normal) * 3 + 2 < normals.size()){
+            const float* normal = &normals[size_t(corner.normal) * 3];
+            vertex.normal = {normal[0], normal[1], normal[2]};
+        }
+        if(corner.texcoord >= 0 && size_t(corner.texcoord) * 2 + 1 < texcoords.size()){
+            const float* texcoord = &texcoords[size_t(corner.texcoord) * 2];
+            vertex.tex_coord = {texcoord[0], texcoord[1]};
+        }
+        return vertex;
+    };
+    auto getCorner = [&](size_t chunk, size_t corner) -> const Corner& { return chunks[chunk].triangles[corner - chunks[chunk].firstCorner]; };
+
+    // 4- Hash the corners and sort them into shards (every chunk keeps its own list per shard, so the lists of a shard are in the order of the file)
+    std::vector<uint64_t> hashes(cornerCount);
+    std::vector<std::vector<uint32_t>> shardCorners(chunkCount * DEDUPLICATION_SHARDS);
+    pool.parallelFor(chunkCount, [&](size_t index){
+        const ObjChunk& chunk = chunks[index];
+        for(size_t corner = 0; corner < chunk.triangles.size(); corner++){
+            uint64_t hash = hashVertex(makeVertex(chunk.triangles[corner]));
+            hashes[chunk.firstCorner + corner] = hash;
+            shardCorners[(hash >> (64 - DEDUPLICATION_SHARD_BITS)) * chunkCount + index].push_back((uint32_t)(chunk.firstCorner + corner));
+        }
+    });
+
+    // Every shard finds the first corner that has the same vertex as each of its corners
+    std::vector<uint32_t> firstCorners(cornerCount);
+    std::vector<size_t> cornerChunks(cornerCount);
+    for(size_t index = 0; index < chunkCount; index++)
+        std::fill(cornerChunks.begin() + chunks[index].firstCorner, cornerChunks.begin() + chunks[index].firstCorner + chunks[index].triangles.size(), index);
+    pool.parallelFor(DEDUPLICATION_SHARDS, [&](size_t shard){
+        size_t count = 0;
+        for(size_t index = 0; index < chunkCount; index++) count += shardCorners[shard * chunkCount + index].size();
+        if(count == 0) return;
+        // An open addressing table (with linear probing) of the first corners of the unique vertices, kept at most half full
+        size_t capacity = 16;
+        while(capacity < count * 2) capacity *= 2;
+        const uint32_t EMPTY = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> table(capacity, EMPTY);
+        for(size_t index = 0; index < chunkCount; index++){
+            for(uint32_t corner : shardCorners[shard * chunkCount + index]){
+                uint64_t hash = hashes[corner];
+                Vertex vertex = makeVertex(getCorner(index, corner));
+                size_t slot = hash & (capacity - 1);
+                while(true){
+                    uint32_t other = table[slot];
+                    if(other == EMPTY){
+                        table[slot] = corner;
+                        firstCorners[corner] = corner;
+                        break;
+                    }
+                    if(hashes[other] == hash && makeVertex(getCorner(cornerChunks[other], other)) == vertex){
+                        firstCorners[corner] = other;
+                        break;
+                    }
+                    slot = (slot + 1) & (capacity - 1);
+                }
+            }
+        }
+    });
+
+    // 5- Number the vertices in the order of their first corner (the first corner always comes before the other corners of its vertex)
+    vertices.clear();
+    elements.resize(cornerCount);
+    for(size_t index = 0; index < chunkCount; index++){
+        const ObjChunk& chunk = chunks[index];
+        for(size_t corner = chunk.firstCorner; corner < chunk.firstCorner + chunk.triangles.size(); corner++){
+            uint32_t first = firstCorners[corner];
+            if(first == corner){
+                elements[corner] = (GLuint)vertices.size();
+                vertices.push_back(makeVertex(chunk.triangles[corner - chunk.firstCorner]));
+            } else {
+                elements[corner] = elements[first];
+            }
+        }
+    }
+
+    // Every shape becomes a submesh (the empty ones are skipped)
+    if(submeshes){
+        submeshes->clear();
+        GLuint start = 0;
+        auto addSubmesh = [&](GLuint end){
+            if(end > start) submeshes->push_back({start, end - start});
+            start = end;
+        };
+        for(const ObjChunk& chunk : chunks)
+            for(uint32_t element : chunk.shapeElements) addSubmesh((GLuint)(chunk.firstCorner + element));
+        addSubmesh((GLuint)cornerCount);
+    }
+
+    return true;
+}
+
+bool our::mesh_utils::parseOBJWithTinyObj(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements, std::vector<Submesh>* submeshes) {
 
     // Since the OBJ can have duplicated vertices, we make them unique using this map
     // The key is the vertex, the value is its index in the vector "vertices".
@@ -27,7 +444,7 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
 
     if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filename.c_str())) {
         std::cerr << "Failed to load obj file \"" << filename << "\" due to error: " << err << std::endl;
-        return nullptr;
+        return false;
     }
     if (!warn.empty()) {
         std::cout << "WARN while loading obj file \"" << filename << "\": " << warn << std::endl;
@@ -35,8 +452,9 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
 
     // An obj file can have multiple shapes where each shape can have its own material
     // Ideally, we would load each shape into a separate mesh or store the start and end of it in the element buffer to be able to draw each shape separately
-    // But we ignored this fact since we don't plan to use multiple materials in the examples
+    // But we ignored this fact since we don't plan to use multiple materials in the examples (the ranges are still recorded in "submeshes" if requested)
     for (const auto &shape : shapes) {
+        if (submeshes) submeshes->push_back({static_cast<GLuint>(elements.size()), static_cast<GLuint>(shape.mesh.indices.size())});
         for (const auto &index : shape.mesh.indices) {
             Vertex vertex = {};
 
@@ -81,7 +499,7 @@ our::Mesh* our::mesh_utils::loadOBJ(const std::string& filename) {
         }
     }
 
-    return new our::Mesh(vertices, elements);
+    return true;
 }
 
 // Create a sphere (the vertex order in the triangles are CCW from the outside)
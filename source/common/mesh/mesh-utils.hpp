@@ -1,11 +1,24 @@
 #pragma once
 
 #include "mesh.hpp"
+#include "mesh-cache.hpp"
 #include <string>
 
 namespace our::mesh_utils {
     // Load an ".obj" file into the mesh
-    Mesh* loadOBJ(const std::string& filename);
+    // If an arena is given, the mesh data is put in it instead of buffers of its own
+    Mesh* loadOBJ(const std::string& filename, MeshArena* arena = nullptr);
+    // Reads the vertices & elements of an ".obj" file without touching OpenGL (so it can run on any thread)
+    // The file is parsed & its duplicated vertices are removed on multiple threads (see "mesh-utils.cpp")
+    // If "submeshes" is given, it receives the range of elements of every shape in the file
+    // Returns false if the file could not be read
+    bool parseOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements, std::vector<Submesh>* submeshes = nullptr);
+    // The single threaded version of "parseOBJ" that goes through Tiny OBJ Loader (it gives the same vertices & elements).
+    // It is kept as a reference for the benchmarks & for the obj statements that "parseOBJ" doesn't read.
+    bool parseOBJWithTinyObj(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements, std::vector<Submesh>* submeshes = nullptr);
+    // Same as "parseOBJ" but goes through the binary mesh cache if it is enabled (see "mesh_cache"):
+    // an up to date cache is read instead of the file, otherwise the file is parsed and the cache is written for the next time
+    bool readOBJ(const std::string& filename, std::vector<Vertex>& vertices, std::vector<GLuint>& elements);
     // Create a sphere (the vertex order in the triangles are CCW from the outside)
     // Segments define the number of divisions on the both the latitude and the longitude
     Mesh* sphere(const glm::ivec2& segments);
@@ -2,39 +2,77 @@
 
 #include <glad/gl.h>
 #include "vertex.hpp"
+#include "mesh-arena.hpp"
+#include "../gl-state-cache.hpp"
+#include "../bounds.hpp"
 
-namespace our {
+#include <iostream>
+#include <vector>
 
-    #define ATTRIB_LOC_POSITION 0
-    #define ATTRIB_LOC_COLOR    1
-    #define ATTRIB_LOC_TEXCOORD 2
-    #define ATTRIB_LOC_NORMAL   3
+namespace our {
 
     class Mesh {
         // Here, we store the object names of the 3 main components of a mesh:
         // A vertex array object, A vertex buffer and an element buffer
-        unsigned int VBO, EBO; // Vertex Buffer Object, Element Buffer Object
-        unsigned int VAO; // Vertex Array Object
+        unsigned int VBO = 0, EBO = 0; // Vertex Buffer Object, Element Buffer Object
+        unsigned int VAO = 0; // Vertex Array Object
         // We need to remember the number of elements that will be draw by glDrawElements 
-        GLsizei elementCount;
-    public:
+        GLsizei elementCount = 0;
+        // If the mesh lives in the mesh arena, it has no buffers of its own (VAO, VBO & EBO are 0)
+        // and its data starts at "baseVertex" & "firstElement" in the buffers of the arena
+        MeshArena* arena = nullptr;
+        GLint baseVertex = 0;
+        GLuint firstElement = 0;
+
+        // Returns the vertex array that should be bound to draw the mesh
+        GLuint getVertexArray() const { return arena ? arena->getVertexArray() : VAO; }
+        // The bounding volumes of the vertices in the local space of the mesh (used for culling)
+        AABB bounds;
+        glm::vec4 boundingSphere; // xyz: center, w: radius
+
+        // Computes the bounding box & the bounding sphere of the given vertices
+        // The sphere is centered at the box center and its radius reaches the farthest vertex (which is tighter than the box corner)
+        void computeBounds(const std::vector<Vertex>& vertices) {
+            if(vertices.empty()){
+                bounds = {glm::vec3(0), glm::vec3(0)};
+                boundingSphere = glm::vec4(0);
+                return;
+            }
+            bounds = {vertices[0].position, vertices[0].position};
+            for(const auto& vertex : vertices){
+                bounds.min = glm::min(bounds.min, vertex.position);
+                bounds.max = glm::max(bounds.max, vertex.position);
+            }
+            glm::vec3 center = (bounds.min + bounds.max) * 0.5f;
+            float radiusSquared = 0;
+            for(const auto& vertex : vertices){
+                glm::vec3 difference = vertex.position - center;
+                radiusSquared = glm::max(radiusSquared, glm::dot(difference, difference));
+            }
+            boundingSphere = glm::vec4(center, glm::sqrt(radiusSquared));
+        }
 
-        // The constructor takes two vectors:
-        // - vertices which contain the vertex data.
-        // - elements which contain the indices of the vertices out of which each rectangle will be constructed.
-        // The mesh class does not keep a these data on the RAM. Instead, it should create
-        // a vertex buffer to store the vertex data on the VRAM,
-        // an element buffer to store the element data on the VRAM,
-        // a vertex array object to define how to read the vertex & element buffer during rendering 
-        Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements)
+        // Creates the buffers of the mesh (or puts the data in the arena if one is given)
+        void createBuffers(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements, MeshArena* arena)
         {
+            // A mesh in the arena only remembers where its data starts
+            if(arena){
+                this->arena = arena;
+                MeshArena::Range range = arena->add(vertices, elements);
+                baseVertex = range.baseVertex;
+                firstElement = range.firstElement;
+                elementCount = elements.size();
+                computeBounds(vertices);
+                return;
+            }
+
             // Generate the VAO, VBO and EBO
             glGenVertexArrays(1, &VAO);
             glGenBuffers(1, &VBO);
             glGenBuffers(1, &EBO);
 
-            // Bind the VAO
-            glBindVertexArray(VAO);
+            // Bind the VAO (through the state cache, since the meshes no longer unbind their VAO after drawing)
+            GLStateCache::get().bindVertexArray(VAO);
 
             // Bind the VBO
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -80,37 +118,112 @@ namespace our {
 						// ============================================================================
 
             // Unbind the VAO, VBO and EBO
-            glBindVertexArray(0);
+            GLStateCache::get().bindVertexArray(0);
             glBindBuffer(GL_ARRAY_BUFFER, 0);
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
             // Store the number of elements in elementCount
             elementCount = elements.size();
+
+            // The vertices are not kept on the RAM, so we compute the bounds now while we have them
+            computeBounds(vertices);
         }
+    public:
+
+        // The constructor takes two vectors:
+        // - vertices which contain the vertex data.
+        // - elements which contain the indices of the vertices out of which each rectangle will be constructed.
+        // The mesh class does not keep a these data on the RAM. Instead, it should create
+        // a vertex buffer to store the vertex data on the VRAM,
+        // an element buffer to store the element data on the VRAM,
+        // a vertex array object to define how to read the vertex & element buffer during rendering 
+        Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements)
+        {
+            createBuffers(vertices, elements, nullptr);
+        }
+
+        // This constructor puts the vertices & elements in the given mesh arena instead of creating buffers for the mesh
+        Mesh(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements, MeshArena& arena)
+        {
+            createBuffers(vertices, elements, &arena);
+        }
+
+        // This constructor creates an empty mesh (it draws nothing) which is used as a placeholder while the real data is being loaded
+        Mesh()
+        {
+            computeBounds({});
+        }
+
+        // Fills an empty mesh with the given data (the mesh keeps its address, so anything that points to the placeholder gets the real mesh)
+        void setData(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& elements, MeshArena* arena = nullptr)
+        {
+            if(elementCount != 0 || this->arena || VAO != 0){
+                std::cerr << "Only an empty mesh can receive new data" << std::endl;
+                return;
+            }
+            createBuffers(vertices, elements, arena);
+        }
+
+        // Returns the arena that holds the data of the mesh (nullptr if the mesh has buffers of its own or is still an empty placeholder)
+        MeshArena* getArena() const { return arena; }
+
+        // Returns the indirect command that draws "instanceCount" instances of this mesh starting at the instance "baseInstance"
+        // (only meaningful for a mesh in an arena, since the command refers to the buffers of the arena)
+        DrawElementsIndirectCommand getIndirectCommand(GLuint instanceCount, GLuint baseInstance) const {
+            return {(GLuint)elementCount, instanceCount, firstElement, baseVertex, baseInstance};
+        }
+
+        // Returns the bounding box of the mesh in its local space
+        const AABB& getBounds() const { return bounds; }
+        // Returns the bounding sphere of the mesh in its local space (xyz: center, w: radius)
+        const glm::vec4& getBoundingSphere() const { return boundingSphere; }
 
         // This function should render the mesh
         void draw() 
         {
-            // Bind the VAO
-            glBindVertexArray(VAO);
+            // A placeholder has nothing to draw
+            if(elementCount == 0) return;
+
+            // Bind the VAO (the state cache skips it if the previous mesh used the same one, e.g. both live in the mesh arena)
+            GLStateCache::get().bindVertexArray(getVertexArray());
 
             // Draw the elements by specifying that we want to draw triangles and give
-            // the number of elements. Then, the type is unsigned int & the final argument as 0 for indices
-            glDrawElements(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, 0);
+            // the number of elements. Then, the type is unsigned int & the final argument is the offset of the first element.
+            // The base vertex is added to every element, so the elements of a mesh in the arena still start from 0
+            glDrawElementsBaseVertex(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, (void*)(firstElement * sizeof(GLuint)), baseVertex);
 
-            // Unbind the VAO
-            glBindVertexArray(0);
+            // The VAO is not unbound: the next draw binds its own VAO anyway, and keeping it bound lets the cache skip the next bind
+        }
+
+        // Draws "count" instances of the mesh in a single draw call.
+        // The per instance data is read from "instanceBuffer" starting at "offset" (in bytes). Every instance has its model matrix
+        // (ATTRIB_LOC_MODEL) followed by the inverse transpose of the model matrix if "normalMatrix" is true (ATTRIB_LOC_MODEL_IT).
+        void drawInstanced(GLuint instanceBuffer, size_t offset, GLsizei count, bool normalMatrix)
+        {
+            if(elementCount == 0) return;
+            GLStateCache::get().bindVertexArray(getVertexArray());
+            setupInstanceAttributes(instanceBuffer, offset, normalMatrix);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, elementCount, GL_UNSIGNED_INT, (void*)(firstElement * sizeof(GLuint)), count, baseVertex);
+            // The vertex array may be shared with the other meshes of the arena, which are not all drawn instanced
+            disableInstanceAttributes();
         }
 
         // This function should delete the vertex & element buffers and the vertex array object
         ~Mesh(){
             //TODO: (Req 2) Write this function
-						
+
+						// A mesh in the arena has no buffers of its own
+						if(arena){
+							arena->release();
+							return;
+						}
+
 						// Delete vertex and element buffers
 						glDeleteBuffers(1, &VBO);
 						glDeleteBuffers(1, &EBO);
 
 						// Delete vertex array
+						GLStateCache::get().forgetVertexArray(VAO);
 						glDeleteVertexArrays(1, &VAO);
         }
 
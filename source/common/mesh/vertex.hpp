@@ -5,6 +5,15 @@
 
 namespace our {
 
+    // The attribute locations of the vertex data (shared by all the meshes & the shaders)
+    #define ATTRIB_LOC_POSITION 0
+    #define ATTRIB_LOC_COLOR    1
+    #define ATTRIB_LOC_TEXCOORD 2
+    #define ATTRIB_LOC_NORMAL   3
+    // The per instance attributes of the instanced shaders (a mat4 attribute takes 4 locations, one per column)
+    #define ATTRIB_LOC_MODEL    4
+    #define ATTRIB_LOC_MODEL_IT 8
+
     // Since we may want to store colors in bytes instead of floats for efficiency,
     // we are creating our own 32-bit R8G8B8A8 Color data type with the default GLM precision
     typedef glm::vec<4, glm::uint8, glm::defaultp> Color;
@@ -28,8 +37,8 @@ namespace our {
 
 // We plan to use struct Vertex as a key for a map so we need to define a hash function for it
 namespace std {
-    //A Simple method to combine two hash values
-    inline size_t hash_combine(size_t h1, size_t h2){ return h1 ^ (h2 << 1); }
+    //Combines two hash values (h1 ^ (h2 << 1) gave many collisions since equal floats in different fields cancelled each other)
+    inline size_t hash_combine(size_t h1, size_t h2){ return h1 ^ (h2 + 0x9e3779b9 + (h1 << 6) + (h1 >> 2)); }
 
     //A Hash function for struct Vertex
     template<> struct hash<our::Vertex> {
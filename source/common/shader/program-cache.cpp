@@ -0,0 +1,169 @@
+#include "program-cache.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+namespace our::program_cache {
+
+    namespace {
+
+        struct ProgramCacheHeader {
+            char magic[4];              // "OPRG"
+            uint32_t version;           // VERSION when the file was written
+            uint64_t key;               // The key of the program (a file whose key differs is a hash collision of the name)
+            uint32_t binaryFormat;      // The format returned by glGetProgramBinary
+            uint32_t binaryLength;      // The number of bytes of the binary that follows the header
+            double compileMilliseconds; // The time that compiling & linking the program took
+        };
+        static_assert(std::is_trivially_copyable_v<ProgramCacheHeader>);
+
+        bool enabled = false;
+        std::string cacheDirectory;
+        uint64_t driverHash = 0;
+
+        // The counters since the last report
+        size_t hits = 0, misses = 0;
+        double savedMilliseconds = 0;
+
+        // FNV-1a, the same hash as the pipeline states of the sort keys
+        uint64_t hashBytes(uint64_t hash, const void* data, size_t size) {
+            const uint8_t* bytes = (const uint8_t*)data;
+            for(size_t index = 0; index < size; index++) hash = (hash ^ bytes[index]) * 1099511628211ull;
+            return hash;
+        }
+        uint64_t hashString(uint64_t hash, const char* text) {
+            // The length is hashed too so that ("ab", "c") and ("a", "bc") give different keys
+            size_t length = text ? std::strlen(text) : 0;
+            hash = hashBytes(hash, &length, sizeof(length));
+            return hashBytes(hash, text, length);
+        }
+
+        std::string getPath(uint64_t key) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+            return (std::filesystem::path(cacheDirectory) / name).string();
+        }
+
+        double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+            return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        }
+    }
+
+    void configure(bool enable, const std::string& directory) {
+        enabled = false;
+        if(!enable) return;
+        if(!(GLAD_GL_VERSION_4_1 || GLAD_GL_ARB_get_program_binary) || !glGetProgramBinary || !glProgramBinary || !glProgramParameteri){
+            std::cout << "Program cache: disabled, the driver doesn't support program binaries" << std::endl;
+            return;
+        }
+        GLint formatCount = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        if(formatCount <= 0){
+            std::cout << "Program cache: disabled, the driver has no program binary format" << std::endl;
+            return;
+        }
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        if(error){
+            std::cerr << "Program cache: disabled, couldn't create the directory \"" << directory << "\": " << error.message() << std::endl;
+            return;
+        }
+        cacheDirectory = directory;
+        // A binary only works with the driver that made it
+        driverHash = 14695981039346656037ull;
+        for(GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) driverHash = hashString(driverHash, (const char*)glGetString(name));
+        enabled = true;
+    }
+
+    bool isEnabled() { return enabled; }
+
+    uint64_t computeKey(const std::vector<std::pair<GLenum, std::string>>& stages) {
+        uint64_t hash = hashBytes(driverHash, &VERSION, sizeof(VERSION));
+        for(const auto& [type, source] : stages){
+            uint32_t stageType = type;
+            hash = hashBytes(hash, &stageType, sizeof(stageType));
+            hash = hashString(hash, source.c_str());
+        }
+        return hash;
+    }
+
+    bool load(GLuint program, uint64_t key) {
+        auto start = std::chrono::high_resolution_clock::now();
+        std::ifstream file(getPath(key), std::ios::binary);
+        ProgramCacheHeader header;
+        std::vector<char> binary;
+        bool valid = file && file.read((char*)&header, sizeof(header)) && std::memcmp(header.magic, "OPRG", 4) == 0
+                  && header.version == VERSION && header.key == key;
+        if(valid){
+            binary.resize(header.binaryLength);
+            valid = (bool)file.read(binary.data(), binary.size());
+        }
+        if(!valid){
+            misses++;
+            return false;
+        }
+        glProgramBinary(program, header.binaryFormat, binary.data(), (GLsizei)binary.size());
+        // The driver may reject a binary (e.g. if it was written by another build of the driver with the same strings)
+        GLint status = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &status);
+        if(status != GL_TRUE){
+            misses++;
+            return false;
+        }
+        hits++;
+        savedMilliseconds += header.compileMilliseconds - millisecondsSince(start);
+        return true;
+    }
+
+    void prepareForLink(GLuint program) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+
+    void store(GLuint program, uint64_t key, double compileMilliseconds) {
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if(length <= 0) return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        ProgramCacheHeader header = {};
+        std::memcpy(header.magic, "OPRG", 4);
+        header.version = VERSION;
+        header.key = key;
+        header.binaryFormat = format;
+        header.binaryLength = (uint32_t)length;
+        header.compileMilliseconds = compileMilliseconds;
+
+        // The file is written under a temporary name then renamed, so a reader never sees a half written binary
+        std::string path = getPath(key), temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            file.write((const char*)&header, sizeof(header));
+            file.write(binary.data(), length);
+            if(!file){
+                std::cerr << "Program cache: couldn't write \"" << temporaryPath << "\"" << std::endl;
+                return;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if(error){
+            std::cerr << "Program cache: couldn't write \"" << path << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+        }
+    }
+
+    void report() {
+        if(hits == 0 && misses == 0) return;
+        std::cout << "Program cache: " << hits << " hits, " << misses << " misses, " << savedMilliseconds << " ms saved" << std::endl;
+        hits = misses = 0;
+        savedMilliseconds = 0;
+    }
+
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace our {
+
+    // The program cache keeps the binaries of the linked shader programs (glGetProgramBinary) in a directory, so the next runs load them
+    // with glProgramBinary instead of compiling & linking the GLSL sources again. A binary is stored under a key that hashes the type & source
+    // of every stage with the vendor, renderer & version strings of the driver, so editing a shader or updating the driver gives a new key.
+    // A binary that the driver rejects is simply a miss: the program is compiled from its sources and the binary is written again.
+    namespace program_cache {
+
+        // Increase it whenever the layout of the files changes
+        constexpr uint32_t VERSION = 1;
+
+        // Enables or disables the cache (it is disabled by default). It must be called once OpenGL is loaded, since the cache stays
+        // disabled if the driver can't save programs (program binaries need OpenGL 4.1 or ARB_get_program_binary and at least one format).
+        void configure(bool enabled, const std::string& directory = "cache/programs");
+        bool isEnabled();
+
+        // Computes the key of a program from the types & sources of its stages
+        uint64_t computeKey(const std::vector<std::pair<GLenum, std::string>>& stages);
+
+        // Loads the binary with the given key into the program (which must have no shaders). Returns true if the program is now linked.
+        bool load(GLuint program, uint64_t key);
+        // Must be called before linking a program that will be stored, so that the driver keeps its binary retrievable
+        void prepareForLink(GLuint program);
+        // Stores the binary of the linked program. "compileMilliseconds" is the time its compilation took (what a later load saves).
+        void store(GLuint program, uint64_t key, double compileMilliseconds);
+
+        // Prints the hits & misses since the last report and the time the hits saved, then resets the counters (prints nothing if the cache wasn't used)
+        void report();
+    }
+
+}
@@ -0,0 +1,49 @@
+#include "shader-permutations.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+
+namespace our::shader_permutations {
+
+    namespace {
+        // The permutations by key: the type & file name of every stage followed by the sorted definitions
+        std::unordered_map<std::string, ShaderProgram*> permutations;
+    }
+
+    ShaderProgram* get(const ShaderProgram* base, ShaderDefines defines) {
+        if(base == nullptr) return nullptr;
+
+        // The same set of definitions must give the same key whatever order it was written in
+        std::sort(defines.begin(), defines.end());
+        defines.erase(std::unique(defines.begin(), defines.end()), defines.end());
+
+        std::string key;
+        for(auto& [type, filename] : base->getStageFiles()) key += std::to_string(type) + ":" + filename + "\n";
+        for(const std::string& define : defines) key += "#" + define + "\n";
+        if(auto it = permutations.find(key); it != permutations.end()) return it->second;
+
+        // Like the shader assets, a permutation that fails to compile is kept (its errors are printed) so it is not compiled again
+        ShaderProgram* program = new ShaderProgram();
+        program->setDefines(defines);
+        for(auto& [type, filename] : base->getStageFiles()) program->attach(filename, type);
+        if(!program->link()){
+            std::cerr << "Couldn't build the shader permutation:";
+            for(const std::string& define : defines) std::cerr << " " << define;
+            std::cerr << std::endl;
+        }
+        permutations[key] = program;
+        return program;
+    }
+
+    size_t getCount() {
+        return permutations.size();
+    }
+
+    void clear() {
+        for(auto& [key, program] : permutations) delete program;
+        permutations.clear();
+    }
+
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include "shader.hpp"
+
+#include <cstddef>
+
+namespace our {
+
+    // The shader permutations are the variants of a program that are compiled from the same sources with different definitions
+    // (see "ShaderProgram::setDefines"). A material asks for the permutation that only has the features it uses (e.g. "LightMaterial"
+    // doesn't ask for HAS_EMISSIVE if it has no emissive map), so the cost of its fragments matches what it actually draws.
+    // A permutation is compiled the first time it is requested, and every material that requests the same one shares the program
+    // (so the renderer still groups their draws by program).
+    namespace shader_permutations {
+
+        // Returns the permutation of the given program's stages with the given definitions (their order doesn't matter).
+        // The permutation is compiled & linked the first time it is requested. Returns nullptr if "base" is nullptr.
+        ShaderProgram* get(const ShaderProgram* base, ShaderDefines defines);
+
+        // Returns the number of permutations that were compiled since the last "clear"
+        size_t getCount();
+
+        // Deletes all the permutations (the materials using them must be deleted too)
+        void clear();
+    }
+
+}
@@ -1,24 +1,22 @@
 #include "shader.hpp"
+#include "program-cache.hpp"
 
 #include <cassert>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <chrono>
 
 //Forward definition for error checking functions
 std::string checkForShaderCompilationErrors(GLuint shader);
 std::string checkForLinkingErrors(GLuint program);
 
-bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const {
-    // Here, we open the file and read a string from it containing the GLSL code of our shader
-    std::ifstream file(filename);
-    if(!file){
-        std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
-        return false;
-    }
-    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
-    const char* sourceCStr = sourceString.c_str();
-    file.close();
+// Compiles a stage and attaches it to the program. Returns false (after printing the error) if the compilation failed.
+static bool compileShader(GLuint program, GLenum type, const std::string& source, const std::string& filename) {
+    const char* sourceCStr = source.c_str();
 
     //TODO: Complete this function
 		GLuint shader = glCreateShader(type);
@@ -49,16 +47,81 @@ bool our::ShaderProgram::attach(const std::string &filename, GLenum type) const
     return true;
 }
 
+// Inserts a "#define" line for every definition right after the "#version" line (which must stay the first directive of the source)
+// followed by a "#line" directive, so the line numbers in the compilation errors still match the file
+static std::string insertDefines(const std::string& source, const our::ShaderDefines& defines) {
+    size_t insertAt = 0;
+    size_t version = source.find("#version");
+    if(version != std::string::npos){
+        size_t end = source.find('\n', version);
+        insertAt = end == std::string::npos ? source.size() : end + 1;
+    }
+    size_t nextLine = std::count(source.begin(), source.begin() + insertAt, '\n') + 1;
+
+    std::string definitions = insertAt > 0 && source[insertAt - 1] != '\n' ? "\n" : "";
+    for(std::string define : defines){
+        // "NAME=VALUE" is written as "#define NAME VALUE"
+        std::replace(define.begin(), define.end(), '=', ' ');
+        definitions += "#define " + define + "\n";
+    }
+    definitions += "#line " + std::to_string(nextLine) + "\n";
+    return source.substr(0, insertAt) + definitions + source.substr(insertAt);
+}
+
+bool our::ShaderProgram::attach(const std::string &filename, GLenum type) {
+    // Here, we open the file and read a string from it containing the GLSL code of our shader
+    std::ifstream file(filename);
+    if(!file){
+        std::cerr << "ERROR: Couldn't open shader file: " << filename << std::endl;
+        return false;
+    }
+    std::string sourceString = std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    file.close();
+
+    // The stage is compiled by "link", unless the program cache already has the linked program
+    stages.push_back({type, filename, std::move(sourceString)});
+    stageFiles.emplace_back(type, filename);
+    return true;
+}
+
+bool our::ShaderProgram::link() {
+    if(!defines.empty()){
+        for(Stage& stage : stages) stage.source = insertDefines(stage.source, defines);
+    }
 
+    uint64_t cacheKey = 0;
+    if(program_cache::isEnabled()){
+        std::vector<std::pair<GLenum, std::string>> sources;
+        for(const Stage& stage : stages) sources.emplace_back(stage.type, stage.source);
+        cacheKey = program_cache::computeKey(sources);
+        if(program_cache::load(program, cacheKey)){
+            stages.clear();
+            cacheUniformLocations();
+            bindSharedResources();
+            return true;
+        }
+    }
+    return compileAndLink(cacheKey);
+}
+
+bool our::ShaderProgram::compileAndLink(uint64_t cacheKey) {
+    auto start = std::chrono::high_resolution_clock::now();
+    std::vector<Stage> attachedStages = std::move(stages);
+    stages.clear();
+    for(const Stage& stage : attachedStages){
+        if(!compileShader(program, stage.type, stage.source, stage.filename)) return false;
+    }
 
-bool our::ShaderProgram::link() const {
     //TODO: Complete this function
     //Note: The function "checkForLinkingErrors" checks if there is
     // an error in the given program. You should use it to check if there is a
     // linking error and print it so that you can know what is wrong with the
     // program. The returned string will be empty if there is no errors.
 
-		// Call OpenGL to link the program
+		// Call OpenGL to link the program (keeping its binary retrievable if it goes to the program cache)
+		if (program_cache::isEnabled()) {
+			program_cache::prepareForLink(program);
+		}
 		glLinkProgram(program);
 
 		std::string linkingError = checkForLinkingErrors(program); 
@@ -66,12 +129,84 @@ bool our::ShaderProgram::link() const {
 			std::cerr << "LINKING ERROR" << std::endl;
 			std::cerr << linkingError << std::endl;
 
+			uniforms.clear();
 			return false;
     }
 
+		if (program_cache::isEnabled()) {
+			double compileMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			program_cache::store(program, cacheKey, compileMilliseconds);
+		}
+
+		// Now that the program is linked, we know all of its active uniforms so we cache their locations
+		cacheUniformLocations();
+		// and connect its shared uniform blocks to their binding points
+		bindSharedResources();
+
     return true;
 }
 
+void our::ShaderProgram::cacheUniformLocations() {
+    uniforms.clear();
+
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<char> nameBuffer(std::max(maxNameLength, 1));
+
+    for(GLuint index = 0; index < (GLuint)uniformCount; index++){
+        GLint size = 0;
+        GLenum type;
+        GLsizei length = 0;
+        glGetActiveUniform(program, index, (GLsizei)nameBuffer.size(), &length, &size, &type, nameBuffer.data());
+        std::string name(nameBuffer.data(), length);
+
+        // Uniforms that live inside a uniform block have no location, so they are skipped
+        GLint location = glGetUniformLocation(program, name.c_str());
+        if(location == -1) continue;
+        uniforms.insert(name, location);
+
+        // An array is reported once as "name[0]" so we also register "name" (which OpenGL accepts as the first element)
+        // and every other element "name[i]" since the elements are not guaranteed to have consecutive locations
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0){
+            std::string base = name.substr(0, name.size() - 3);
+            uniforms.insert(base, location);
+            for(GLint element = 1; element < size; element++){
+                std::string elementName = base + "[" + std::to_string(element) + "]";
+                uniforms.insert(elementName, glGetUniformLocation(program, elementName.c_str()));
+            }
+        }
+    }
+}
+
+void our::ShaderProgram::bindSharedResources() {
+    // The light block is filled once per frame by the forward renderer and shared by all the lit programs
+    GLuint lightsIndex = glGetUniformBlockIndex(program, UNIFORM_BLOCK_LIGHTS_NAME);
+    if(lightsIndex != GL_INVALID_INDEX)
+        glUniformBlockBinding(program, lightsIndex, UNIFORM_BLOCK_LIGHTS_BINDING);
+
+    // The light buffer textures are always bound to the same units, so we point the samplers to them once
+    const std::pair<const char*, GLint> samplers[] = {
+        {"light_data", TEXTURE_UNIT_LIGHT_DATA},
+        {"light_grid", TEXTURE_UNIT_LIGHT_GRID},
+        {"light_indices", TEXTURE_UNIT_LIGHT_INDICES}
+    };
+    GLint previousProgram = 0;
+    bool changed = false;
+    for(auto& [name, unit] : samplers){
+        const GLint* location = uniforms.find(name);
+        if(!location) continue;
+        // Setting a uniform requires the program to be in use (glProgramUniform needs OpenGL 4.1)
+        if(!changed){
+            glGetIntegerv(GL_CURRENT_PROGRAM, &previousProgram);
+            glUseProgram(program);
+            changed = true;
+        }
+        glUniform1i(*location, unit);
+    }
+    if(changed) glUseProgram((GLuint)previousProgram);
+}
+
 ////////////////////////////////////////////////////////////////////
 // Function to check for compilation and linking error in shaders //
 ////////////////////////////////////////////////////////////////////
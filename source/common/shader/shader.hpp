@@ -1,20 +1,82 @@
 #ifndef SHADER_HPP
 #define SHADER_HPP
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+#include "uniform-table.hpp"
+#include "../gl-state-cache.hpp"
+
 namespace our {
 
+    // The fixed binding points of the uniform blocks that are shared between programs.
+    // After linking, every block with a known name is bound to its point so that the renderer only has to bind a buffer once.
+    #define UNIFORM_BLOCK_LIGHTS_NAME    "Lights"
+    #define UNIFORM_BLOCK_LIGHTS_BINDING 0
+
+    // The fixed texture units of the buffer textures that are shared between the lit programs.
+    // The materials use the units starting from 0, so the shared ones are placed after them.
+    #define TEXTURE_UNIT_LIGHT_DATA     8
+    #define TEXTURE_UNIT_LIGHT_GRID     9
+    #define TEXTURE_UNIT_LIGHT_INDICES  10
+
+    // The preprocessor definitions that a program is compiled with, e.g. {"HAS_EMISSIVE", "MAX_LIGHTS=8"}.
+    // A definition is either a name or "NAME=VALUE" (see "ShaderProgram::setDefines").
+    using ShaderDefines = std::vector<std::string>;
+
+    // A uniform handle is a uniform location that was resolved once by name.
+    // Systems that set the same uniform many times can look the handle up once (using "ShaderProgram::getUniform")
+    // and then set the value through it without hashing or comparing any strings.
+    // A handle is only valid for the program that created it (and until that program is linked again).
+    struct UniformHandle {
+        GLint location = -1; // -1 means the uniform is not active, setting it will be silently ignored by OpenGL
+
+        UniformHandle() = default;
+        explicit UniformHandle(GLint location) : location(location) {}
+
+        // Returns whether the uniform exists and is active in the program
+        bool valid() const { return location != -1; }
+    };
+
     class ShaderProgram {
 
     private:
         //Shader Program Handle (OpenGL object name)
         GLuint program;
 
+        // The stages given to "attach" since the last link: their types, file names & sources.
+        // They are only compiled by "link", and only if the program cache has no binary for them (see "program_cache").
+        struct Stage {
+            GLenum type;
+            std::string filename, source;
+        };
+        std::vector<Stage> stages;
+
+        // The type & file name of every attached stage (they are kept after linking so that permutations can be made from them)
+        std::vector<std::pair<GLenum, std::string>> stageFiles;
+        // The definitions that are inserted into every stage before it is compiled
+        ShaderDefines defines;
+
+        // Compiles the attached stages, links them and stores the binary of the program under "cacheKey" if the program cache is enabled
+        bool compileAndLink(uint64_t cacheKey);
+
+        // The locations of all the active uniforms in the program.
+        // It is filled once after a successful "link" so that setting a uniform by name never calls glGetUniformLocation.
+        UniformTable uniforms;
+
+        // Enumerates the active uniforms of the linked program (via glGetActiveUniform) and stores their locations in "uniforms"
+        void cacheUniformLocations();
+
+        // Binds the shared uniform blocks and buffer textures (if the program uses them) to their fixed binding points
+        void bindSharedResources();
+
     public:
         ShaderProgram(){
             //TODO: (Req 1) Create A shader program
@@ -23,25 +85,55 @@ namespace our {
         ~ShaderProgram(){
             //TODO: (Req 1) Delete a shader program
 						glDeleteProgram(program);
+						GLStateCache::get().forgetProgram(program);
         }
 
-        bool attach(const std::string &filename, GLenum type) const;
+        // Reads the source of a stage of the program. Returns false if the file could not be read.
+        // The compilation is done by "link" (so a compilation error makes "link" fail).
+        bool attach(const std::string &filename, GLenum type);
+
+        // Sets the definitions that "link" inserts after the "#version" line of every stage, so one source can be compiled into
+        // several variants (permutations) that only contain the features they need. The definitions are part of the source,
+        // so every permutation gets its own entry in the program cache. Must be called before "link".
+        void setDefines(ShaderDefines programDefines) { defines = std::move(programDefines); }
+        const ShaderDefines& getDefines() const { return defines; }
 
-        bool link() const;
+        // Returns the type & file name of every attached stage
+        const std::vector<std::pair<GLenum, std::string>>& getStageFiles() const { return stageFiles; }
 
+        // Links the program from the binary in the program cache if there is one, otherwise compiles the attached stages and links them
+        bool link();
+
+        // Makes this program the current one (the state cache skips the call if it is already in use)
         void use() { 
-            glUseProgram(program);
+            GLStateCache::get().useProgram(program);
         }
 
-        GLuint getUniformLocation(const std::string &name) {
+        GLint getUniformLocation(std::string_view name) {
             // TODO: (Req 1) Return the location of the uniform with the given name
             // Use the openGL function to get the uniform location of name which is passed in to the function
             // and then return this obtained location
-						GLint location = glGetUniformLocation(program, name.c_str());
+						// The locations of the active uniforms are cached after linking, so we only ask OpenGL
+						// if the name is not in the cache (e.g. an unusual array name), then we cache the answer too
+						if (const GLint* cached = uniforms.find(name); cached) {
+								return *cached;
+						}
+						GLint location = glGetUniformLocation(program, std::string(name).c_str());
+						uniforms.insert(name, location);
 						return location;
         }
 
-        void set(const std::string &uniform, GLfloat value) {
+        // Looks up the given uniform once and returns a handle that can be used to set it without any lookup
+        UniformHandle getUniform(std::string_view name) {
+            return UniformHandle(getUniformLocation(name));
+        }
+
+        // Returns the number of uniform names whose locations are cached
+        size_t getCachedUniformCount() const {
+            return uniforms.size();
+        }
+
+        void set(std::string_view uniform, GLfloat value) {
             // TODO: (Req 1) Send the given float value to the given uniform
             // 1f for the float value & then use the getUniformLocation function we just wrote for
             // retrieving the location and passing it to the glUniform1f function along with the value
@@ -49,20 +141,20 @@ namespace our {
 						glUniform1f(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, GLuint value) {
+        void set(std::string_view uniform, GLuint value) {
             // TODO: (Req 1) Send the given unsigned integer value to the given uniform
             // Same steps as the set function for float values but instead we use the glUniform1ui
             // function fo sending an unsigned integer
 						glUniform1ui(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, GLint value) {
+        void set(std::string_view uniform, GLint value) {
             // TODO: (Req 1) Send the given integer value to the given uniform
             // 1i for an integer value & pass the location with the given value as explained
 						glUniform1i(getUniformLocation(uniform), value);
         }
 
-        void set(const std::string &uniform, glm::vec2 value) {
+        void set(std::string_view uniform, glm::vec2 value) {
             // TODO: (Req 1) Send the given 2D vector value to the given uniform
             // Now the value parameter is 2-dimensional so we send it using the
             // function glUniform2f where 2f represents a vec2 float. Then, we
@@ -70,20 +162,20 @@ namespace our {
 						glUniform2f(getUniformLocation(uniform), value.x, value.y);
         }
 
-        void set(const std::string &uniform, glm::vec3 value) {
+        void set(std::string_view uniform, glm::vec3 value) {
             // TODO: (Req 1) Send the given 3D vector value to the given uniform
             // 3-dimensional value is sent using the glUniform3f and now we
             // send an extra coordinate z with x & y
 						glUniform3f(getUniformLocation(uniform), value.x, value.y, value.z);
         }
 
-        void set(const std::string &uniform, glm::vec4 value) {
+        void set(std::string_view uniform, glm::vec4 value) {
             // TODO: (Req 1) Send the given 4D vector value to the given uniform
             // 4-dimensional value so we use glUniform4f & send another coordinate w
 						glUniform4f(getUniformLocation(uniform), value.x, value.y, value.z, value.w);
         }
 
-        void set(const std::string &uniform, glm::mat4 matrix) {
+        void set(std::string_view uniform, glm::mat4 matrix) {
             // TODO: (Req 1) Send the given matrix 4x4 value to the given uniform
             // Sending a 4x4 matrix is done by using the function glUniformMatrix4fv where we
             // pass the uniform location as usual and then the count whic is set to 1. The false
@@ -93,6 +185,16 @@ namespace our {
 						glUniformMatrix4fv(getUniformLocation(uniform), 1, false, &matrix[0][0]);
         }
 
+        // The following functions do the same as the ones above but they take a pre-resolved uniform handle
+        // so no name hashing or lookup is done at all
+        void set(UniformHandle uniform, GLfloat value) { glUniform1f(uniform.location, value); }
+        void set(UniformHandle uniform, GLuint value) { glUniform1ui(uniform.location, value); }
+        void set(UniformHandle uniform, GLint value) { glUniform1i(uniform.location, value); }
+        void set(UniformHandle uniform, glm::vec2 value) { glUniform2f(uniform.location, value.x, value.y); }
+        void set(UniformHandle uniform, glm::vec3 value) { glUniform3f(uniform.location, value.x, value.y, value.z); }
+        void set(UniformHandle uniform, glm::vec4 value) { glUniform4f(uniform.location, value.x, value.y, value.z, value.w); }
+        void set(UniformHandle uniform, const glm::mat4& matrix) { glUniformMatrix4fv(uniform.location, 1, false, &matrix[0][0]); }
+
         // TODO: (Req 1) Delete the copy constructor and assignment operator.
         // Delete the shader program copy constructor
 				ShaderProgram (const ShaderProgram&) = delete;
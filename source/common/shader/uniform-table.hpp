@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+
+#include <glad/gl.h>
+
+namespace our {
+
+    // This is a small flat hash table (open addressing with linear probing) that maps uniform names to their locations.
+    // The shader program fills it once after linking, then every "set" by name only hashes the name and probes an array
+    // instead of asking the driver through glGetUniformLocation.
+    // We use std::string_view for the lookups so that looking up a string literal does not allocate a std::string.
+    class UniformTable {
+        struct Slot {
+            std::string name;   // The uniform name as reported by OpenGL (e.g. "tint" or "lights[3].diffuse")
+            size_t hash = 0;    // The cached hash of the name so that probing rarely has to compare strings
+            GLint location = -1;// The uniform location
+            bool used = false;  // Whether this slot holds an entry
+        };
+        std::vector<Slot> slots; // The capacity is always a power of 2 so that we can use a mask instead of a modulo
+        size_t count = 0;
+
+        static size_t hashName(std::string_view name) { return std::hash<std::string_view>()(name); }
+
+        // Doubles the capacity (or allocates the initial one) and reinserts all the entries
+        void grow() {
+            std::vector<Slot> old = std::move(slots);
+            slots.assign(old.empty() ? 16 : old.size() * 2, Slot());
+            count = 0;
+            for(auto& slot : old){
+                if(slot.used) insert(slot.name, slot.location);
+            }
+        }
+
+    public:
+        // Adds the given name & location (or updates the location if the name already exists)
+        void insert(std::string_view name, GLint location) {
+            // Keep the load factor at most 0.5 to keep the probe sequences short
+            if((count + 1) * 2 > slots.size()) grow();
+            size_t hash = hashName(name);
+            size_t mask = slots.size() - 1;
+            for(size_t index = hash & mask;; index = (index + 1) & mask){
+                Slot& slot = slots[index];
+                if(!slot.used){
+                    slot.name = std::string(name);
+                    slot.hash = hash;
+                    slot.location = location;
+                    slot.used = true;
+                    ++count;
+                    return;
+                }
+                if(slot.hash == hash && slot.name == name){
+                    slot.location = location;
+                    return;
+                }
+            }
+        }
+
+        // Returns a pointer to the location of the given name or nullptr if the name is not in the table
+        const GLint* find(std::string_view name) const {
+            if(count == 0) return nullptr;
+            size_t hash = hashName(name);
+            size_t mask = slots.size() - 1;
+            for(size_t index = hash & mask;; index = (index + 1) & mask){
+                const Slot& slot = slots[index];
+                if(!slot.used) return nullptr;
+                if(slot.hash == hash && slot.name == name) return &slot.location;
+            }
+        }
+
+        // Returns the number of names stored in the table
+        size_t size() const { return count; }
+
+        // Removes all the entries
+        void clear() {
+            slots.clear();
+            count = 0;
+        }
+    };
+
+}
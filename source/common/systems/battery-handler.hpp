@@ -23,7 +23,8 @@ namespace our
             lastTime = std::chrono::high_resolution_clock::now();
 			MovementComponent* movement = battery->getComponent<MovementComponent>();
 			movement->movementRangeY = glm::vec2(100.0, 120.0);
-			battery->localTransform.position.y = 100.0;
+			glm::vec3 position = battery->localTransform.getPosition();
+			battery->localTransform.setPosition(glm::vec3(position.x, 100.0, position.z));
 
 			BatteryComponent* batteryComponent = battery->getComponent<BatteryComponent>();
 			batteryComponent->isTaken = true;
@@ -33,18 +34,16 @@ namespace our
 			auto currentTime = std::chrono::high_resolution_clock::now();
 			auto elapsedTime = std::chrono::duration_cast<std::chrono::milliseconds>(currentTime - lastTime).count();
 			if (elapsedTime > delayTime) {
-				// For each battery, check if it is taken, if so, return the movement range to its original values
-				for (auto entity : world->getEntities()) {
-					if (entity->name == "battery") {
-						BatteryComponent* batteryComponent = entity->getComponent<BatteryComponent>();
-						if (batteryComponent->isTaken) {
-							batteryComponent->isTaken = false;
-							// return the battery to its original position
-							MovementComponent* movement = entity->getComponent<MovementComponent>();
-							movement->movementRangeY = glm::vec2(1.5, 4.0);
-
-							entity->localTransform.position.y = 3.0;
-						}
+				// For each battery (an entity with a battery & a movement component), check if it is taken,
+				// if so, return the movement range to its original values
+				for (auto [entity, batteryComponent, movement] : world->query<BatteryComponent, MovementComponent>()) {
+					if (batteryComponent->isTaken) {
+						batteryComponent->isTaken = false;
+						// return the battery to its original position
+						movement->movementRangeY = glm::vec2(1.5, 4.0);
+
+						glm::vec3 position = entity->localTransform.getPosition();
+						entity->localTransform.setPosition(glm::vec3(position.x, 3.0, position.z));
 					}
 				}
 			}
@@ -36,6 +36,11 @@ namespace our
 																																{"movementRangeX", {Xrange.x, Xrange.y}},
 																																{"movementRangeY", {Yrange.x, Yrange.y}},
 																																{"movementRangeZ", {Zrange.x, Zrange.y}}
+																														},
+																														{
+																																{"type", "Collider"},
+																																{"layer", "obstacle"},
+																																{"collidesWith", {"car"}}
 																														}
 																												})}
             };
@@ -0,0 +1,345 @@
+#pragma once
+
+#include "../bounds.hpp"
+#include "frustum-culling.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace our {
+
+    // A ray that starts at "origin" and goes along "direction".
+    // The distances along the ray are measured in multiples of "direction" (so they are in meters if it is normalized).
+    struct Ray {
+        glm::vec3 origin = glm::vec3(0);
+        glm::vec3 direction = glm::vec3(0, 0, -1);
+    };
+
+    // A bounding volume hierarchy over a list of boxes (the items). Every node holds the box that contains all the items below it,
+    // so a query skips a whole subtree as soon as its box misses. It serves three kinds of queries: box overlaps, frustum culling & ray casts.
+    // The tree is built top-down with the surface area heuristic (SAH): every node is split where the expected cost of visiting the two
+    // children (the area of a child box times the number of its items) is the smallest. The candidate splits are found by binning the
+    // item centers in a few buckets per axis, which is almost as good as testing every position and takes linear time per level.
+    // The nodes are flattened into a single array in depth first order (32 bytes each, so two fit in a cache line) and a query walks
+    // them with a small stack instead of following pointers.
+    // The items are referred to by their index in the list given to "build". For objects that move, "refit" recomputes the node boxes
+    // bottom-up without changing the tree, which is much cheaper than a rebuild but makes the tree worse as the objects drift apart
+    // (see "getQuality" to decide when to rebuild).
+    class BVH {
+    public:
+        // A node of the flattened tree. The left child of an inner node is always the next node, so only the right child is stored.
+        struct Node {
+            glm::vec3 min;
+            uint32_t offset;    // The first item in "items" for a leaf, or the index of the right child for an inner node
+            glm::vec3 max;
+            uint32_t count;     // The number of items of a leaf (0 for an inner node)
+
+            bool isLeaf() const { return count != 0; }
+        };
+        static_assert(sizeof(Node) == 32, "The BVH nodes should be 32 bytes");
+
+        static constexpr uint32_t MAX_LEAF_SIZE = 4; // A node with more items is always split (unless all their centers are the same)
+        static constexpr int BIN_COUNT = 12;         // The number of buckets per axis when looking for the best split
+        static constexpr int MAX_DEPTH = 64;         // The size of the query stacks (the binned splits keep the depth far below it)
+    private:
+        std::vector<Node> nodes;
+        std::vector<uint32_t> items;        // The item indices ordered so that the items of every leaf are consecutive
+        std::vector<AABB> itemBounds;       // The box of every item (indexed by the item index)
+        std::vector<glm::vec3> centers;     // The centers of the item boxes (only used while building)
+        float builtCost = 0;                // The SAH cost of the tree right after it was built (see "getQuality")
+
+        static float surfaceArea(const glm::vec3& min, const glm::vec3& max) {
+            glm::vec3 size = glm::max(max - min, glm::vec3(0));
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        static void grow(glm::vec3& min, glm::vec3& max, const AABB& bounds) {
+            min = glm::min(min, bounds.min);
+            max = glm::max(max, bounds.max);
+        }
+
+        // Builds the subtree of the items in [begin, end) and returns the index of its root node
+        uint32_t buildNode(uint32_t begin, uint32_t end, int depth) {
+            uint32_t index = (uint32_t)nodes.size();
+            nodes.emplace_back();
+            glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+            glm::vec3 centerMin = min, centerMax = max;
+            for(uint32_t position = begin; position < end; position++){
+                grow(min, max, itemBounds[items[position]]);
+                centerMin = glm::min(centerMin, centers[items[position]]);
+                centerMax = glm::max(centerMax, centers[items[position]]);
+            }
+            nodes[index].min = min;
+            nodes[index].max = max;
+
+            uint32_t count = end - begin;
+            auto makeLeaf = [&](){
+                nodes[index].offset = begin;
+                nodes[index].count = count;
+                return index;
+            };
+            if(count <= 1) return makeLeaf();
+
+            // Find the split with the smallest SAH cost among the bucket boundaries of all the axes
+            struct Bin { glm::vec3 min, max; uint32_t count; };
+            float bestCost = std::numeric_limits<float>::max();
+            int bestAxis = -1, bestSplit = 0;
+            glm::vec3 centerExtent = centerMax - centerMin;
+            for(int axis = 0; axis < 3; axis++){
+                if(centerExtent[axis] <= 0.0f) continue;
+                Bin bins[BIN_COUNT];
+                for(Bin& bin : bins) bin = {glm::vec3(std::numeric_limits<float>::max()), glm::vec3(-std::numeric_limits<float>::max()), 0};
+                float scale = BIN_COUNT / centerExtent[axis];
+                for(uint32_t position = begin; position < end; position++){
+                    uint32_t item = items[position];
+                    int bin = std::min(BIN_COUNT - 1, (int)((centers[item][axis] - centerMin[axis]) * scale));
+                    bins[bin].count++;
+                    grow(bins[bin].min, bins[bin].max, itemBounds[item]);
+                }
+                // Sweep from the right to get the area & the count on the right of every boundary, then sweep from the left
+                float rightArea[BIN_COUNT - 1];
+                uint32_t rightCount[BIN_COUNT - 1];
+                glm::vec3 sweepMin(std::numeric_limits<float>::max()), sweepMax(-std::numeric_limits<float>::max());
+                uint32_t sweepCount = 0;
+                for(int split = BIN_COUNT - 1; split > 0; split--){
+                    sweepCount += bins[split].count;
+                    if(bins[split].count) grow(sweepMin, sweepMax, {bins[split].min, bins[split].max});
+                    rightArea[split - 1] = surfaceArea(sweepMin, sweepMax);
+                    rightCount[split - 1] = sweepCount;
+                }
+                sweepMin = glm::vec3(std::numeric_limits<float>::max()); sweepMax = -sweepMin;
+                sweepCount = 0;
+                for(int split = 0; split < BIN_COUNT - 1; split++){
+                    sweepCount += bins[split].count;
+                    if(bins[split].count) grow(sweepMin, sweepMax, {bins[split].min, bins[split].max});
+                    if(sweepCount == 0 || rightCount[split] == 0) continue;
+                    float cost = surfaceArea(sweepMin, sweepMax) * sweepCount + rightArea[split] * rightCount[split];
+                    if(cost < bestCost){
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestSplit = split;
+                    }
+                }
+            }
+
+            uint32_t middle;
+            if(bestAxis < 0){
+                // All the centers are the same, so any split is as good as the others: we split the items in two halves
+                if(count <= MAX_LEAF_SIZE) return makeLeaf();
+                middle = begin + count / 2;
+            } else {
+                // A small node stays a leaf if testing its items costs less than visiting the two children (the traversal step costs about one test)
+                float leafCost = surfaceArea(min, max) * count;
+                if(count <= MAX_LEAF_SIZE && bestCost + surfaceArea(min, max) >= leafCost) return makeLeaf();
+                float scale = BIN_COUNT / centerExtent[bestAxis];
+                float axisMin = centerMin[bestAxis];
+                middle = (uint32_t)(std::partition(items.begin() + begin, items.begin() + end, [&](uint32_t item){
+                    return std::min(BIN_COUNT - 1, (int)((centers[item][bestAxis] - axisMin) * scale)) <= bestSplit;
+                }) - items.begin());
+            }
+            // The query stacks are bounded, so a (very unlikely) deep branch ends with a big leaf
+            if(depth + 1 >= MAX_DEPTH) return makeLeaf();
+
+            buildNode(begin, middle, depth + 1);
+            uint32_t right = buildNode(middle, end, depth + 1);
+            nodes[index].offset = right;
+            nodes[index].count = 0;
+            return index;
+        }
+
+        // Returns the SAH cost of the whole tree relative to the area of the root (the expected number of node visits & item tests of a random query)
+        float computeCost() const {
+            if(nodes.empty()) return 0;
+            float rootArea = surfaceArea(nodes[0].min, nodes[0].max);
+            if(rootArea <= 0.0f) return (float)itemBounds.size();
+            float cost = 0;
+            for(const Node& node : nodes)
+                cost += surfaceArea(node.min, node.max) / rootArea * (node.isLeaf() ? (float)node.count : 1.0f);
+            return cost;
+        }
+
+        // Returns whether the box of the node is completely outside one of the planes
+        // The planes that the box is completely inside are removed from the mask, since the children are inside them too
+        static bool outside(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max, uint32_t& planeMask) {
+            glm::vec3 center = (min + max) * 0.5f, extent = (max - min) * 0.5f;
+            for(int plane = 0; plane < 6; plane++){
+                if(!(planeMask & (1u << plane))) continue;
+                const glm::vec4& equation = frustum.planes[plane];
+                float distance = glm::dot(glm::vec3(equation), center) + equation.w;
+                float radius = glm::dot(glm::abs(glm::vec3(equation)), extent);
+                if(distance + radius < 0.0f) return true;
+                if(distance - radius >= 0.0f) planeMask &= ~(1u << plane);
+            }
+            return false;
+        }
+
+    public:
+        // Builds the tree over the given boxes (the item indices are the indices in this list)
+        void build(const std::vector<AABB>& bounds) {
+            itemBounds = bounds;
+            nodes.clear();
+            items.resize(bounds.size());
+            centers.resize(bounds.size());
+            for(uint32_t item = 0; item < bounds.size(); item++){
+                items[item] = item;
+                centers[item] = (bounds[item].min + bounds[item].max) * 0.5f;
+            }
+            // A binary tree with at least one item per leaf has less than twice as many nodes as items
+            nodes.reserve(bounds.size() * 2);
+            if(!bounds.empty()) buildNode(0, (uint32_t)bounds.size(), 0);
+            builtCost = computeCost();
+        }
+
+        // Moves the items to the given boxes and recomputes the boxes of the nodes without changing the tree.
+        // The list must have the same items (in the same order) as the one given to "build", otherwise nothing is done and false is returned.
+        bool refit(const std::vector<AABB>& bounds) {
+            if(bounds.size() != itemBounds.size()) return false;
+            itemBounds = bounds;
+            // The children are always after their parent in the array, so a backward pass visits the children first
+            for(size_t index = nodes.size(); index-- > 0;){
+                Node& node = nodes[index];
+                glm::vec3 min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max());
+                if(node.isLeaf()){
+                    for(uint32_t position = node.offset; position < node.offset + node.count; position++)
+                        grow(min, max, itemBounds[items[position]]);
+                } else {
+                    const Node& left = nodes[index + 1];
+                    const Node& right = nodes[node.offset];
+                    min = glm::min(left.min, right.min);
+                    max = glm::max(left.max, right.max);
+                }
+                node.min = min;
+                node.max = max;
+            }
+            return true;
+        }
+
+        // Calls the given function with the index of every item whose box overlaps the given box
+        template<typename Function>
+        void query(const AABB& bounds, Function&& function) const {
+            if(nodes.empty()) return;
+            uint32_t stack[MAX_DEPTH];
+            int top = 0;
+            stack[top++] = 0;
+            while(top > 0){
+                const Node& node = nodes[stack[--top]];
+                if(!bounds.overlaps({node.min, node.max})) continue;
+                if(node.isLeaf()){
+                    for(uint32_t position = node.offset; position < node.offset + node.count; position++)
+                        if(bounds.overlaps(itemBounds[items[position]])) function(items[position]);
+                } else {
+                    stack[top++] = node.offset;
+                    stack[top++] = (uint32_t)(&node - nodes.data()) + 1;
+                }
+            }
+        }
+
+        // Calls the given function with the index of every item whose box is not completely outside the frustum.
+        // Once a node is completely inside a plane, that plane is not tested again below it, and once it is inside all of them
+        // all its items are reported without any test.
+        template<typename Function>
+        void cull(const Frustum& frustum, Function&& function) const {
+            if(nodes.empty()) return;
+            struct Entry { uint32_t node, planeMask; };
+            Entry stack[MAX_DEPTH];
+            int top = 0;
+            stack[top++] = {0, 0x3F};
+            while(top > 0){
+                Entry entry = stack[--top];
+                const Node& node = nodes[entry.node];
+                if(entry.planeMask && outside(frustum, node.min, node.max, entry.planeMask)) continue;
+                if(node.isLeaf()){
+                    for(uint32_t position = node.offset; position < node.offset + node.count; position++){
+                        uint32_t item = items[position], planeMask = entry.planeMask;
+                        if(planeMask && node.count > 1 && outside(frustum, itemBounds[item].min, itemBounds[item].max, planeMask)) continue;
+                        function(item);
+                    }
+                } else {
+                    stack[top++] = {node.offset, entry.planeMask};
+                    stack[top++] = {entry.node + 1, entry.planeMask};
+                }
+            }
+        }
+
+        // Returns the distance along the ray at which it enters the box (0 if it starts inside), or a negative value if it misses the box
+        // before "maxDistance". "inverseDirection" is 1 / ray.direction (the infinities of the zero components are handled by the slab test).
+        static float intersect(const Ray& ray, const glm::vec3& inverseDirection, const glm::vec3& min, const glm::vec3& max, float maxDistance) {
+            glm::vec3 toMin = (min - ray.origin) * inverseDirection;
+            glm::vec3 toMax = (max - ray.origin) * inverseDirection;
+            glm::vec3 entry = glm::min(toMin, toMax), exit = glm::max(toMin, toMax);
+            float enter = std::max(std::max(entry.x, entry.y), std::max(entry.z, 0.0f));
+            float leave = std::min(std::min(exit.x, exit.y), std::min(exit.z, maxDistance));
+            return enter <= leave ? enter : -1.0f;
+        }
+
+        // Casts a ray through the tree and returns the distance of the closest hit (or "maxDistance" if nothing was hit).
+        // The given function is called with (item, distance at which the ray enters the item box, current closest distance)
+        // for the candidate items, nearest node first, and it returns the distance of the actual hit (anything >= the current closest distance means no hit).
+        // The function can simply return the box distance if the boxes are exact enough.
+        template<typename Function>
+        float raycast(const Ray& ray, float maxDistance, Function&& function) const {
+            if(nodes.empty()) return maxDistance;
+            glm::vec3 inverseDirection = 1.0f / ray.direction;
+            float closest = maxDistance;
+            struct Entry { uint32_t node; float distance; };
+            Entry stack[MAX_DEPTH];
+            int top = 0;
+            float rootDistance = intersect(ray, inverseDirection, nodes[0].min, nodes[0].max, closest);
+            if(rootDistance < 0.0f) return maxDistance;
+            stack[top++] = {0, rootDistance};
+            while(top > 0){
+                Entry entry = stack[--top];
+                // A closer hit could have been found since this node was pushed
+                if(entry.distance >= closest) continue;
+                const Node& node = nodes[entry.node];
+                if(node.isLeaf()){
+                    for(uint32_t position = node.offset; position < node.offset + node.count; position++){
+                        uint32_t item = items[position];
+                        float distance = intersect(ray, inverseDirection, itemBounds[item].min, itemBounds[item].max, closest);
+                        if(distance < 0.0f) continue;
+                        float hit = function(item, distance, closest);
+                        if(hit >= 0.0f && hit < closest) closest = hit;
+                    }
+                    continue;
+                }
+                // Visit the nearer child first (it is pushed last) so that the farther one is often skipped
+                uint32_t children[2] = {entry.node + 1, node.offset};
+                float distances[2];
+                for(int child = 0; child < 2; child++)
+                    distances[child] = intersect(ray, inverseDirection, nodes[children[child]].min, nodes[children[child]].max, closest);
+                int first = distances[0] <= distances[1] ? 0 : 1;
+                if(distances[0] < 0.0f) first = 1;
+                if(distances[1] < 0.0f) first = 0;
+                int second = 1 - first;
+                if(distances[second] >= 0.0f) stack[top++] = {children[second], distances[second]};
+                if(distances[first] >= 0.0f) stack[top++] = {children[first], distances[first]};
+            }
+            return closest;
+        }
+
+        // Returns the number of items & nodes
+        size_t size() const { return itemBounds.size(); }
+        size_t getNodeCount() const { return nodes.size(); }
+        // Returns the box of the given item (as given to the last "build" or "refit")
+        const AABB& getItemBounds(uint32_t item) const { return itemBounds[item]; }
+        // Returns the nodes (e.g. to draw them for debugging)
+        const std::vector<Node>& getNodes() const { return nodes; }
+
+        // Returns the SAH cost of the tree divided by its cost right after it was built. It is 1 after a build and grows as
+        // the refitted items drift away from the positions the tree was built for, so the owner can rebuild once it passes a threshold.
+        float getQuality() const { return builtCost > 0.0f ? computeCost() / builtCost : 1.0f; }
+
+        // Removes all the items
+        void clear() {
+            nodes.clear();
+            items.clear();
+            itemBounds.clear();
+            builtCost = 0;
+        }
+    };
+
+}
@@ -43,15 +43,8 @@ namespace our
         void initialize(Application* app, World* world){
             this->app = app;
 
-            // First of all, we search for an entity containing both a CameraComponent and a CarMovementComponent
-            // As soon as we find one, we break
-            for(auto entity : world->getEntities()){
-                // if the entity is car then set the car
-				if(entity->name == "car"){
-                    car = entity;
-                    break;
-                }
-            }
+            // First of all, we find the car entity by its name (the world keeps an index of the names)
+            car = world->findByName("car");
         }
 
         void decreaseCarSpeed(){
@@ -68,12 +61,12 @@ namespace our
             if(!(car)){
                 return;
             }
-            // We get a reference to the camera entity's position and rotation and car rotation
-            glm::vec3& position = car->localTransform.position;
-            glm::vec3& rotation = car->localTransform.rotation; 
+            // We get a copy of the car position and rotation (they are set back through the transform setters at the end)
+            glm::vec3 position = car->localTransform.getPosition();
+            glm::vec3 rotation = car->localTransform.getRotation();
 
-            // We get the camera model matrix (relative to its parent) to compute the front, up and right directions
-            glm::mat4 matrix = car->localTransform.toMat4();
+            // We get the car model matrix (relative to its parent) to compute the front, up and right directions
+            glm::mat4 matrix = car->localTransform.getMatrix();
 
             glm::vec3 front = glm::vec3(matrix * glm::vec4(0, 0, 1, 0)),
             right = glm::vec3(matrix * glm::vec4(-1, 0, 0, 0));
@@ -129,6 +122,10 @@ namespace our
                 rotation.y +=this->rateOfRotation;
             }            
 
+            // Only mark the transform dirty if the car actually moved
+            if(position != car->localTransform.getPosition()) car->localTransform.setPosition(position);
+            if(rotation != car->localTransform.getRotation()) car->localTransform.setRotation(rotation);
+
     }
 };  
 
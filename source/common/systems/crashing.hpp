@@ -11,9 +11,14 @@
 #include <systems/car-movement.hpp>
 #include <systems/battery-handler.hpp>
 #include <systems/sound.hpp>
+#include <systems/bvh.hpp>
+#include <components/collider.hpp>
 
 
 #include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <vector>
 using namespace std;
 
 #define CrashTime 500
@@ -39,47 +44,66 @@ namespace our
         std::chrono::high_resolution_clock::time_point lastCrashTime, currentTime;
         CarMovementSystem* carMovement;
 
+        ColliderComponent *carCollider;
+
+        // The collision layers of the entities the car can crash into (the colliders are deserialized with the entities)
+        const uint32_t deliveryLayer = getCollisionLayer("delivery");
+        const uint32_t knifeLayer = getCollisionLayer("knife");
+        const uint32_t destinationLayer = getCollisionLayer("destination");
+        const uint32_t poleLayer = getCollisionLayer("pole");
+        const uint32_t batteryLayer = getCollisionLayer("battery");
+        const uint32_t buildingLayer = getCollisionLayer("building");
+        const uint32_t obstacleLayer = getCollisionLayer("obstacle");
+        // The order in which the crashes are handled every frame
+        const std::vector<uint32_t> handlingOrder = {
+            deliveryLayer, knifeLayer, destinationLayer, poleLayer, batteryLayer, buildingLayer, obstacleLayer
+        };
+
+        // The broad-phase: the world bounds of all the colliders (except the car's) are kept in two bounding volume hierarchies
+        // so that we only test the car against its neighbours. The static colliders never move, so their tree is built once.
+        // The dynamic tree is refitted to the new bounds every frame, and it is only rebuilt when the list of dynamic colliders changes
+        // or when the refitted tree became too loose. The items of the trees are the indices in the collider lists (nullptr once forgotten).
+        BVH staticTree, dynamicTree;
+        std::vector<ColliderComponent*> staticColliders, dynamicColliders, currentDynamicColliders;
+        std::vector<AABB> dynamicBounds;
+        // The dynamic tree is rebuilt when its SAH cost grows past this multiple of its cost when it was built
+        static constexpr float MAX_DYNAMIC_TREE_DEGRADATION = 1.5f;
+        // The candidates found by the broad-phase in this frame (index in "handlingOrder", collider)
+        std::vector<std::pair<size_t, ColliderComponent*>> candidates;
+        double collisionTime = 0;
+
         void setCar(World* world) {
-            // For each entity in the world
-			// Check if it's name is "car" and then set the car entity we have
-            for (auto entity : world->getEntities()){
-                if (entity->name == "car"){
-					car = entity;
-					break;
-                }
-            }
+			// Find the entity named "car" and then set the car entity we have
+            car = world->findByName("car");
+            carCollider = car ? car->getComponent<ColliderComponent>() : nullptr;
+            if (car && !carCollider)
+                std::cerr << "The car has no collider, it will not crash into anything" << std::endl;
         }
 
-		bool crash(Entity *object1, Entity *object2, std::string type) {
-			// Get the car's max position, min position, current position, and size
-			glm::vec3 object1Position = object1->localTransform.position;
-			glm::vec3 object1Size = object1->localTransform.scale;
-			glm::vec3 object1Max = object1Position + object1Size;
-			glm::vec3 object1Min = object1Position - object1Size;
-
-			// Get the collider's position
-			glm::vec3 object2Position = object2->localTransform.position;
-
-			glm::vec3 object2Size = object2->localTransform.scale;
-			
-			// Set the object size
-			if (type == "destination")
-				object2Size = {1.5, 10.0, 1.5};
-			else if (type == "pole")
-				object2Size = {0.2, 0.5, 0.2};
-			else if (type == "building")
-				object2Size += glm::vec3(0.2, 0, 0.2);
-			else if (type == "knife")
-				object2Size -= glm::vec3(12, 12, 12);
-
-			// Get the collider's max and min positions
-			glm::vec3 object2Max = object2Position + object2Size;
-			glm::vec3 object2Min = object2Position - object2Size;
-
-			// If the car is in the range of the obstacle, that's a collision!
-			return (object1Max.x >= object2Min.x && object1Min.x <= object2Max.x &&
-					object1Max.y >= object2Min.y && object1Min.y <= object2Max.y &&
-					object1Max.z >= object2Min.z && object1Min.z <= object2Max.z);
+		// Collects the dynamic colliders and their bounds, then refits the dynamic tree (or rebuilds it if the colliders changed)
+		void syncDynamicColliders(World* world) {
+			currentDynamicColliders.clear();
+			dynamicBounds.clear();
+			for (auto [entity, collider] : world->query<ColliderComponent>()) {
+				if (collider->isStatic || collider == carCollider) continue;
+				currentDynamicColliders.push_back(collider);
+				// The bounds are cached by the collider, so this only recomputes the ones of the entities that moved
+				dynamicBounds.push_back(collider->getWorldBounds());
+			}
+			if (currentDynamicColliders == dynamicColliders) {
+				dynamicTree.refit(dynamicBounds);
+				if (dynamicTree.getQuality() <= MAX_DYNAMIC_TREE_DEGRADATION) return;
+			} else {
+				dynamicColliders.swap(currentDynamicColliders);
+			}
+			dynamicTree.build(dynamicBounds);
+		}
+
+		// Removes an entity from the trees (called right before a crash handler deletes it)
+		void forgetCollider(Entity* entity) {
+			for (auto colliders : {&staticColliders, &dynamicColliders})
+				for (auto& collider : *colliders)
+					if (collider && collider->getOwner() == entity) collider = nullptr;
 		}
 
      	public:
@@ -91,6 +115,20 @@ namespace our
 				this->carMovement = carMovement;
 				setCar(world);
 
+				// The static colliders never move, so their tree is built once
+				// (the dynamic tree is built by "syncDynamicColliders" in the first update)
+				staticColliders.clear();
+				dynamicColliders.clear();
+				dynamicTree.clear();
+				std::vector<AABB> staticBounds;
+				for (auto [entity, collider] : world->query<ColliderComponent>()) {
+					if (collider->isStatic && collider != carCollider) {
+						staticColliders.push_back(collider);
+						staticBounds.push_back(collider->getWorldBounds());
+					}
+				}
+				staticTree.build(staticBounds);
+
 				// Prevent the car from crashing at the start
 				lastCrashTime = std::chrono::high_resolution_clock::now();
 			}
@@ -111,31 +149,56 @@ namespace our
 			bool update(World* world,std::string&postProcessIndicator){
 
 				bool applyPostProcess=false;
+				if (!car || !carCollider) return false;
+				auto startTime = std::chrono::high_resolution_clock::now();
 
-				// For each entity in the world
-				for (auto entity : world->getEntities()) {
+				// Broad-phase: we only visit the colliders whose boxes overlap the car box in the trees
+				// and whose layers can collide with the car (a bit test instead of comparing names)
+				syncDynamicColliders(world);
+				candidates.clear();
+				auto addCandidate = [&](ColliderComponent* collider){
+					if (!collider || !carCollider->canCollideWith(collider))
+						return;
+					for (size_t kind = 0; kind < handlingOrder.size(); kind++) {
+						if (collider->layer & handlingOrder[kind]) {
+							candidates.emplace_back(kind, collider);
+							break;
+						}
+					}
+				};
+				const AABB& carBounds = carCollider->getWorldBounds();
+				staticTree.query(carBounds, [&](uint32_t item){ addCandidate(staticColliders[item]); });
+				dynamicTree.query(carBounds, [&](uint32_t item){ addCandidate(dynamicColliders[item]); });
+				// Handle the crashes in the order of the layers (e.g. a delivery is dropped before crashing with a building)
+				std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b){ return a.first < b.first; });
 
-					if (entity->name == "car")
+				// Narrow-phase: the exact test for every candidate
+				for (auto [kind, collider] : candidates) {
+					if (!carCollider->intersects(collider))
 						continue;
+					Entity* entity = collider->getOwner();
+					uint32_t layer = handlingOrder[kind];
 
 					// Delivery Pick-up
-					if (entity->name == "delivery" && crash(car, entity, "delivery")) {
+					if (layer == deliveryLayer) {
 						if (!events->isCarryDeliver()) {
 							monkeys.play();
 							events->collectDeliver();
 							delivery->addDeliveryOnCar();
+							forgetCollider(entity);
 							delivery->removeDelivery(entity, world);
 						}
 					}
 					// Knife Pick-up
-					else if (entity->name == "knife" && crash(car, entity, "knife")) {
+					else if (layer == knifeLayer) {
 						if (!events->carryingKnife()) {
 							events->collectKnife();
+							forgetCollider(entity);
 							events->addKnife(entity, world);
 						}
 					}
 					// Arrived at the destination
-					else if (entity->name == "arrow" && crash(car, entity, "destination")) {
+					else if (layer == destinationLayer) {
 						if (!checkTime())
 							continue;
 						bool carryingDelivery = events->isCarryDeliver();
@@ -150,18 +213,18 @@ namespace our
 						delivery->removeDeliveryOnCar();
 					}
 					// Hit a street pole
-					else if (entity->name == "StreetPole" && crash(car, entity, "pole")) {
+					else if (layer == poleLayer) {
 						carMovement->poleCrash();
 					}
 					// Getting energy from a battery
-					else if (entity->name == "battery" && crash(car, entity, "battery")) {
+					else if (layer == batteryLayer) {
 						energy->batteryCrash();
 						batterySystem->takeBattery(entity);
 						applyPostProcess=true;
 						postProcessIndicator="battery";
 					}
 					// Crashing with a building
-					else if (entity->name == "building" && crash(car, entity, "building")) {
+					else if (layer == buildingLayer) {
 						if (!checkTime())
 							continue;
 						buildingCrash.play();
@@ -170,12 +233,13 @@ namespace our
 						postProcessIndicator="obstacle";
 					}
 					// Crashing with an obstacle
-					else if (entity->name == "obstacles" && crash(car, entity, "obstacle")) {
+					else if (layer == obstacleLayer) {
 						if (!checkTime())
 							continue;
 
 						if (events->carryingKnife()) {
 							slice.play();
+							forgetCollider(entity);
 							events->killMonkey(entity, world);
 						}
 						else {
@@ -187,7 +251,35 @@ namespace our
 						}
 					}
 				}
+
+				auto endTime = std::chrono::high_resolution_clock::now();
+				collisionTime = std::chrono::duration<double, std::milli>(endTime - startTime).count();
 				return applyPostProcess;
 			}
+
+			// Returns the time (in milliseconds) spent detecting & handling the crashes in the last update
+			double getCollisionTime() const { return collisionTime; }
+			// Returns the number of entities that passed the broad-phase in the last update
+			size_t getCandidateCount() const { return candidates.size(); }
+
+			// Casts the ray against the boxes of the active colliders (except the car's) whose layer is in "layers"
+			// and returns the closest one it hits, or nullptr if it hits nothing before "maxDistance" (e.g. for camera collisions or picking).
+			// If "distance" is given, it receives the distance of the hit along the ray.
+			ColliderComponent* raycast(const Ray& ray, float maxDistance, uint32_t layers = ~0u, float* distance = nullptr) const {
+				ColliderComponent* hit = nullptr;
+				float closest = maxDistance;
+				auto cast = [&](const BVH& tree, const std::vector<ColliderComponent*>& colliders){
+					closest = tree.raycast(ray, closest, [&](uint32_t item, float boxDistance, float current){
+						ColliderComponent* collider = colliders[item];
+						if (!collider || boxDistance >= current || !(collider->layer & layers) || !collider->isActive()) return -1.0f;
+						hit = collider;
+						return boxDistance;
+					});
+				};
+				cast(staticTree, staticColliders);
+				cast(dynamicTree, dynamicColliders);
+				if (distance) *distance = closest;
+				return hit;
+			}
     };
 }
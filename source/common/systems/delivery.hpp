@@ -15,13 +15,7 @@ namespace our
 		vector<glm::vec3> pickUpPoints; // points that we will choose randomly from them
 
         void getDeliveryOnCar(World* world) {
-            // For each entity in the world
-            for(auto entity : world->getEntities()){
-                if(entity->name == "delivery-on-car"){
-					deliveryOnCar = entity;
-					break;
-                }
-            }
+            deliveryOnCar = world->findByName("delivery-on-car");
         }
 
 		nlohmann::json generateDelivery(glm::vec3 position, std::string name) {
@@ -39,6 +33,12 @@ namespace our
 					{
 						{"type", "Movement"},
 						{"angularVelocity", {0, 30, 0}}
+					},
+					{
+						{"type", "Collider"},
+						{"layer", "delivery"},
+						{"collidesWith", {"car"}},
+						{"trigger", true}
 					}
 				})}
 			};
@@ -48,13 +48,7 @@ namespace our
     
         void initialize(World* world, int numOfDeliveries) {
 			// Get the delivery points from the world
-			Entity* deliveryPoints;
-			for(auto entity : world->getEntities()){
-				if(entity->name == "deliveries"){
-					deliveryPoints = entity;
-					break;
-				}
-			}
+			Entity* deliveryPoints = world->findByName("deliveries");
 
 			// Get the list of poistion point components
 			auto positionComponents = deliveryPoints->getComponents<PositionPointComponent>();
@@ -81,11 +75,11 @@ namespace our
         }
 
 		void removeDeliveryOnCar() {
-			deliveryOnCar->localTransform.scale = glm::vec3(0, 0, 0);
+			deliveryOnCar->localTransform.setScale(glm::vec3(0, 0, 0));
 		}
 
 		void addDeliveryOnCar() {
-			deliveryOnCar->localTransform.scale = glm::vec3(0.35,0.35, 0.35);
+			deliveryOnCar->localTransform.setScale(glm::vec3(0.35,0.35, 0.35));
 		}
 
 		void removeDelivery(Entity* delivery, World* world) {
@@ -20,27 +20,11 @@ namespace our
         bool crashed = false;
 
         Entity* getCar(World* world) {
-            Entity* car = nullptr;
-            // For each entity in the world
-            for(auto entity : world->getEntities()){
-                if(entity->name == "car"){
-                    car = entity;
-					break;
-                }
-            }
-            return car;
+            return world->findByName("car");
         }
 
         Entity* getCamera(World* world) {
-            Entity* camera = nullptr;
-            // For each entity in the world
-            for(auto entity : world->getEntities()){
-                if(entity->name == "camera"){
-                    camera = entity;
-					break;
-                }
-            }
-            return camera;
+            return world->findByName("camera");
         }
         // Save the car entity
         int energy = 100, energyBarsSize;
@@ -53,14 +37,13 @@ namespace our
             float percentage = ((float)energy / 100) * 100; // calculate the percentage of energy
             for (int i = 0; i < energyBarsSize; i++)
             {
-                if (percentage >= i * 100.0 / energyBarsSize)
-                {
-                    energyBars[energyBarsSize - i - 1]->localTransform.scale.x = 0.05; // show the energy bar
-                }
-                else
-                {
-                    energyBars[energyBarsSize - i - 1]->localTransform.scale.x = 0.0; // hide the energy bar
-                }
+                Transform &transform = energyBars[energyBarsSize - i - 1]->localTransform;
+                glm::vec3 scale = transform.getScale();
+                // show the energy bar or hide it
+                scale.x = percentage >= i * 100.0 / energyBarsSize ? 0.05f : 0.0f;
+                // This is called every frame, so we only touch the transforms of the bars that changed
+                if (scale != transform.getScale())
+                    transform.setScale(scale);
             }
         }
 
@@ -109,13 +92,10 @@ namespace our
             energy = 100;
 
             // Construct the energy bar
-            for (auto entity : world->getEntities())
+            world->forEachWithTag(internTag("camera"), [&](Entity *entity)
             {
-                if (entity->name == "camera")
-                {
-                    constructEnergybar(entity, 1.73, 5.115, 0.1);
-                }
-            }
+                constructEnergybar(entity, 1.73, 5.115, 0.1);
+            });
         }
 
         int getEnergy()
@@ -160,8 +140,8 @@ namespace our
                 if (crashed) {
                     Entity* car = getCar(world);
                     if (car) {
-                        car->localTransform.position = glm::vec3(-52, 1.12, 43);
-						car->localTransform.rotation = glm::vec3(0, -180, 0);
+                        car->localTransform.setPosition(glm::vec3(-52, 1.12, 43));
+						car->localTransform.setRotation(glm::vec3(0, -180, 0));
                         crashed = false;
                     }
                 }
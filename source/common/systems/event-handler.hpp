@@ -41,24 +41,9 @@ namespace our
             this->knife = knifeSystem;
 
             // Get front and back lights
-            for (auto entity : world->getEntities()){
-				if (entity->name == "frontLight"){
-                    frontLight = entity;
-                    break;
-                }
-            }
-            for (auto entity : world->getEntities()){
-                if (entity->name == "backLight") {
-                    backLight = entity;
-                    break;
-                }
-            }
-            for (auto entity : world->getEntities()){
-				if (entity->name == "knife-on-car"){
-                    knifeOnCar = entity;
-                    break;
-                }   
-            }
+            frontLight = world->findByName("frontLight");
+            backLight = world->findByName("backLight");
+            knifeOnCar = world->findByName("knife-on-car");
         }
 
         void collectDeliver(){
@@ -131,22 +116,23 @@ namespace our
 				lastTime = std::chrono::high_resolution_clock::now();
                 clickButton = false;
 
-                if (frontLight->localTransform.scale == glm::vec3(0, 0, 0)) {
-                    frontLight->localTransform.scale = glm::vec3(1, 1, 1);
-                    backLight->localTransform.scale = glm::vec3(1, 1, 1);
+                if (frontLight->localTransform.getScale() == glm::vec3(0, 0, 0)) {
+                    frontLight->localTransform.setScale(glm::vec3(1, 1, 1));
+                    backLight->localTransform.setScale(glm::vec3(1, 1, 1));
                 }
                 else {
-                    frontLight->localTransform.scale = glm::vec3(0, 0, 0);
-                    backLight->localTransform.scale = glm::vec3(0, 0, 0);
+                    frontLight->localTransform.setScale(glm::vec3(0, 0, 0));
+                    backLight->localTransform.setScale(glm::vec3(0, 0, 0));
                 }
             }
 
             // Throwing knife
-            if (knifeOnCar && knifeOnCar->localTransform.scale != glm::vec3(0, 0, 0)){
+            if (knifeOnCar && knifeOnCar->localTransform.getScale() != glm::vec3(0, 0, 0)){
 
-                float lastXPos=knifeOnCar->localTransform.position.x;
-                float lastYPos=knifeOnCar->localTransform.position.y;
-                glm::mat4 knifeMatrix = knifeOnCar->localTransform.toMat4();
+                glm::vec3 position = knifeOnCar->localTransform.getPosition();
+                float lastXPos=position.x;
+                float lastYPos=position.y;
+                glm::mat4 knifeMatrix = knifeOnCar->localTransform.getMatrix();
                 //getting the value of the front vector which is vector in Z direction multiplied by the matrix calculated before
                 glm::vec3 front = glm::vec3(knifeMatrix * glm::vec4(0, 0, 1, 0));
 
@@ -158,27 +144,30 @@ namespace our
                 }
                 //If we enabled moving forward then we need to increase the value of Z to move forward
                 if(moveKnifeForward){
-                    knifeOnCar->localTransform.position += front*(float(0.03));
+                    position += front*(float(0.03));
                 }
 
-                if(knifeOnCar->localTransform.position.z>=7){
+                if(position.z>=7){
                     moveKnifeForward=false;
                     moveKnifeBackward=true;
-                    knifeOnCar->localTransform.position.z=7;
+                    position.z=7;
                 }
 
-                if(knifeOnCar->localTransform.position.z<=0){
+                if(position.z<=0){
                     moveKnifeBackward=false;
                     moveKnifeForward=false;
-                    knifeOnCar->localTransform.position.z=0;
+                    position.z=0;
                 }
                 //If we reached our maximum position then we need to enable moving backward then returning back to initial position
                 if(moveKnifeBackward){
-                    knifeOnCar->localTransform.position -= front*(float(0.05));
+                    position -= front*(float(0.05));
                 }
 
-                knifeOnCar->localTransform.position.x=lastXPos;
-                knifeOnCar->localTransform.position.y=lastYPos;
+                position.x=lastXPos;
+                position.y=lastYPos;
+                // Only touch the transform if the knife moved (to keep its cached matrix otherwise)
+                if(position != knifeOnCar->localTransform.getPosition())
+                    knifeOnCar->localTransform.setPosition(position);
             }
         }
     };
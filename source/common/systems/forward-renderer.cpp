@@ -12,6 +12,28 @@ namespace our
 		// First, we store the window size for later use
 		this->windowSize = windowSize;
 
+		// Create the uniform buffer that holds the lights (and the sky colors) for all the lit shaders
+		// Its storage is allocated here once and only its content is replaced every frame
+		glGenBuffers(1, &lightUniformBuffer);
+		glBindBuffer(GL_UNIFORM_BUFFER, lightUniformBuffer);
+		glBufferData(GL_UNIFORM_BUFFER, sizeof(LightBlock), nullptr, GL_DYNAMIC_DRAW);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_LIGHTS_BINDING, lightUniformBuffer);
+		// and the buffer textures that hold the lights and their assignment to the clusters
+		lightClusters.initialize(config);
+		// The frustum culling can be disabled from the config (e.g. to compare the performance with & without it)
+		frustumCulling = config.value("frustumCulling", true);
+		// The commands that share the mesh & the material are drawn by instanced draw calls (if their material has an instanced shader)
+		instancing = config.value("instancing", true);
+		minInstances = std::max(config.value("minInstances", 2), 1);
+		glGenBuffers(1, &instanceBuffer);
+		// The runs of commands that share a material & whose meshes are in the mesh arena are submitted by multi draws from indirect commands
+		multiDrawIndirect = config.value("multiDrawIndirect", true);
+		glGenBuffers(1, &indirectBuffer);
+		// The per frame data is streamed through a ring of buffer regions, the uniform blocks in it must respect the offset alignment
+		frameRing.initialize(config.value("frameRingSize", 1 << 20));
+		glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+
 		// Then we check if there is a sky texture in the configuration
 		if (config.contains("sky"))
 		{
@@ -65,11 +87,8 @@ namespace our
 		// Then we check if there is a postprocessing shader in the configuration
 		if (config.contains("postprocess"))
 		{
-			if (config.contains("energyPostProcess"))
-			{
-				this->boostPath = config.value<std::string>("energyPostProcess", "");
-			}
-			this->crashingPath = config.value<std::string>("postprocess", "");
+			// Compile every postprocess effect listed in the configuration once, so that switching between them while playing costs nothing
+			postprocessEffects.deserialize(config);
 			// TODO: (Req 11) Create a framebuffer
 			//  Generating FrameBuffer
 			glGenFramebuffers(1, &postprocessFrameBuffer);
@@ -101,15 +120,10 @@ namespace our
 			postprocessSampler->set(GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
 			postprocessSampler->set(GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-			// Create the post processing shader
-			ShaderProgram *postprocessShader = new ShaderProgram();
-			postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-			postprocessShader->attach(this->crashingPath, GL_FRAGMENT_SHADER);
-			postprocessShader->link();
-
 			// Create a post processing material
+			// Its shader is picked from the effect registry every frame based on the active effect
 			postprocessMaterial = new TexturedMaterial();
-			postprocessMaterial->shader = postprocessShader;
+			postprocessMaterial->shader = postprocessEffects.get("obstacle");
 			postprocessMaterial->texture = colorTarget;
 			postprocessMaterial->sampler = postprocessSampler;
 			// The default options are fine but we don't need to interact with the depth buffer
@@ -121,6 +135,15 @@ namespace our
 
 	void ForwardRenderer::destroy()
 	{
+		// Delete the light uniform buffer
+		glDeleteBuffers(1, &lightUniformBuffer);
+		lightUniformBuffer = 0;
+		glDeleteBuffers(1, &instanceBuffer);
+		instanceBuffer = 0;
+		glDeleteBuffers(1, &indirectBuffer);
+		indirectBuffer = 0;
+		frameRing.destroy();
+		lightClusters.destroy();
 		// Delete all objects related to the sky
 		if (skyMaterial)
 		{
@@ -134,59 +157,251 @@ namespace our
 		if (postprocessMaterial)
 		{
 			glDeleteFramebuffers(1, &postprocessFrameBuffer);
+			GLStateCache::get().forgetVertexArray(postProcessVertexArray);
 			glDeleteVertexArrays(1, &postProcessVertexArray);
 			delete colorTarget;
 			delete depthTarget;
 			delete postprocessMaterial->sampler;
-			delete postprocessMaterial->shader;
 			delete postprocessMaterial;
+			// The postprocess shaders are owned by the effect registry
+			postprocessEffects.clear();
 		}
 	}
 
-	void ForwardRenderer::render(World *world)
+	void ForwardRenderer::uploadLights(CameraComponent *camera)
 	{
-		// First of all, we search for a camera and for all the mesh renderers
-		CameraComponent *camera = nullptr;
-		opaqueCommands.clear();
-		transparentCommands.clear();
-		lights.clear();
+		// Assign the lights to the clusters of the camera frustum and upload them to the buffer textures
+		glm::mat4 view = camera->getViewMatrix();
+		glm::mat4 projection = camera->getProjectionMatrix(windowSize);
+		lightClusters.build(lights, view, projection, camera->cameraType == CameraType::PERSPECTIVE);
+		lightClusters.upload();
+
+		// The sky colors are used for the ambient light
+		lightBlock.skyTop = glm::vec3(0.0f, 0.1f, 0.5f);
+		lightBlock.skyHorizon = glm::vec3(0.3f, 0.3f, 0.3f);
+		lightBlock.skyBottom = glm::vec3(0.1f, 0.1f, 0.1f);
+
+		lightBlock.lightCount = lightClusters.getLightCount();
+		lightBlock.globalLightCount = lightClusters.getGlobalLightCount();
+		lightBlock.viewportSize = glm::vec2(windowSize);
+		lightBlock.clusterCount = glm::ivec4(lightClusters.getClusterCount(), 0);
+		lightBlock.clusterDepth = lightClusters.getDepthParameters();
+		// The view depth is minus the view space z, which is the third row of the view matrix
+		lightBlock.viewDepth = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]);
+
+		// The block is written to the frame ring and the light binding point is pointed at its slice
+		if (FrameAllocation allocation = frameRing.upload(&lightBlock, sizeof(LightBlock), uniformAlignment))
+		{
+			glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_LIGHTS_BINDING, frameRing.getBuffer(), allocation.offset, sizeof(LightBlock));
+			return;
+		}
+		glBindBuffer(GL_UNIFORM_BUFFER, lightUniformBuffer);
+		glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(LightBlock), &lightBlock);
+		glBindBuffer(GL_UNIFORM_BUFFER, 0);
+		// Make sure the buffer is still the one bound to the light binding point (another system could have replaced it)
+		glBindBufferBase(GL_UNIFORM_BUFFER, UNIFORM_BLOCK_LIGHTS_BINDING, lightUniformBuffer);
+	}
+
+	void ForwardRenderer::buildBatches(const std::vector<RenderCommand> &commands, const std::vector<SortItem> &order, std::vector<DrawBatch> &batches, bool allowIndirect)
+	{
+		// Appends the matrices of an instance (the lit shaders also need the inverse transpose of the model matrix, so it follows the model matrix)
+		auto addInstance = [&](const glm::mat4 &localToWorld, bool lit)
+		{
+			instanceData.push_back(localToWorld);
+			if (lit)
+				instanceData.push_back(glm::transpose(glm::inverse(localToWorld)));
+		};
 
-		for (auto entity : world->getEntities())
+		batches.clear();
+		for (uint32_t first = 0; first < order.size();)
 		{
-			// If we hadn't found a camera yet, we look for a camera in this entity
-			if (!camera)
-				camera = entity->getComponent<CameraComponent>();
-			// If this entity has a mesh renderer component
-			if (auto meshRenderer = entity->getComponent<MeshRendererComponent>(); meshRenderer)
+			const RenderCommand &command = commands[order[first].index];
+			MeshArena *arena = command.mesh->getArena();
+			if (allowIndirect && instancing && multiDrawIndirect && command.material->instancedShader && arena)
 			{
-				// We construct a command from it
-				RenderCommand command;
-				command.localToWorld = meshRenderer->getOwner()->getLocalToWorldMatrix();
-				command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
-				command.mesh = meshRenderer->mesh;
-				command.material = meshRenderer->material;
-				// if it is transparent, we add it to the transparent commands list
-				if (command.material->transparent)
-				{
-					transparentCommands.push_back(command);
-				}
-				else
+				// Find the end of the run of commands that share the material and whose meshes are in the same arena
+				uint32_t end = first + 1;
+				while (end < order.size() && commands[order[end].index].material == command.material && commands[order[end].index].mesh->getArena() == arena)
+					end++;
+				if (end - first >= (uint32_t)minInstances)
 				{
-					// Otherwise, we add it to the opaque command list
-					opaqueCommands.push_back(command);
+					bool lit = dynamic_cast<const LightMaterial *>(command.material) != nullptr;
+					DrawBatch batch{first, end - first, true, instanceData.size() * sizeof(glm::mat4)};
+					batch.indirect = true;
+					batch.indirectFirst = (uint32_t)indirectCommands.size();
+					// Every mesh of the run is a command whose instances are the consecutive commands that use it
+					GLuint instance = 0;
+					for (uint32_t meshFirst = first; meshFirst < end;)
+					{
+						Mesh *mesh = commands[order[meshFirst].index].mesh;
+						uint32_t meshEnd = meshFirst + 1;
+						while (meshEnd < end && commands[order[meshEnd].index].mesh == mesh)
+							meshEnd++;
+						indirectCommands.push_back(mesh->getIndirectCommand(meshEnd - meshFirst, instance));
+						instance += meshEnd - meshFirst;
+						for (uint32_t position = meshFirst; position < meshEnd; position++)
+							addInstance(commands[order[position].index].localToWorld, lit);
+						meshFirst = meshEnd;
+					}
+					batch.indirectCount = (uint32_t)indirectCommands.size() - batch.indirectFirst;
+					batches.push_back(batch);
+					first = end;
+					continue;
 				}
 			}
-			// If the entity has a light component, we add it to the lights list
-			if (auto light = entity->getComponent<LightComponent>(); light)
+			// Find the end of the run of commands that share the mesh & the material
+			uint32_t end = first + 1;
+			while (end < order.size() && commands[order[end].index].mesh == command.mesh && commands[order[end].index].material == command.material)
+				end++;
+
+			if (instancing && command.material->instancedShader && end - first >= (uint32_t)minInstances)
+			{
+				bool lit = dynamic_cast<const LightMaterial *>(command.material) != nullptr;
+				batches.push_back({first, end - first, true, instanceData.size() * sizeof(glm::mat4)});
+				for (uint32_t position = first; position < end; position++)
+					addInstance(commands[order[position].index].localToWorld, lit);
+			}
+			else
 			{
-				lights.push_back(light);
+				// Otherwise, every command is a batch of its own
+				for (uint32_t position = first; position < end; position++)
+					batches.push_back({position, 1, false, 0});
 			}
+			first = end;
+		}
+	}
+
+	void ForwardRenderer::buildStaticTree(const std::vector<Entity *> &entities)
+	{
+		staticEntities = entities;
+		staticAssetVersion = AssetStreamer::get().getVersion();
+		staticCommands.clear();
+		std::vector<AABB> bounds;
+		bounds.reserve(entities.size());
+		for (Entity *entity : entities)
+		{
+			MeshRendererComponent *meshRenderer = entity->getComponent<MeshRendererComponent>();
+			RenderCommand command;
+			command.localToWorld = entity->getLocalToWorldMatrix();
+			command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
+			command.mesh = meshRenderer->mesh;
+			command.material = meshRenderer->material;
+			staticCommands.push_back(command);
+			bounds.push_back(command.mesh->getBounds().transformed(command.localToWorld));
+		}
+		staticTree.build(bounds);
+	}
+
+	void ForwardRenderer::render(World *world)
+	{
+		// First of all, we search for a camera and for all the mesh renderers
+		CameraComponent *camera = nullptr;
+		opaqueCommands.clear();
+		transparentCommands.clear();
+		lights.clear();
+
+		// Refresh the cached world matrices of the entities that moved since the last frame (the rest are reused as they are)
+		world->updateTransforms();
+
+		// The camera is the first entity that has a camera component
+		for (auto [entity, cameraComponent] : world->query<CameraComponent>())
+		{
+			camera = cameraComponent;
+			break;
+		}
+
+		// Then the entities that have a light component
+		for (auto [entity, light] : world->query<LightComponent>())
+		{
+			lights.push_back(light);
 		}
 
 		// If there is no camera, we return (we cannot render without a camera)
 		if (camera == nullptr)
 			return;
 
+		// TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
+		// Multiply the camera projection matrix after passing the window size with the view matrix
+		glm::mat4 VP = camera->getProjectionMatrix(windowSize) * camera->getViewMatrix();
+
+		// Start writing the data of this frame to the next region of the ring (this only waits if the GPU is a few frames behind)
+		frameRing.beginFrame();
+
+		// We only visit the entities that have a mesh renderer component
+		visibilityCandidates.clear();
+		frustumCuller.clear();
+		currentStaticEntities.clear();
+		for (auto [entity, meshRenderer] : world->query<MeshRendererComponent>())
+		{
+			// The static mesh renderers are only collected, their commands are already in the static tree
+			if (meshRenderer->isStatic)
+			{
+				currentStaticEntities.push_back(entity);
+				continue;
+			}
+			// We construct a command from it
+			RenderCommand command;
+			command.localToWorld = entity->getLocalToWorldMatrix();
+			command.center = glm::vec3(command.localToWorld * glm::vec4(0, 0, 0, 1));
+			command.mesh = meshRenderer->mesh;
+			command.material = meshRenderer->material;
+			visibilityCandidates.push_back(command);
+			// and we add the bounds of its mesh (transformed to the world space) to the culler
+			frustumCuller.add(command.mesh->getBounds(), command.localToWorld);
+		}
+
+		// Rebuild the static commands & their tree if the static entities changed since the last frame
+		// or if a streamed asset arrived (a placeholder mesh has empty bounds until its data is uploaded)
+		if (currentStaticEntities != staticEntities || staticAssetVersion != AssetStreamer::get().getVersion())
+			buildStaticTree(currentStaticEntities);
+
+		// if it is transparent, we add it to the transparent commands list, otherwise, we add it to the opaque command list
+		auto addCommand = [this](const RenderCommand &command)
+		{
+			if (command.material->transparent)
+				transparentCommands.push_back(command);
+			else
+				opaqueCommands.push_back(command);
+		};
+
+		// Test all the dynamic bounds against the camera frustum at once, and walk the static tree down to the visible leaves
+		if (frustumCulling)
+		{
+			Frustum frustum = Frustum::fromMatrix(VP);
+			visibleCount = frustumCuller.cull(frustum);
+			staticTree.cull(frustum, [&](uint32_t item)
+							{ addCommand(staticCommands[item]); visibleCount++; });
+		}
+		else
+		{
+			visibleCount = visibilityCandidates.size() + staticCommands.size();
+			for (const RenderCommand &command : staticCommands)
+				addCommand(command);
+		}
+		culledCount = visibilityCandidates.size() + staticCommands.size() - visibleCount;
+
+		for (size_t index = 0; index < visibilityCandidates.size(); index++)
+		{
+			// Skip the commands whose meshes are completely outside the frustum
+			if (frustumCulling && !frustumCuller.isVisible(index))
+				continue;
+			addCommand(visibilityCandidates[index]);
+		}
+
+		// Build the sort keys of the opaque commands and sort them, so that the commands that share a pipeline state, a shader or a material
+		// are drawn one after the other (front to back inside every group)
+		glm::mat4 view = camera->getViewMatrix();
+		glm::vec4 viewDepth = -glm::vec4(view[0][2], view[1][2], view[2][2], view[3][2]) / camera->far;
+		sortKeyBuilder.beginFrame();
+		opaqueOrder.resize(opaqueCommands.size());
+		for (size_t index = 0; index < opaqueCommands.size(); index++)
+		{
+			const RenderCommand &command = opaqueCommands[index];
+			float depth = glm::dot(viewDepth, glm::vec4(command.center, 1.0f));
+			opaqueOrder[index] = {sortKeyBuilder.build(command.material, command.mesh, depth), (uint32_t)index};
+		}
+		radixSort(opaqueOrder, sortScratch);
+
 		// TODO: (Req 9) Modify the following line such that "cameraForward" contains a vector pointing the camera forward direction
 		// HINT: See how you wrote the CameraComponent::getViewMatrix, it should help you solve this one
 
@@ -213,9 +428,55 @@ namespace our
                 return true;
             return false; });
 
-		// TODO: (Req 9) Get the camera ViewProjection matrix and store it in VP
-		// Multiply the camera projection matrix after passing the window size with the view matrix
-		glm::mat4 VP = camera->getProjectionMatrix(windowSize) * camera->getViewMatrix();
+		// Group the runs of commands that share the mesh & the material into instanced batches
+		// The transparent commands keep their back to front order, so only the neighbouring commands can be batched together
+		// (the instances of a draw call are drawn in order, so the blending result does not change)
+		// The opaque runs that share a material & whose meshes are in the mesh arena become indirect batches
+		instanceData.clear();
+		indirectCommands.clear();
+		buildBatches(opaqueCommands, opaqueOrder, opaqueBatches, true);
+		transparentOrder.resize(transparentCommands.size());
+		for (size_t index = 0; index < transparentCommands.size(); index++)
+			transparentOrder[index] = {0, (uint32_t)index};
+		buildBatches(transparentCommands, transparentOrder, transparentBatches, false);
+		// The matrices of all the instances are written to the frame ring at once
+		instanceSource = frameRing.getBuffer();
+		instanceBase = 0;
+		if (!instanceData.empty())
+		{
+			GLsizeiptr bytes = instanceData.size() * sizeof(glm::mat4);
+			if (FrameAllocation allocation = frameRing.upload(instanceData.data(), bytes, sizeof(glm::vec4)))
+			{
+				instanceBase = allocation.offset;
+			}
+			else
+			{
+				// The ring is full in this frame, so the matrices are uploaded to a buffer of their own
+				instanceSource = instanceBuffer;
+				glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+				glBufferData(GL_ARRAY_BUFFER, bytes, instanceData.data(), GL_STREAM_DRAW);
+				glBindBuffer(GL_ARRAY_BUFFER, 0);
+			}
+		}
+		// So are the indirect commands, unless the driver has no multi draws (then they are drawn one by one from "indirectCommands")
+		indirectSource = 0;
+		indirectBase = 0;
+		if (!indirectCommands.empty() && MeshArena::supportsMultiDrawIndirect())
+		{
+			GLsizeiptr bytes = indirectCommands.size() * sizeof(DrawElementsIndirectCommand);
+			if (FrameAllocation allocation = frameRing.upload(indirectCommands.data(), bytes, sizeof(GLuint)))
+			{
+				indirectSource = frameRing.getBuffer();
+				indirectBase = allocation.offset;
+			}
+			else
+			{
+				indirectSource = indirectBuffer;
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirectBuffer);
+				glBufferData(GL_DRAW_INDIRECT_BUFFER, bytes, indirectCommands.data(), GL_STREAM_DRAW);
+				glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+			}
+		}
 
 		// TODO: (Req 9) Set the OpenGL viewport using viewportStart and viewportSize
 		// Use the OpenGL glViewport & pass 0,0 as out starting x & y then extract the total length of x & y from
@@ -227,10 +488,11 @@ namespace our
 		glClearDepth(1.0);
 
 		// TODO: (Req 9) Set the color mask to true and the depth mask to true (to ensure the glClear will affect the framebuffer)
-		glColorMask(true, true, true, true);
-		glDepthMask(true);
-		// If there is a postprocess material, bind the framebuffer
-		if (postprocessMaterial && (this->crashingEffect || this->boostingEffect) )
+		GLStateCache::get().setColorMask(true, true, true, true);
+		GLStateCache::get().setDepthMask(true);
+		// If there is a postprocess material and an active effect, bind the framebuffer
+		ShaderProgram *activeEffectShader = postprocessMaterial ? postprocessEffects.get(this->activeEffect) : nullptr;
+		if (activeEffectShader)
 		{
 			// TODO: (Req 11) bind the framebuffer
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, postprocessFrameBuffer);
@@ -240,58 +502,104 @@ namespace our
 		// Use glClear to clear both bits
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		int numLights = lights.size();
-
-		// TODO: (Req 9) Draw all the opaque commands
-		// Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-		// Loop over all opaque commands & apply the following steps
-		for (auto opaqueCommand : opaqueCommands)
+		// Upload all the lights once for this frame, every lit draw will read them from the shared uniform buffer
+		uploadLights(camera);
+		// All the data of this frame is in the ring, so it is unmapped before the draws read it
+		frameRing.flush();
+
+		// Sets up the given material (with its instanced shader if "instanced" is true) and counts the material & shader switches
+		// The uniforms that are the same for all the commands (VP & eye) are only sent when a lit or an instanced material is set up
+		// Returns whether the material is lit
+		statistics = RenderStatistics();
+		ShaderProgram *currentShader = nullptr;
+		auto setupMaterial = [&](const Material *material, bool instanced = false)
 		{
-			// Setup the material of each opaque command
-			opaqueCommand.material->setup();
-
-			if (auto lightMaterial = dynamic_cast<LightMaterial *>(opaqueCommand.material); lightMaterial)
+			material->setup(instanced);
+			statistics.materialSwitches++;
+			ShaderProgram *shader = material->getShader(instanced);
+			if (shader != currentShader)
 			{
-				opaqueCommand.material->shader->set("VP", VP);
-				opaqueCommand.material->shader->set("eye", glm::vec3(cameraForward.x, cameraForward.y, cameraForward.z));
-				opaqueCommand.material->shader->set("light_count", numLights);
-				opaqueCommand.material->shader->set("M", opaqueCommand.localToWorld);
-				opaqueCommand.material->shader->set("M_IT", glm::transpose(glm::inverse(opaqueCommand.localToWorld)));
-
-				opaqueCommand.material->shader->set("sky.top", glm::vec3(0.0f, 0.1f, 0.5f));
-				opaqueCommand.material->shader->set("sky.horizon", glm::vec3(0.3f, 0.3f, 0.3f));
-				opaqueCommand.material->shader->set("sky.bottom", glm::vec3(0.1f, 0.1f, 0.1f));
-
-				for (int i = 0; i < numLights; i++)
-				{
-					std::string prefix = "lights[" + std::to_string(i) + "].";
-					glm::vec3 position = lights[i]->getOwner()->getLocalToWorldMatrix() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-					glm::vec3 direction = lights[i]->getOwner()->getLocalToWorldMatrix() * glm::vec4(lights[i]->direction, 0.0f);
-					opaqueCommand.material->shader->set(prefix + "position", glm::vec3(position.x, position.y, position.z));
-					opaqueCommand.material->shader->set(prefix + "direction", glm::normalize(glm::vec3(direction.x, direction.y, direction.z)));
-					opaqueCommand.material->shader->set(prefix + "type", (int)lights[i]->type);
-
-					opaqueCommand.material->shader->set(prefix + "diffuse", lights[i]->diffuse);
-					opaqueCommand.material->shader->set(prefix + "specular", lights[i]->specular);
-					opaqueCommand.material->shader->set(prefix + "attenuation", lights[i]->attenuation);
-					opaqueCommand.material->shader->set(prefix + "cone_angles", lights[i]->cone_angles);
-				}
+				statistics.shaderSwitches++;
+				currentShader = shader;
+			}
+			bool lit = dynamic_cast<const LightMaterial *>(material) != nullptr;
+			if (lit || instanced)
+				shader->set("VP", VP);
+			if (lit)
+				shader->set("eye", glm::vec3(cameraForward.x, cameraForward.y, cameraForward.z));
+			return lit;
+		};
+
+		// Draws a batch whose material is already set up
+		// An instanced batch is drawn by a single draw call (its matrices are already in the instance buffer), the other batches hold a single command
+		auto drawBatch = [&](const std::vector<RenderCommand> &commands, const std::vector<SortItem> &order, const DrawBatch &batch, bool lit)
+		{
+			const RenderCommand &command = commands[order[batch.first].index];
+			if (batch.indirect)
+			{
+				size_t drawCalls = command.mesh->getArena()->drawIndirect(&indirectCommands[batch.indirectFirst], (GLsizei)batch.indirectCount,
+					indirectSource, indirectBase + batch.indirectFirst * sizeof(DrawElementsIndirectCommand),
+					instanceSource, instanceBase + batch.instanceOffset, lit);
+				statistics.drawCalls += drawCalls;
+				statistics.instancedDrawCalls += drawCalls;
+				statistics.instances += batch.count;
+				statistics.indirectBatches++;
+				statistics.indirectCommands += batch.indirectCount;
+				return;
+			}
+			if (batch.instanced)
+			{
+				command.mesh->drawInstanced(instanceSource, instanceBase + batch.instanceOffset, (GLsizei)batch.count, lit);
+				statistics.drawCalls++;
+				statistics.instancedDrawCalls++;
+				statistics.instances += batch.count;
+				return;
+			}
+			if (lit)
+			{
+				command.material->shader->set("M", command.localToWorld);
+				command.material->shader->set("M_IT", glm::transpose(glm::inverse(command.localToWorld)));
 			}
 			else
 			{
 				// Set the "transform" uniform as the VP matrix we obtained above & transform it to world space
-				opaqueCommand.material->shader->set("transform", VP * opaqueCommand.localToWorld);
+				command.material->shader->set("transform", VP * command.localToWorld);
 			}
-
 			// Draw Mesh
-			opaqueCommand.mesh->draw();
+			command.mesh->draw();
+			statistics.drawCalls++;
+		};
+
+		// TODO: (Req 9) Draw all the opaque commands
+		// Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
+		// The batches are visited in the order of the sort keys, the material is only set up when the material bits of the key change
+		// (or when switching between the instanced & the regular shader), the following batches that share the material only draw.
+		// If the numbers in the keys wrapped this frame, two materials can have the same bits, so the material pointers are compared instead.
+		uint64_t currentMaterialKey = 0;
+		const Material *currentMaterial = nullptr;
+		bool hasMaterial = false, currentInstanced = false, lit = false;
+		bool exactKeys = !sortKeyBuilder.hasAliasedIds();
+		for (const DrawBatch &batch : opaqueBatches)
+		{
+			const SortItem &item = opaqueOrder[batch.first];
+			const Material *material = opaqueCommands[item.index].material;
+			bool sameMaterial = exactKeys ? (item.key & sort_key::MATERIAL_MASK) == currentMaterialKey : material == currentMaterial;
+			if (!hasMaterial || !sameMaterial || batch.instanced != currentInstanced)
+			{
+				lit = setupMaterial(material, batch.instanced);
+				currentMaterialKey = item.key & sort_key::MATERIAL_MASK;
+				currentMaterial = material;
+				currentInstanced = batch.instanced;
+				hasMaterial = true;
+			}
+			drawBatch(opaqueCommands, opaqueOrder, batch, lit);
 		}
 
 		// If there is a sky material, draw the sky
 		if (this->skyMaterial)
 		{
 			// TODO: (Req 10) setup the sky material
-			skyMaterial->setup();
+			setupMaterial(skyMaterial);
 
 			// TODO: (Req 10) Get the camera position
 			// Getting the Model Matrix to transform from local coordinates to world coordinates
@@ -331,99 +639,49 @@ namespace our
 
 			// TODO: (Req 10) draw the sky sphere
 			skySphere->draw();
+			statistics.drawCalls++;
 		}
 
 		// TODO: (Req 9) Draw all the transparent commands
 		// Don't forget to set the "transform" uniform to be equal the model-view-projection matrix for each render command
-		// Loop over all transparent commands
-		for (auto transparentCommand : transparentCommands)
+		// Loop over all transparent batches (they must stay sorted back to front, so the material is only set up again when it differs from the previous one)
+		currentMaterial = nullptr;
+		for (const DrawBatch &batch : transparentBatches)
 		{
+			const RenderCommand &transparentCommand = transparentCommands[transparentOrder[batch.first].index];
 			// Call the setup function in the material of each transparent command
-			transparentCommand.material->setup();
-
-			if (auto lightMaterial = dynamic_cast<LightMaterial *>(transparentCommand.material); lightMaterial)
-			{
-				transparentCommand.material->shader->set("VP", VP);
-				transparentCommand.material->shader->set("eye", glm::vec3(cameraForward.x, cameraForward.y, cameraForward.z));
-				transparentCommand.material->shader->set("light_count", numLights);
-				transparentCommand.material->shader->set("M", transparentCommand.localToWorld);
-				transparentCommand.material->shader->set("M_IT", glm::transpose(glm::inverse(transparentCommand.localToWorld)));
-
-				transparentCommand.material->shader->set("sky.top", glm::vec3(0.0f, 0.1f, 0.5f));
-				transparentCommand.material->shader->set("sky.horizon", glm::vec3(0.3f, 0.3f, 0.3f));
-				transparentCommand.material->shader->set("sky.bottom", glm::vec3(0.1f, 0.1f, 0.1f));
-
-				for (int i = 0; i < numLights; i++)
-				{
-					std::string prefix = "lights[" + std::to_string(i) + "].";
-					glm::vec3 position = lights[i]->getOwner()->getLocalToWorldMatrix() * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
-					glm::vec3 direction = lights[i]->getOwner()->getLocalToWorldMatrix() * glm::vec4(lights[i]->direction, 0.0f);
-					transparentCommand.material->shader->set(prefix + "position", glm::vec3(position.x, position.y, position.z));
-					transparentCommand.material->shader->set(prefix + "direction", glm::normalize(glm::vec3(direction.x, direction.y, direction.z)));
-					transparentCommand.material->shader->set(prefix + "type", (int)lights[i]->type);
-
-					transparentCommand.material->shader->set(prefix + "diffuse", lights[i]->diffuse);
-					transparentCommand.material->shader->set(prefix + "specular", lights[i]->specular);
-					transparentCommand.material->shader->set(prefix + "attenuation", lights[i]->attenuation);
-					transparentCommand.material->shader->set(prefix + "cone_angles", lights[i]->cone_angles);
-				}
-			}
-			else
+			if (transparentCommand.material != currentMaterial || batch.instanced != currentInstanced)
 			{
-				// Set the "transform" uniform from the shader as the VP matrix in the world space
-				transparentCommand.material->shader->set("transform", VP * transparentCommand.localToWorld);
+				lit = setupMaterial(transparentCommand.material, batch.instanced);
+				currentMaterial = transparentCommand.material;
+				currentInstanced = batch.instanced;
 			}
-			// Draw Mesh
-			transparentCommand.mesh->draw();
+			drawBatch(transparentCommands, transparentOrder, batch, lit);
 		}
 
-		// If there is a postprocess material, apply postprocessing
-		if (this->crashingEffect && postprocessMaterial)
+		// If there is an active postprocess effect, apply postprocessing
+		if (activeEffectShader)
 		{
-
-            ShaderProgram *postprocessShader = new ShaderProgram();
-            postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-            postprocessShader->attach(this->crashingPath, GL_FRAGMENT_SHADER);
-            postprocessShader->link();
-
-            postprocessMaterial->shader=postprocessShader;
+			// Switch to the precompiled program of the active effect (no compilation or linking happens here)
+			postprocessMaterial->shader = activeEffectShader;
 			// TODO: (Req 11) Return to the default framebuffer
 			// Bind Frame buffer as default (0) using glBindFramebuffer openGL function
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 			// TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
 			// Bind the Vertex Array
-			glBindVertexArray(postProcessVertexArray);
+			GLStateCache::get().bindVertexArray(postProcessVertexArray);
 			// Setup the post process material
-			postprocessMaterial->setup();
+			setupMaterial(postprocessMaterial);
 			// Drawing the new triangles after postProcessing of the image
 			// By setting the mode as GL_TRIANGLES
 			// The first argument to 0 since we want to start from the beginning
 			// The count is set to 3
 			glDrawArrays(GL_TRIANGLES, 0, 3);
+			statistics.drawCalls++;
 		}
 
-        if(this->boostPath!="" && this->boostingEffect && postprocessMaterial){
-                
-                // Create the post processing shader
-                ShaderProgram *postprocessShader = new ShaderProgram();
-                postprocessShader->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
-                postprocessShader->attach(this->boostPath, GL_FRAGMENT_SHADER);
-                postprocessShader->link();
-
-                postprocessMaterial->shader=postprocessShader;
-                // TODO: (Req 11) Return to the default framebuffer
-                // Bind Frame buffer as default (0) using glBindFramebuffer openGL function
-                glBindFramebuffer(GL_DRAW_FRAMEBUFFER,0);
-                // TODO: (Req 11) Setup the postprocess material and draw the fullscreen triangle
-                // Bind the Vertex Array
-                glBindVertexArray(postProcessVertexArray);
-                // Setup the post process material
-                postprocessMaterial->setup();
-                // Drawing the new triangles after postProcessing of the image
-                // By setting the mode as GL_TRIANGLES
-                // The first argument to 0 since we want to start from the beginning
-                // The count is set to 3
-                glDrawArrays(GL_TRIANGLES, 0, 3);
-        }
+		// Fence the draws of this frame so that its region of the ring is not written again before the GPU is done with it
+		frameRing.endFrame();
+		statistics.streamedBytes = frameRing.getLastFrameBytes();
 	}
 }
\ No newline at end of file
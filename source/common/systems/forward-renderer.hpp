@@ -5,6 +5,13 @@
 #include "../components/mesh-renderer.hpp"
 #include "../components/light.hpp"
 #include "../asset-loader.hpp"
+#include "postprocess-effects.hpp"
+#include "light-clusters.hpp"
+#include "frustum-culling.hpp"
+#include "bvh.hpp"
+#include "render-sort.hpp"
+#include "../frame-buffer-ring.hpp"
+#include "../asset-streamer.hpp"
 
 #include <glad/gl.h>
 #include <vector>
@@ -25,6 +32,45 @@ namespace our
         Material* material;
     };
 
+    // The number of state changes & draw calls the renderer made in the last frame
+    struct RenderStatistics {
+        size_t drawCalls = 0;
+        size_t shaderSwitches = 0;   // How many times the renderer changed the shader program
+        size_t materialSwitches = 0; // How many times the renderer called "Material::setup"
+        size_t instancedDrawCalls = 0; // How many of the draw calls were instanced
+        size_t instances = 0;        // How many objects were drawn by the instanced draw calls
+        size_t indirectBatches = 0;  // How many batches were submitted from indirect commands (a multi draw each, or a loop of draws without it)
+        size_t indirectCommands = 0; // How many indirect commands (one per mesh of a batch) these batches had
+        size_t streamedBytes = 0;    // How many bytes were written to the frame buffer ring
+    };
+
+    // A batch is a run of consecutive commands (in the order they are drawn) that share the mesh & the material.
+    // If the material has an instanced shader, the whole batch is drawn by a single instanced draw call,
+    // otherwise every command is a batch of its own (count = 1).
+    // An indirect batch is a run of opaque commands that share the material (with any meshes of the mesh arena): every mesh of the run
+    // is an indirect command whose instances are the commands that use it, and the whole batch is submitted by one multi draw.
+    struct DrawBatch {
+        uint32_t first, count;  // The position of the first command in the drawing order and the number of commands
+        bool instanced;
+        size_t instanceOffset;  // Where the matrices of the instances start in the instance buffer (in bytes)
+        bool indirect = false;
+        uint32_t indirectFirst = 0, indirectCount = 0; // The indirect commands of the batch in "ForwardRenderer::indirectCommands"
+    };
+
+    // This struct mirrors the std140 layout of the "Lights" uniform block in "assets/shaders/lighted.frag".
+    // In std140, a vec3 is aligned to 16 bytes so a following scalar can share its slot, otherwise we add explicit padding.
+    // The lights themselves are not in the block, they are stored in buffer textures by "LightClusters".
+    struct LightBlock {
+        glm::vec3 skyTop; float padding0;
+        glm::vec3 skyHorizon; float padding1;
+        glm::vec3 skyBottom; float padding2;
+        GLint lightCount; GLint globalLightCount; glm::vec2 viewportSize;
+        glm::ivec4 clusterCount;
+        glm::vec4 clusterDepth;
+        glm::vec4 viewDepth;
+    };
+    static_assert(sizeof(LightBlock) == 112, "LightBlock must match the std140 layout of the Lights block");
+
     // A forward renderer is a renderer that draw the object final color directly to the framebuffer
     // In other words, the fragment shader in the material should output the color that we should see on the screen
     // This is different from more complex renderers that could draw intermediate data to a framebuffer before computing the final color
@@ -36,20 +82,64 @@ namespace our
         // We define them here (instead of being local to the "render" function) as an optimization to prevent reallocating them every frame
         std::vector<RenderCommand> opaqueCommands;
         std::vector<RenderCommand> transparentCommands;
+        // The opaque commands are drawn in the order of their sort keys (see "render-sort.hpp") so that the commands sharing a material are drawn together
+        SortKeyBuilder sortKeyBuilder;
+        std::vector<SortItem> opaqueOrder, sortScratch;
+        RenderStatistics statistics;
+        // The batches of the opaque & the transparent commands and the per instance matrices of all the instanced batches,
+        // which are uploaded to "instanceBuffer" once per frame
+        bool instancing = true;
+        int minInstances = 2;
+        std::vector<SortItem> transparentOrder;
+        std::vector<DrawBatch> opaqueBatches, transparentBatches;
+        std::vector<glm::mat4> instanceData;
+        GLuint instanceBuffer = 0;
+        // The per frame data (the instance matrices & the light block) is streamed through this ring
+        // The buffers above are only used in the frames whose data does not fit in the ring (the ring grows for the next frames)
+        FrameBufferRing frameRing;
+        GLint uniformAlignment = 256;
+        // Where the instance matrices of this frame are (the ring buffer or "instanceBuffer") and their offset in it
+        GLuint instanceSource = 0;
+        GLintptr instanceBase = 0;
+        // The indirect commands of the indirect batches of this frame. If the driver supports multi draws, they are streamed through the ring
+        // (or uploaded to "indirectBuffer" if they don't fit) and "indirectSource" & "indirectBase" tell where they are, otherwise
+        // "indirectSource" is 0 and the commands are drawn one by one from this vector (see "MeshArena::drawIndirect")
+        bool multiDrawIndirect = true;
+        std::vector<DrawElementsIndirectCommand> indirectCommands;
+        GLuint indirectBuffer = 0, indirectSource = 0;
+        GLintptr indirectBase = 0;
 
 		std::vector<LightComponent*> lights;
+        // Every frame, the bounds of the meshes are tested against the camera frustum and only the visible ones become commands
+        // The commands are built in "visibilityCandidates" first, then the visible ones are moved to the opaque & transparent lists
+        bool frustumCulling = true;
+        FrustumCuller frustumCuller;
+        std::vector<RenderCommand> visibilityCandidates;
+        size_t visibleCount = 0, culledCount = 0;
+        // The commands of the static mesh renderers are built once and culled through a bounding volume hierarchy,
+        // so the static part of the scene costs a walk down the tree instead of a test per mesh. They are only rebuilt
+        // when the list of static entities changes (e.g. a new level was loaded) or when a streamed mesh arrives (its bounds changed)
+        std::vector<RenderCommand> staticCommands;
+        std::vector<Entity*> staticEntities, currentStaticEntities;
+        BVH staticTree;
+        size_t staticAssetVersion = 0; // The version of the asset streamer when the static tree was built
+        // Every frame, the lights are assigned to the clusters of the camera frustum and uploaded to buffer textures
+        LightClusters lightClusters;
+        // The light block is filled once per frame and uploaded to this uniform buffer
+        // which is bound to UNIFORM_BLOCK_LIGHTS_BINDING, so the lit draws don't send any light uniforms
+        LightBlock lightBlock;
+        GLuint lightUniformBuffer = 0;
         // Objects used for rendering a skybox
-        Mesh* skySphere;
-        TexturedMaterial* skyMaterial;
+        Mesh* skySphere = nullptr;
+        TexturedMaterial* skyMaterial = nullptr;
         // Objects used for Postprocessing
         GLuint postprocessFrameBuffer, postProcessVertexArray;
         Texture2D *colorTarget, *depthTarget;
-        TexturedMaterial* postprocessMaterial,*postprocessMaterial2;
-        bool crashingEffect=false;
-        bool boostingEffect=false;
-
-        std::string crashingPath;
-        std::string boostPath="";
+        TexturedMaterial* postprocessMaterial = nullptr;
+        // All the postprocess effects are compiled once in "initialize" and stored here by name
+        PostprocessEffectRegistry postprocessEffects;
+        // The name of the effect that is currently applied (empty if no effect should be applied)
+        std::string activeEffect;
     public:
         // Initialize the renderer including the sky and the Postprocessing objects.
         // windowSize is the width & height of the window (in pixels).
@@ -58,34 +148,62 @@ namespace our
         void destroy();
         // This function should be called every frame to draw the given world
         void render(World* world);
+        // Assigns the collected lights to the clusters of the given camera then uploads them with the light block
+        void uploadLights(CameraComponent* camera);
+        // Builds the commands of the given static entities and the hierarchy of their bounds
+        void buildStaticTree(const std::vector<Entity*>& entities);
+        // Splits the commands (visited in the given order) into draw batches and appends the matrices of the instanced batches to "instanceData"
+        // If "allowIndirect" is true, the runs that share a material whose meshes are in the mesh arena become indirect batches
+        void buildBatches(const std::vector<RenderCommand>& commands, const std::vector<SortItem>& order, std::vector<DrawBatch>& batches, bool allowIndirect);
 
-        void applyEffect(std::string type){
-        
-            if(type=="battery"){
-                this->boostingEffect=true;
-            }
-            if(type=="obstacle"){
-                this->crashingEffect=true;
+        // Enables or disables the instanced draw calls (e.g. to compare the performance with & without them)
+        void setInstancing(bool enabled) { instancing = enabled; }
+        bool getInstancing() const { return instancing; }
+        // Enables or disables the indirect batches (they also need the instancing, since they are drawn with the instanced shaders)
+        void setMultiDrawIndirect(bool enabled) { multiDrawIndirect = enabled; }
+        bool getMultiDrawIndirect() const { return multiDrawIndirect; }
+
+        // Starts applying the postprocess effect with the given name (e.g. "battery" or "obstacle")
+        // Since all the effects are precompiled, this only changes which program will be used in the next frames
+        void applyEffect(const std::string& type){
+            if(postprocessEffects.get(type)){
+                this->activeEffect = type;
             }
         };
 
-        void ignoreEffect(std::string type){
-            if(type=="battery"){
-                this->boostingEffect=false;
-            }
-            if(type=="obstacle"){
-                this->crashingEffect=false;
+        // Stops applying the postprocess effect with the given name (if it is the one being applied)
+        void ignoreEffect(const std::string& type){
+            if(this->activeEffect == type){
+                this->activeEffect.clear();
             }
         };
 
-        bool getEffect(std::string type){
-            if(type=="battery"){
-                return  this->boostingEffect;
-            }
-            else{
-                return this->crashingEffect;
-            }
+        // Returns whether the postprocess effect with the given name is currently applied
+        bool getEffect(const std::string& type) const {
+            return !this->activeEffect.empty() && this->activeEffect == type;
         };
+
+        // Returns the number of compiled postprocess programs held by the renderer
+        size_t getPostprocessProgramCount() const {
+            return postprocessEffects.size();
+        }
+
+        // Returns the number of mesh renderers that were drawn & that were culled in the last frame
+        size_t getVisibleCount() const { return visibleCount; }
+        size_t getCulledCount() const { return culledCount; }
+        // Returns the hierarchy of the static mesh renderers (its items are in the order of the static entities)
+        const BVH& getStaticTree() const { return staticTree; }
+
+        // Returns the number of draw calls, shader switches & material switches of the last frame
+        const RenderStatistics& getStatistics() const { return statistics; }
+
+        // Returns the ring that streams the per frame data (other systems can allocate from it between the start of "render" and the first draw)
+        FrameBufferRing& getFrameRing() { return frameRing; }
+
+        // Returns the light clusters (e.g. to read the statistics of the last light assignment)
+        const LightClusters& getLightClusters() const {
+            return lightClusters;
+        }
     };
 
 }
\ No newline at end of file
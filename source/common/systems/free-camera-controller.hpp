@@ -53,9 +53,9 @@ namespace our
                 mouse_locked = false;
             }
 
-            // We get a reference to the entity's position and rotation
-            glm::vec3& position = entity->localTransform.position;
-            glm::vec3& rotation = entity->localTransform.rotation;
+            // We get a copy of the entity's position and rotation (they are set back through the transform setters once changed)
+            glm::vec3 position = entity->localTransform.getPosition();
+            glm::vec3 rotation = entity->localTransform.getRotation();
 
             // If the left mouse button is pressed, we get the change in the mouse location
             // and use it to update the camera rotation
@@ -71,6 +71,7 @@ namespace our
             // This is not necessary, but whenever the rotation goes outside the 0 to 2*PI range, we wrap it back inside.
             // This could prevent floating point error if the player rotates in single direction for an extremely long time. 
             rotation.y = glm::wrapAngle(rotation.y);
+            if(rotation != entity->localTransform.getRotation()) entity->localTransform.setRotation(rotation);
 
             // We update the camera fov based on the mouse wheel scrolling amount
             float fov = camera->fovY + app->getMouse().getScrollOffset().y * controller->fovSensitivity;
@@ -78,7 +79,7 @@ namespace our
             camera->fovY = fov;
 
             // We get the camera model matrix (relative to its parent) to compute the front, up and right directions
-            glm::mat4 matrix = entity->localTransform.toMat4();
+            const glm::mat4& matrix = entity->localTransform.getMatrix();
 
             glm::vec3 front = glm::vec3(matrix * glm::vec4(0, 0, -1, 0)),
                       up = glm::vec3(matrix * glm::vec4(0, 1, 0, 0)), 
@@ -103,6 +104,9 @@ namespace our
             if(app->getKeyboard().isPressed(GLFW_KEY_A)) {
                 position -= right * (deltaTime * current_sensitivity.x);
             }
+
+            // Only mark the transform dirty if the camera actually moved
+            if(position != entity->localTransform.getPosition()) entity->localTransform.setPosition(position);
         }
 
         // When the state exits, it should call this function to ensure the mouse is unlocked
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "../bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace our {
+
+    // The 6 planes of a camera frustum in the world space. Every plane is stored as (normal, distance) such that
+    // a point p is inside the half space of the plane if dot(normal, p) + distance >= 0.
+    struct Frustum {
+        glm::vec4 planes[6];
+
+        // Extracts the planes from a view projection matrix (the Gribb & Hartmann method).
+        // Since the matrix maps the frustum to the clip cube -w <= x, y, z <= w, every plane is the sum or the difference of two rows.
+        static Frustum fromMatrix(const glm::mat4& VP) {
+            // glm matrices are column major, so we build the rows first
+            glm::vec4 rows[4];
+            for(int row = 0; row < 4; row++) rows[row] = glm::vec4(VP[0][row], VP[1][row], VP[2][row], VP[3][row]);
+            Frustum frustum;
+            frustum.planes[0] = rows[3] + rows[0]; // Left
+            frustum.planes[1] = rows[3] - rows[0]; // Right
+            frustum.planes[2] = rows[3] + rows[1]; // Bottom
+            frustum.planes[3] = rows[3] - rows[1]; // Top
+            frustum.planes[4] = rows[3] + rows[2]; // Near
+            frustum.planes[5] = rows[3] - rows[2]; // Far
+            // Normalize the planes so that the distances are in world units
+            for(auto& plane : frustum.planes){
+                float length = glm::length(glm::vec3(plane));
+                if(length > 0.0f) plane /= length;
+            }
+            return frustum;
+        }
+    };
+
+    // This class tests many boxes against a frustum at once.
+    // The world space boxes are stored as a structure of arrays (centers & half extents) and tested in blocks of 8 boxes:
+    // for every plane, the inner loop over the 8 boxes has no branches and reads consecutive floats,
+    // so the compiler can turn it into SIMD instructions (SSE/AVX/NEON) without any platform specific code.
+    class FrustumCuller {
+    public:
+        static constexpr size_t BLOCK_SIZE = 8;
+    private:
+        std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+        std::vector<uint8_t> visible;
+        size_t count = 0;
+    public:
+        // Removes all the boxes
+        void clear() { count = 0; }
+
+        // Adds the given local box transformed by the given matrix and returns its index.
+        // The world box is the box that contains the transformed local box (its half extents are the absolute matrix times the local half extents).
+        size_t add(const AABB& localBounds, const glm::mat4& localToWorld) {
+            glm::vec3 localCenter = (localBounds.min + localBounds.max) * 0.5f;
+            glm::vec3 localExtent = (localBounds.max - localBounds.min) * 0.5f;
+            glm::vec3 center = glm::vec3(localToWorld * glm::vec4(localCenter, 1.0f));
+            glm::vec3 extent = glm::abs(glm::vec3(localToWorld[0])) * localExtent.x
+                             + glm::abs(glm::vec3(localToWorld[1])) * localExtent.y
+                             + glm::abs(glm::vec3(localToWorld[2])) * localExtent.z;
+
+            // The arrays always hold whole blocks, so the last block can be tested without checking the count
+            if(count + 1 > centerX.size()){
+                size_t capacity = (count / BLOCK_SIZE + 1) * BLOCK_SIZE;
+                for(auto array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ}) array->resize(capacity, 0.0f);
+                visible.resize(capacity, 0);
+            }
+            centerX[count] = center.x; centerY[count] = center.y; centerZ[count] = center.z;
+            extentX[count] = extent.x; extentY[count] = extent.y; extentZ[count] = extent.z;
+            return count++;
+        }
+
+        // Tests all the boxes against the frustum. A box is visible unless it is fully outside one of the planes
+        // (this is conservative: a few boxes near the frustum corners are kept even if they are outside).
+        // Returns the number of visible boxes.
+        size_t cull(const Frustum& frustum) {
+            size_t visibleCount = 0;
+            for(size_t block = 0; block < count; block += BLOCK_SIZE){
+                // For every box, the smallest (signed distance + projected radius) over all the planes. A negative value means that
+                // the box is fully outside at least one plane. Keeping a float minimum (instead of a boolean) keeps the loop in float lanes.
+                float margin[BLOCK_SIZE];
+                for(size_t i = 0; i < BLOCK_SIZE; i++) margin[i] = std::numeric_limits<float>::max();
+                const float *cx = &centerX[block], *cy = &centerY[block], *cz = &centerZ[block];
+                const float *ex = &extentX[block], *ey = &extentY[block], *ez = &extentZ[block];
+                for(const auto& plane : frustum.planes){
+                    glm::vec3 absNormal = glm::abs(glm::vec3(plane));
+                    for(size_t i = 0; i < BLOCK_SIZE; i++){
+                        // The signed distance of the center and the projected radius of the box on the plane normal
+                        float distance = plane.x * cx[i] + plane.y * cy[i] + plane.z * cz[i] + plane.w;
+                        float radius = absNormal.x * ex[i] + absNormal.y * ey[i] + absNormal.z * ez[i];
+                        margin[i] = std::min(margin[i], distance + radius);
+                    }
+                }
+                for(size_t i = 0; i < BLOCK_SIZE; i++) visible[block + i] = margin[i] >= 0.0f;
+            }
+            for(size_t index = 0; index < count; index++) visibleCount += visible[index];
+            return visibleCount;
+        }
+
+        // Returns whether the box with the given index was visible in the last "cull"
+        bool isVisible(size_t index) const { return visible[index] != 0; }
+
+        // Returns the number of boxes
+        size_t size() const { return count; }
+    };
+
+}
@@ -16,13 +16,7 @@ namespace our
 		vector<glm::vec3> knifePoints;
 
         void getKnifeOnCar(World* world) {
-            // For each entity in the world
-            for(auto entity : world->getEntities()){
-                if(entity->name == "knife-on-car") {
-					knifeOnCar = entity;
-					break;
-                }
-            }
+            knifeOnCar = world->findByName("knife-on-car");
         }
 
         nlohmann::json generateKnife(glm::vec3 position, std::string name) {
@@ -40,6 +34,14 @@ namespace our
 					{
 						{"type", "Movement"},
 						{"angularVelocity", {0, 60, 0}}
+					},
+					{
+						// The knife is hidden (scaled to zero) until all the deliveries are done, and its collider is disabled meanwhile
+						{"type", "Collider"},
+						{"size", {0.2, 0.2, 0.2}},
+						{"layer", "knife"},
+						{"collidesWith", {"car"}},
+						{"trigger", true}
 					}
                 })}
             };
@@ -48,13 +50,7 @@ namespace our
         public:
             void initialize(World* world) {
                 // Get the random knife points from the world
-                Entity* KnifePoints;
-                for (auto entity : world->getEntities()){
-                    if(entity->name == "knives"){
-                        KnifePoints = entity;
-                        break;
-                    }
-                }
+                Entity* KnifePoints = world->findByName("knives");
 
                 // Get the list of poistion point components
                 auto positionComponents = KnifePoints->getComponents<PositionPointComponent>();
@@ -77,15 +73,15 @@ namespace our
             }
 
             void removeKnifeOnCar() {
-                knifeOnCar->localTransform.scale = glm::vec3(0, 0, 0);
+                knifeOnCar->localTransform.setScale(glm::vec3(0, 0, 0));
             }
 
             void addKnifeOnCar() {
-                knifeOnCar->localTransform.scale = glm::vec3(10, 10, 10);
+                knifeOnCar->localTransform.setScale(glm::vec3(10, 10, 10));
             }
 
             void showKnife() {
-                knife->localTransform.scale = glm::vec3(15, 15, 15);
+                knife->localTransform.setScale(glm::vec3(15, 15, 15));
             }
 
             void removeKnife(Entity* knife, World* world) {
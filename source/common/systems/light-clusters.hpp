@@ -0,0 +1,360 @@
+#pragma once
+
+#include "../components/light.hpp"
+#include "../ecs/entity.hpp"
+#include "../shader/shader.hpp"
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+#include <json/json.hpp>
+#include <vector>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+
+namespace our
+{
+
+    // The data of a single light as it is stored in the light buffer texture (5 RGBA32F texels per light)
+    // The layout must match "fetch_light" in "assets/shaders/lighted.frag"
+    struct PackedLight {
+        glm::vec4 positionType;     // xyz: world position, w: light type
+        glm::vec4 directionInner;   // xyz: world direction, w: inner cone angle
+        glm::vec4 diffuseOuter;     // xyz: diffuse color, w: outer cone angle
+        glm::vec4 specular;         // xyz: specular color
+        glm::vec4 attenuation;      // xyz: attenuation factors (quadratic, linear, constant)
+    };
+
+    // This class implements the light assignment of a clustered forward renderer.
+    // The camera frustum is split into a 3D grid of clusters (tiles on the screen and slices along the depth)
+    // and every frame, each light is added to the clusters that its sphere of influence touches.
+    // The lit shader then finds the cluster of the fragment and only shades the lights listed for it.
+    // Lights without a limited range (directional lights or lights without attenuation) are "global":
+    // they are stored first in the light list and every fragment shades them.
+    // The results are uploaded to 3 buffer textures (OpenGL 3.3 has no shader storage buffers):
+    //  - the lights (PackedLight, RGBA32F)
+    //  - the grid, which holds the (offset, count) of the light list of every cluster (RG32UI)
+    //  - the light indices referenced by the grid (R32UI)
+    class LightClusters {
+        // The light assignment is split between threads only when every thread gets at least this number of lights
+        static constexpr size_t LIGHTS_PER_THREAD = 64;
+        static constexpr size_t MAX_THREADS = 8;
+
+        // The number of clusters along x (screen), y (screen) and z (depth)
+        glm::ivec3 count = {16, 9, 24};
+        // A light stops affecting a cluster when its attenuated intensity drops below this value
+        float cutoff = 1.0f / 64.0f;
+
+        // The projection matrix the cluster bounds were computed for (they are only recomputed when it changes)
+        glm::mat4 cachedProjection = glm::mat4(0.0f);
+        bool cachedPerspective = false;
+        // The depth range covered by the clusters and whether the slices are distributed logarithmically
+        float nearDepth = 0.0f, farDepth = 1.0f;
+        bool logarithmic = false;
+        // The view space bounding box of every cluster
+        std::vector<glm::vec3> clusterMin, clusterMax;
+
+        // The per frame data
+        std::vector<PackedLight> packedLights;
+        int globalLightCount = 0;
+        std::vector<std::vector<glm::uvec2>> threadAssignments; // (cluster, light) pairs found by each thread before they are sorted by cluster
+        std::vector<glm::uvec2> grid;        // (offset, count) for every cluster
+        std::vector<GLuint> indices;         // the light lists of all the clusters one after the other
+
+        // Statistics of the last build
+        double buildTime = 0.0;
+
+        // The OpenGL objects: 0 = lights, 1 = grid, 2 = indices
+        GLuint buffers[3] = {0, 0, 0};
+        GLuint textures[3] = {0, 0, 0};
+
+        // Returns the distance at which the given light falls below the cutoff (negative if the light has no limited range)
+        float computeRadius(const LightComponent* light) const {
+            float intensity = std::max(glm::max(light->diffuse.x, glm::max(light->diffuse.y, light->diffuse.z)),
+                                       glm::max(light->specular.x, glm::max(light->specular.y, light->specular.z)));
+            // The shader computes the attenuation as 1 / (a*d^2 + b*d + c)
+            float a = light->attenuation.x, b = light->attenuation.y, c = light->attenuation.z;
+            float limit = intensity / cutoff;
+            if(c >= limit) return 0.0f;
+            if(a > 0.0f) return (-b + std::sqrt(b * b + 4.0f * a * (limit - c))) / (2.0f * a);
+            if(b > 0.0f) return (limit - c) / b;
+            return -1.0f;
+        }
+
+        // Returns the depth slice that contains the given view depth (not clamped)
+        int getSlice(float depth) const {
+            float slice;
+            if(logarithmic) slice = std::log(std::max(depth, nearDepth) / nearDepth) / std::log(farDepth / nearDepth) * count.z;
+            else slice = (depth - nearDepth) / (farDepth - nearDepth) * count.z;
+            return (int)std::floor(slice);
+        }
+
+        // Returns the view depth at which the given slice starts
+        float getSliceDepth(int slice) const {
+            float t = (float)slice / count.z;
+            if(logarithmic) return nearDepth * std::pow(farDepth / nearDepth, t);
+            return nearDepth + (farDepth - nearDepth) * t;
+        }
+
+        // Computes the view space bounds of every cluster for the given projection
+        void computeClusterBounds(const glm::mat4& projection, bool perspective) {
+            glm::mat4 inverseProjection = glm::inverse(projection);
+            auto unproject = [&](glm::vec3 ndc){
+                glm::vec4 point = inverseProjection * glm::vec4(ndc, 1.0f);
+                return glm::vec3(point) / point.w;
+            };
+            nearDepth = -unproject({0, 0, -1}).z;
+            farDepth = -unproject({0, 0, 1}).z;
+            logarithmic = perspective && nearDepth > 0.0f;
+
+            // For every tile corner, we find the line (in view space) that goes through it from the near to the far plane
+            int cornersX = count.x + 1, cornersY = count.y + 1;
+            std::vector<glm::vec3> nearCorners(cornersX * cornersY), farCorners(cornersX * cornersY);
+            for(int y = 0; y < cornersY; y++){
+                for(int x = 0; x < cornersX; x++){
+                    glm::vec2 ndc = glm::vec2((float)x / count.x, (float)y / count.y) * 2.0f - 1.0f;
+                    nearCorners[x + y * cornersX] = unproject({ndc, -1});
+                    farCorners[x + y * cornersX] = unproject({ndc, 1});
+                }
+            }
+
+            size_t clusterCount = (size_t)count.x * count.y * count.z;
+            clusterMin.resize(clusterCount);
+            clusterMax.resize(clusterCount);
+            for(int z = 0; z < count.z; z++){
+                float depths[2] = {getSliceDepth(z), getSliceDepth(z + 1)};
+                for(int y = 0; y < count.y; y++){
+                    for(int x = 0; x < count.x; x++){
+                        glm::vec3 minimum(INFINITY), maximum(-INFINITY);
+                        for(int corner = 0; corner < 4; corner++){
+                            int index = (x + (corner & 1)) + (y + (corner >> 1)) * cornersX;
+                            glm::vec3 nearCorner = nearCorners[index], farCorner = farCorners[index];
+                            for(float depth : depths){
+                                float t = (depth - nearDepth) / (farDepth - nearDepth);
+                                glm::vec3 point = glm::mix(nearCorner, farCorner, t);
+                                minimum = glm::min(minimum, point);
+                                maximum = glm::max(maximum, point);
+                            }
+                        }
+                        size_t cluster = x + count.x * (y + (size_t)count.y * z);
+                        clusterMin[cluster] = minimum;
+                        clusterMax[cluster] = maximum;
+                    }
+                }
+            }
+        }
+
+        // Appends a (cluster, light) pair for every cluster touched by the sphere with the given view space center and radius
+        void assignLight(glm::vec3 center, float radius, GLuint lightIndex, const glm::mat4& projection, std::vector<glm::uvec2>& output) const {
+            float depth = -center.z;
+            if(depth + radius < nearDepth || depth - radius > farDepth) return;
+            int firstSlice = std::max(getSlice(depth - radius), 0);
+            int lastSlice = std::min(getSlice(depth + radius), count.z - 1);
+
+            // Find the range of tiles covered by the projection of the bounding box of the light sphere
+            // If the box reaches behind the eye, its projection is unbounded so we consider all the tiles
+            glm::vec2 ndcMin(INFINITY), ndcMax(-INFINITY);
+            bool behindEye = false;
+            for(int corner = 0; corner < 8; corner++){
+                glm::vec3 offset = glm::vec3(corner & 1 ? 1 : -1, corner & 2 ? 1 : -1, corner & 4 ? 1 : -1) * radius;
+                glm::vec4 clip = projection * glm::vec4(center + offset, 1.0f);
+                if(clip.w <= 1e-5f) { behindEye = true; break; }
+                glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                ndcMin = glm::min(ndcMin, ndc);
+                ndcMax = glm::max(ndcMax, ndc);
+            }
+            glm::ivec2 firstTile(0), lastTile(count.x - 1, count.y - 1);
+            if(!behindEye){
+                if(ndcMin.x > 1.0f || ndcMin.y > 1.0f || ndcMax.x < -1.0f || ndcMax.y < -1.0f) return;
+                glm::vec2 tiles = glm::vec2(count.x, count.y);
+                firstTile = glm::max(glm::ivec2(glm::floor((ndcMin * 0.5f + 0.5f) * tiles)), firstTile);
+                lastTile = glm::min(glm::ivec2(glm::floor((ndcMax * 0.5f + 0.5f) * tiles)), lastTile);
+            }
+
+            // Then test the sphere against the bounds of each candidate cluster
+            float radiusSquared = radius * radius;
+            for(int z = firstSlice; z <= lastSlice; z++){
+                for(int y = firstTile.y; y <= lastTile.y; y++){
+                    for(int x = firstTile.x; x <= lastTile.x; x++){
+                        size_t cluster = x + count.x * (y + (size_t)count.y * z);
+                        glm::vec3 closest = glm::clamp(center, clusterMin[cluster], clusterMax[cluster]);
+                        glm::vec3 difference = closest - center;
+                        if(glm::dot(difference, difference) <= radiusSquared)
+                            output.push_back({(GLuint)cluster, lightIndex});
+                    }
+                }
+            }
+        }
+
+        // Creates (or recreates) the data store of the given buffer and fills it with the given data
+        static void uploadBuffer(GLuint buffer, const void* data, size_t size) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+            // A buffer texture needs a data store, so we never allocate an empty one
+            glBufferData(GL_TEXTURE_BUFFER, std::max(size, (size_t)16), nullptr, GL_STREAM_DRAW);
+            if(size > 0) glBufferSubData(GL_TEXTURE_BUFFER, 0, size, data);
+        }
+
+    public:
+        // Reads the clustering options from the renderer configuration:
+        //  "clusters": the number of clusters along x, y and z (default: [16, 9, 24])
+        //  "lightCutoff": the intensity below which a light is considered to have no effect (default: 1/64)
+        // then creates the buffers and the buffer textures
+        void initialize(const nlohmann::json& config) {
+            if(config.is_object()){
+                if(auto clusters = config.value("clusters", nlohmann::json::array()); clusters.is_array() && clusters.size() == 3){
+                    count = glm::max(glm::ivec3(clusters[0].get<int>(), clusters[1].get<int>(), clusters[2].get<int>()), glm::ivec3(1));
+                }
+                cutoff = std::max(config.value("lightCutoff", cutoff), 1e-6f);
+            }
+
+            glGenBuffers(3, buffers);
+            glGenTextures(3, textures);
+            GLenum formats[3] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+            for(int i = 0; i < 3; i++){
+                uploadBuffer(buffers[i], nullptr, 0);
+                glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+                glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+            }
+            glBindTexture(GL_TEXTURE_BUFFER, 0);
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+            cachedProjection = glm::mat4(0.0f);
+        }
+
+        // Deletes the buffers and the buffer textures
+        void destroy() {
+            glDeleteTextures(3, textures);
+            glDeleteBuffers(3, buffers);
+            for(int i = 0; i < 3; i++) textures[i] = buffers[i] = 0;
+        }
+
+        // Packs the given lights and assigns them to the clusters of the camera with the given view & projection matrices
+        void build(const std::vector<LightComponent*>& lights, const glm::mat4& view, const glm::mat4& projection, bool perspective) {
+            auto start = std::chrono::high_resolution_clock::now();
+
+            if(projection != cachedProjection || perspective != cachedPerspective){
+                computeClusterBounds(projection, perspective);
+                cachedProjection = projection;
+                cachedPerspective = perspective;
+            }
+
+            // Pack the lights such that the global lights come first, and remember the range of the others
+            struct LocalLight { glm::vec3 center; float radius; };
+            std::vector<LocalLight> localLights;
+            localLights.reserve(lights.size());
+            packedLights.clear();
+            packedLights.reserve(lights.size());
+            for(int pass = 0; pass < 2; pass++){
+                for(auto light : lights){
+                    float radius = light->type == LightType::DIRECTIONAL ? -1.0f : computeRadius(light);
+                    // A light that never exceeds the cutoff has no visible effect
+                    if(radius == 0.0f) continue;
+                    bool global = radius < 0.0f;
+                    if(global != (pass == 0)) continue;
+
+                    glm::mat4 localToWorld = light->getOwner()->getLocalToWorldMatrix();
+                    glm::vec3 position = glm::vec3(localToWorld * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+                    glm::vec3 direction = glm::vec3(localToWorld * glm::vec4(light->direction, 0.0f));
+                    if(glm::dot(direction, direction) > 0.0f) direction = glm::normalize(direction);
+
+                    PackedLight packed;
+                    packed.positionType = glm::vec4(position, (float)light->type);
+                    packed.directionInner = glm::vec4(direction, light->cone_angles.x);
+                    packed.diffuseOuter = glm::vec4(light->diffuse, light->cone_angles.y);
+                    packed.specular = glm::vec4(light->specular, 0.0f);
+                    packed.attenuation = glm::vec4(light->attenuation, 0.0f);
+                    packedLights.push_back(packed);
+
+                    if(!global) localLights.push_back({glm::vec3(view * glm::vec4(position, 1.0f)), radius});
+                }
+                if(pass == 0) globalLightCount = (int)packedLights.size();
+            }
+
+            // Find the clusters touched by every local light
+            // With many lights, they are split between a few threads and each thread writes its own (cluster, light) pairs
+            size_t threadCount = 1;
+            if(localLights.size() >= LIGHTS_PER_THREAD * 2)
+                threadCount = std::min<size_t>({std::max(1u, std::thread::hardware_concurrency()), MAX_THREADS, localLights.size() / LIGHTS_PER_THREAD});
+            threadAssignments.resize(threadCount);
+            auto assignRange = [&](size_t thread){
+                std::vector<glm::uvec2>& output = threadAssignments[thread];
+                output.clear();
+                size_t first = localLights.size() * thread / threadCount, last = localLights.size() * (thread + 1) / threadCount;
+                for(size_t index = first; index < last; index++)
+                    assignLight(localLights[index].center, localLights[index].radius, (GLuint)(globalLightCount + index), projection, output);
+            };
+            if(threadCount == 1){
+                assignRange(0);
+            } else {
+                std::vector<std::thread> threads;
+                for(size_t thread = 1; thread < threadCount; thread++) threads.emplace_back(assignRange, thread);
+                assignRange(0);
+                for(auto& thread : threads) thread.join();
+            }
+
+            // Sort the assignments by cluster (counting sort) to get a compact light list for every cluster
+            // Since the threads processed the lights in order, the light lists stay sorted by light index
+            grid.assign((size_t)count.x * count.y * count.z, glm::uvec2(0));
+            size_t assignmentCount = 0;
+            for(auto& assignments : threadAssignments){
+                for(auto& assignment : assignments) grid[assignment.x].y++;
+                assignmentCount += assignments.size();
+            }
+            GLuint offset = 0;
+            for(auto& cell : grid){
+                cell.x = offset;
+                offset += cell.y;
+                cell.y = 0;
+            }
+            indices.resize(assignmentCount);
+            for(auto& assignments : threadAssignments){
+                for(auto& assignment : assignments){
+                    glm::uvec2& cell = grid[assignment.x];
+                    indices[cell.x + cell.y++] = assignment.y;
+                }
+            }
+
+            auto end = std::chrono::high_resolution_clock::now();
+            buildTime = std::chrono::duration<double, std::milli>(end - start).count();
+        }
+
+        // Uploads the result of the last build and binds the buffer textures to their fixed texture units
+        void upload() {
+            uploadBuffer(buffers[0], packedLights.data(), packedLights.size() * sizeof(PackedLight));
+            uploadBuffer(buffers[1], grid.data(), grid.size() * sizeof(glm::uvec2));
+            uploadBuffer(buffers[2], indices.data(), indices.size() * sizeof(GLuint));
+            glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+            GLenum units[3] = {TEXTURE_UNIT_LIGHT_DATA, TEXTURE_UNIT_LIGHT_GRID, TEXTURE_UNIT_LIGHT_INDICES};
+            // The unit is selected through the state cache so that it keeps knowing which unit the materials bind their textures to
+            GLStateCache& state = GLStateCache::get();
+            for(int i = 0; i < 3; i++){
+                state.activeTexture(units[i]);
+                glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            }
+            state.activeTexture(0);
+        }
+
+        // Returns the number of clusters along x, y and z
+        glm::ivec3 getClusterCount() const { return count; }
+        // Returns the parameters that the shader uses to find the slice of a view depth:
+        // x: scale, y: bias, z: 1 if the slices are logarithmic (slice = log(depth) * scale + bias) or 0 if they are linear (slice = depth * scale + bias)
+        glm::vec4 getDepthParameters() const {
+            if(logarithmic){
+                float scale = count.z / std::log(farDepth / nearDepth);
+                return {scale, -std::log(nearDepth) * scale, 1.0f, 0.0f};
+            }
+            float scale = count.z / (farDepth - nearDepth);
+            return {scale, -nearDepth * scale, 0.0f, 0.0f};
+        }
+        // Returns the number of lights packed in the last build (lights without any visible effect are dropped)
+        int getLightCount() const { return (int)packedLights.size(); }
+        // Returns the number of lights that affect every fragment
+        int getGlobalLightCount() const { return globalLightCount; }
+        // Returns the total number of (cluster, light) pairs in the last build
+        size_t getAssignmentCount() const { return indices.size(); }
+        // Returns how long the last build took in milliseconds
+        double getBuildTime() const { return buildTime; }
+    };
+
+}
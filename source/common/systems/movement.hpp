@@ -15,33 +15,38 @@ namespace our
     // This system is added as a simple example for how use the ECS framework to implement logic. 
     // For more information, see "common/components/movement.hpp"
     class MovementSystem {
+        // The tags of the entities that have special movements
+        const Tag obstaclesTag = internTag("obstacles");
+        const Tag batteryTag = internTag("battery");
+        const Tag arrowTag = internTag("arrow");
 
         void rangeMovement(Entity* entity, float deltaTime) {
 
             MovementComponent* movement = entity->getComponent<MovementComponent>();
 
             // Change the position and rotation based on the linear & angular velocity and delta time.
-            entity->localTransform.position += movement->direction * deltaTime * movement->linearVelocity;
-            entity->localTransform.rotation += deltaTime * movement->angularVelocity;
+            glm::vec3 position = entity->localTransform.getPosition() + movement->direction * deltaTime * movement->linearVelocity;
+            entity->localTransform.rotate(deltaTime * movement->angularVelocity);
 			
-			if (entity->localTransform.position.y > movement->movementRangeY.y) {
-				entity->localTransform.position.y = movement->movementRangeY.y;
-			} else if (entity->localTransform.position.y < movement->movementRangeY.x) {
-				entity->localTransform.position.y = movement->movementRangeY.x;
+			if (position.y > movement->movementRangeY.y) {
+				position.y = movement->movementRangeY.y;
+			} else if (position.y < movement->movementRangeY.x) {
+				position.y = movement->movementRangeY.x;
 			}
+            entity->localTransform.setPosition(position);
 
             if((movement->movementRangeX.y + movement->movementRangeX.x) != 0 &&
-			    (entity->localTransform.position.x >= movement->movementRangeX.y || entity->localTransform.position.x <= movement->movementRangeX.x) ){
+			    (position.x >= movement->movementRangeX.y || position.x <= movement->movementRangeX.x) ){
                 movement->direction.x = -movement->direction.x;
             }
 
             if((movement->movementRangeY.y + movement->movementRangeY.x) != 0 &&
-				(entity->localTransform.position.y >= movement->movementRangeY.y || entity->localTransform.position.y <= movement->movementRangeY.x) ){
+				(position.y >= movement->movementRangeY.y || position.y <= movement->movementRangeY.x) ){
                 movement->direction.y = -movement->direction.y;
             }
 
             if((movement->movementRangeZ.y + movement->movementRangeZ.x) != 0 &&
-               	(entity->localTransform.position.z >= movement->movementRangeZ.y || entity->localTransform.position.z <= movement->movementRangeZ.x) ){
+               	(position.z >= movement->movementRangeZ.y || position.z <= movement->movementRangeZ.x) ){
                 movement->direction.z = -movement->direction.z;
             }
         }
@@ -51,55 +56,56 @@ namespace our
             MovementComponent* movement = obstacle->getComponent<MovementComponent>();
 
             // Change the position and rotation based on the linear & angular velocity and delta time.
-            obstacle->localTransform.position += movement->direction * deltaTime * movement->linearVelocity;
+            // We work on copies then set them back once so that the transform is only marked dirty once
+            glm::vec3 position = obstacle->localTransform.getPosition() + movement->direction * deltaTime * movement->linearVelocity;
+            glm::vec3 rotation = obstacle->localTransform.getRotation();
 
             // check first if the object have range in the X axis
             // if the entity exceed the range of movement in the X axis in the positive or negative direction
             if(movement->movementRangeX.y != 0 || movement->movementRangeX.x != 0) {
-                if( obstacle->localTransform.position.x >= movement->movementRangeX.y ||
-                    obstacle->localTransform.position.x <= movement->movementRangeX.x) {
+                if( position.x >= movement->movementRangeX.y ||
+                    position.x <= movement->movementRangeX.x) {
                     // change the direction of movement of the obstacle(monkey face)
-                    obstacle->localTransform.rotation.y = -obstacle->localTransform.rotation.y;
+                    rotation.y = -rotation.y;
                     // swap the side road
-                    obstacle->localTransform.position.z += movement->direction.z * 5;
+                    position.z += movement->direction.z * 5;
                     movement->direction = -movement->direction;
                 }
             }
             // check first if the object have range in the Z axis
             // if the entity exceed the range of movement in the Z axis in the positive or negative direction
             if(movement->movementRangeZ.y != 0 || movement->movementRangeZ.x != 0) {
-                if( obstacle->localTransform.position.z >= movement->movementRangeZ.y ||
-                    obstacle->localTransform.position.z <= movement->movementRangeZ.x) {
+                if( position.z >= movement->movementRangeZ.y ||
+                    position.z <= movement->movementRangeZ.x) {
                     // change the direction of movement of the obstacle(monkey face)
-                    obstacle->localTransform.rotation.y = (obstacle->localTransform.rotation.y == 0) ? 210 : 0;
+                    rotation.y = (rotation.y == 0) ? 210 : 0;
                     // swap the side road
-                    obstacle->localTransform.position.x += movement->direction.x * 7;
+                    position.x += movement->direction.x * 7;
                     movement->direction = -movement->direction;
                 }
             }
 
+            obstacle->localTransform.setPosition(position);
+            if(rotation != obstacle->localTransform.getRotation()) obstacle->localTransform.setRotation(rotation);
         }
 
     public:
         // This should be called every frame to update all entities containing a MovementComponent.
         void update(World* world, float deltaTime) {
-            // For each entity in the world
-            for(auto entity : world->getEntities()){
-                if (entity->name == "obstacles") {
+            // For each entity in the world that has a movement component
+            for(auto [entity, movement] : world->query<MovementComponent>()){
+                if (entity->getTag() == obstaclesTag) {
                     obstacleMovement(entity, deltaTime);
-                    MovementComponent* obstacleMovement = entity->getComponent<MovementComponent>();
-                    obstacleMovement->linearVelocity = min(obstacleMovement->linearVelocity * glm::vec3(1.01,1.01,1.01), glm::vec3(20,20,20));
-                } else if(entity->name == "battery" || entity->name == "arrow") {
+                    movement->linearVelocity = min(movement->linearVelocity * glm::vec3(1.01,1.01,1.01), glm::vec3(20,20,20));
+                } else if(entity->getTag() == batteryTag || entity->getTag() == arrowTag) {
                     rangeMovement(entity, deltaTime);
                 } else {
-					// Get the movement component if it exists
-					MovementComponent* movement = entity->getComponent<MovementComponent>();
-					// If the movement component exists
-					if(movement){
-						// Change the position and rotation based on the linear & angular velocity and delta time.
-						entity->localTransform.position += deltaTime * movement->linearVelocity;
-						entity->localTransform.rotation += deltaTime * movement->angularVelocity;
-					}
+					// Change the position and rotation based on the linear & angular velocity and delta time.
+					// (Skip the setters when nothing moves so that the cached matrices of the still entities stay valid)
+					if (movement->linearVelocity != glm::vec3(0, 0, 0))
+						entity->localTransform.translate(deltaTime * movement->linearVelocity);
+					if (movement->angularVelocity != glm::vec3(0, 0, 0))
+						entity->localTransform.rotate(deltaTime * movement->angularVelocity);
 				}
             }
         }
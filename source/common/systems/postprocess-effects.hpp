@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../shader/shader.hpp"
+
+#include <glad/gl.h>
+#include <json/json.hpp>
+#include <string>
+#include <unordered_map>
+#include <iostream>
+
+namespace our
+{
+
+    // The postprocess effect registry holds one compiled & linked shader program for every postprocessing effect.
+    // Compiling and linking a shader is expensive (file read, compile, link), so we do it once when the renderer is initialized
+    // and from then on, switching between effects is just picking a different program from the map.
+    // The registry owns all the programs it holds and deletes them when "clear" is called
+    // (we don't do it in the destructor since the OpenGL context may already be destroyed by then).
+    class PostprocessEffectRegistry {
+        // The key is the effect name (e.g. "obstacle", "battery") and the value is the program that applies it
+        std::unordered_map<std::string, ShaderProgram*> effects;
+    public:
+        // Compiles the given fragment shader (with the fullscreen triangle vertex shader) and stores it under the given name
+        // If an effect with the same name already exists, it is replaced. Returns false if the program failed to compile or link.
+        bool add(const std::string& name, const std::string& fragmentShaderPath) {
+            ShaderProgram* program = new ShaderProgram();
+            bool ok = program->attach("assets/shaders/fullscreen.vert", GL_VERTEX_SHADER);
+            ok = program->attach(fragmentShaderPath, GL_FRAGMENT_SHADER) && ok;
+            ok = ok && program->link();
+            if(!ok){
+                std::cerr << "Failed to build the postprocess effect \"" << name << "\" from: " << fragmentShaderPath << std::endl;
+                delete program;
+                return false;
+            }
+            if(auto it = effects.find(name); it != effects.end()){
+                delete it->second;
+            }
+            effects[name] = program;
+            return true;
+        }
+
+        // Reads the effects from the renderer configuration. The supported keys are:
+        //  "postprocess": the path of the effect applied when crashing into an obstacle (registered as "obstacle")
+        //  "energyPostProcess": the path of the effect applied when taking a battery (registered as "battery")
+        //  "postprocessEffects": an object in the form { effect_name: "path/to/fragment-shader", ... } for any extra effects
+        void deserialize(const nlohmann::json& config) {
+            if(!config.is_object()) return;
+            if(config.contains("postprocess"))
+                add("obstacle", config.value<std::string>("postprocess", ""));
+            if(config.contains("energyPostProcess"))
+                add("battery", config.value<std::string>("energyPostProcess", ""));
+            if(const auto& extra = config.value("postprocessEffects", nlohmann::json::object()); extra.is_object()){
+                for(auto& [name, path] : extra.items()){
+                    add(name, path.get<std::string>());
+                }
+            }
+        }
+
+        // Returns the program of the effect with the given name or nullptr if there is no such effect
+        ShaderProgram* get(const std::string& name) const {
+            if(auto it = effects.find(name); it != effects.end()){
+                return it->second;
+            }
+            return nullptr;
+        }
+
+        // Returns the number of compiled programs held by this registry
+        size_t size() const { return effects.size(); }
+
+        // Deletes all the programs held by the registry
+        void clear() {
+            for(auto& [name, program] : effects){
+                delete program;
+            }
+            effects.clear();
+        }
+
+        PostprocessEffectRegistry() = default;
+        PostprocessEffectRegistry(const PostprocessEffectRegistry&) = delete;
+        PostprocessEffectRegistry& operator=(const PostprocessEffectRegistry&) = delete;
+    };
+
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+#include "../material/material.hpp"
+#include "../mesh/mesh.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+    // A 64 bit sort key is built for every opaque render command so that sorting the keys groups the commands that share the same state.
+    // From the most significant bits to the least significant bits, the key holds:
+    // | pipeline state (8) | shader (12) | material (16) | mesh (16) | depth (12) |
+    // So the commands are grouped by pipeline state first (the most expensive to change), then by shader, then by material,
+    // then by mesh, and inside every group they are drawn front to back (which lets the depth test reject the hidden fragments early).
+    namespace sort_key {
+        constexpr int DEPTH_BITS = 12, MESH_BITS = 16, MATERIAL_BITS = 16, SHADER_BITS = 12, PIPELINE_BITS = 8;
+        constexpr int DEPTH_SHIFT = 0;
+        constexpr int MESH_SHIFT = DEPTH_SHIFT + DEPTH_BITS;
+        constexpr int MATERIAL_SHIFT = MESH_SHIFT + MESH_BITS;
+        constexpr int SHADER_SHIFT = MATERIAL_SHIFT + MATERIAL_BITS;
+        constexpr int PIPELINE_SHIFT = SHADER_SHIFT + SHADER_BITS;
+        static_assert(PIPELINE_SHIFT + PIPELINE_BITS == 64, "The fields of the sort key must fill 64 bits");
+
+        // The bits that identify the state set by "Material::setup" (pipeline state, shader & material)
+        constexpr uint64_t MATERIAL_MASK = ~0ull << MATERIAL_SHIFT;
+        // The bits that identify the shader program (and the pipeline state that precedes it)
+        constexpr uint64_t SHADER_MASK = ~0ull << SHADER_SHIFT;
+    }
+
+    // Gives small consecutive numbers to the pipeline states, shaders, materials & meshes so that they fit in the fields of the sort key.
+    // The numbers only need to be unique within a frame, so when a field runs out of numbers, all the numbers are given again from the start.
+    // If a single frame has more objects than a field can hold, the numbers wrap and different objects share a number: the keys still sort,
+    // but the renderer can't tell the objects apart by their keys anymore (see "hasAliasedIds").
+    class SortKeyBuilder {
+        // Maps an object (or the hash of a pipeline state) to its number
+        struct IdMap {
+            std::unordered_map<uint64_t, uint32_t> ids;
+            uint32_t capacity;
+            // The last object and its number, consecutive commands often share the same objects
+            uint64_t lastObject = 0;
+            uint32_t lastId = 0;
+            bool hasLast = false;
+            // Whether a number was given past the capacity since the last "beginFrame"
+            bool overflowed = false;
+
+            explicit IdMap(int bits) : capacity(1u << bits) {}
+
+            uint32_t get(uint64_t object) {
+                if(hasLast && object == lastObject) return lastId;
+                auto it = ids.find(object);
+                uint32_t id;
+                if(it != ids.end()) id = it->second;
+                else ids.emplace(object, id = (uint32_t)ids.size());
+                if(id >= capacity) overflowed = true;
+                lastObject = object; lastId = id; hasLast = true;
+                return id;
+            }
+
+            bool isFull() const { return ids.size() >= capacity; }
+            void clear() { ids.clear(); hasLast = false; }
+        };
+
+        IdMap pipelines{sort_key::PIPELINE_BITS}, shaders{sort_key::SHADER_BITS};
+        IdMap materials{sort_key::MATERIAL_BITS}, meshes{sort_key::MESH_BITS};
+
+        // Hashes the options of the pipeline state (FNV-1a over the fields) so that equal states get the same number
+        static uint64_t hashPipelineState(const PipelineState& state) {
+            uint64_t hash = 14695981039346656037ull;
+            auto mix = [&hash](uint64_t value){ hash = (hash ^ value) * 1099511628211ull; };
+            mix(state.faceCulling.enabled); mix(state.faceCulling.culledFace); mix(state.faceCulling.frontFace);
+            mix(state.depthTesting.enabled); mix(state.depthTesting.function);
+            mix(state.blending.enabled); mix(state.blending.equation);
+            mix(state.blending.sourceFactor); mix(state.blending.destinationFactor);
+            for(int channel = 0; channel < 4; channel++){
+                uint32_t bits;
+                std::memcpy(&bits, &state.blending.constantColor[channel], sizeof(bits));
+                mix(bits);
+                mix(state.colorMask[channel]);
+            }
+            mix(state.depthMask);
+            return hash;
+        }
+
+    public:
+        // Should be called at the start of every frame before building any key
+        void beginFrame() {
+            // The numbers are kept between the frames (so the lookups usually hit) unless one of the fields is running out of them
+            if(pipelines.isFull() || shaders.isFull() || materials.isFull() || meshes.isFull()){
+                pipelines.clear(); shaders.clear(); materials.clear(); meshes.clear();
+            }
+            pipelines.overflowed = shaders.overflowed = materials.overflowed = meshes.overflowed = false;
+        }
+
+        // Returns true if a field ran out of numbers during this frame, so two different pipeline states, shaders, materials or meshes
+        // may have the same bits in the keys (comparing the material bits of two keys is then not enough to know they share the material)
+        bool hasAliasedIds() const {
+            return pipelines.overflowed || shaders.overflowed || materials.overflowed || meshes.overflowed;
+        }
+
+        // Builds the key of a command. "depth" is the distance along the camera forward direction divided by the camera far distance.
+        uint64_t build(const Material* material, const Mesh* mesh, float depth) {
+            using namespace sort_key;
+            uint64_t depthBits = (uint64_t)(std::clamp(depth, 0.0f, 1.0f) * float((1u << DEPTH_BITS) - 1));
+            uint64_t pipelineId = pipelines.get(hashPipelineState(material->pipelineState)) & ((1u << PIPELINE_BITS) - 1);
+            uint64_t shaderId = shaders.get((uint64_t)(uintptr_t)material->shader) & ((1u << SHADER_BITS) - 1);
+            uint64_t materialId = materials.get((uint64_t)(uintptr_t)material) & ((1u << MATERIAL_BITS) - 1);
+            uint64_t meshId = meshes.get((uint64_t)(uintptr_t)mesh) & ((1u << MESH_BITS) - 1);
+            return (pipelineId << PIPELINE_SHIFT) | (shaderId << SHADER_SHIFT) | (materialId << MATERIAL_SHIFT)
+                 | (meshId << MESH_SHIFT) | (depthBits << DEPTH_SHIFT);
+        }
+    };
+
+    // A sort key and the index of the command it belongs to
+    struct SortItem {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    // Sorts the items by their keys using a least significant digit radix sort (8 bits per pass).
+    // All the histograms are computed in a single read of the items, then the passes whose digit is the same for all the items are skipped
+    // (with the key layout above, most of the high digits are the same in a scene with a few pipeline states & shaders).
+    // "scratch" is a buffer that is reused between the calls to avoid reallocating it every frame.
+    inline void radixSort(std::vector<SortItem>& items, std::vector<SortItem>& scratch) {
+        // Small lists are sorted faster by a comparison sort
+        if(items.size() < 64){
+            std::sort(items.begin(), items.end(), [](const SortItem& first, const SortItem& second){ return first.key < second.key; });
+            return;
+        }
+        constexpr int PASSES = 8;
+        uint32_t counts[PASSES][256] = {};
+        for(const SortItem& item : items)
+            for(int pass = 0; pass < PASSES; pass++)
+                counts[pass][(item.key >> (pass * 8)) & 0xFF]++;
+
+        scratch.resize(items.size());
+        SortItem* source = items.data();
+        SortItem* destination = scratch.data();
+        for(int pass = 0; pass < PASSES; pass++){
+            uint32_t* count = counts[pass];
+            // If all the items fall in the same bucket, this pass would not change the order
+            if(count[(source[0].key >> (pass * 8)) & 0xFF] == items.size()) continue;
+            // Turn the counts into the offsets of the buckets
+            uint32_t offset = 0;
+            for(int bucket = 0; bucket < 256; bucket++){
+                uint32_t bucketCount = count[bucket];
+                count[bucket] = offset;
+                offset += bucketCount;
+            }
+            for(size_t index = 0; index < items.size(); index++){
+                const SortItem& item = source[index];
+                destination[count[(item.key >> (pass * 8)) & 0xFF]++] = item;
+            }
+            std::swap(source, destination);
+        }
+        // After an odd number of passes, the sorted items are in the scratch buffer
+        if(source != items.data()) std::copy(source, source + items.size(), items.data());
+    }
+
+}
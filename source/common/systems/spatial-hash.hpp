@@ -0,0 +1,170 @@
+#pragma once
+
+#include "../ecs/entity.hpp"
+#include "../bounds.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+namespace our {
+
+    // A spatial hash is a broad-phase for collisions: the XZ plane is divided into a uniform grid of square cells and
+    // every registered entity is stored in all the cells its box touches. Only the cells that contain something are allocated
+    // (they live in a hash map), so the grid is unbounded. To find what could collide with a box, we only visit the cells the box touches,
+    // so the cost depends on how crowded the neighbourhood is, not on how many entities are registered.
+    // The hash only stores boxes, the exact (narrow-phase) test is left to the user.
+    class SpatialHash {
+        struct Entry {
+            Entity* entity = nullptr;   // nullptr marks a free entry
+            AABB bounds;
+            glm::ivec4 cells;           // The touched cells: (min x, min z, max x, max z)
+            uint32_t queryStamp = 0;    // The last query that visited this entry (so each entry is reported once per query)
+        };
+
+        float cellSize = 8.0f;
+        std::vector<Entry> entries;
+        std::vector<uint32_t> freeEntries;
+        std::unordered_map<Entity*, uint32_t> entryIndices;             // entity -> index in "entries"
+        std::unordered_map<uint64_t, std::vector<uint32_t>> cellEntries; // cell key -> indices of the entries in the cell
+        uint32_t queryStamp = 0;
+
+        static uint64_t cellKey(int x, int z) {
+            return ((uint64_t)(uint32_t)x << 32) | (uint64_t)(uint32_t)z;
+        }
+
+        // Returns the range of cells touched by the given box
+        glm::ivec4 cellRange(const AABB& bounds) const {
+            // The box could be inverted (min > max), so we take the range between the corners whatever their order is
+            float minX = std::min(bounds.min.x, bounds.max.x), maxX = std::max(bounds.min.x, bounds.max.x);
+            float minZ = std::min(bounds.min.z, bounds.max.z), maxZ = std::max(bounds.min.z, bounds.max.z);
+            return glm::ivec4(
+                (int)std::floor(minX / cellSize), (int)std::floor(minZ / cellSize),
+                (int)std::floor(maxX / cellSize), (int)std::floor(maxZ / cellSize)
+            );
+        }
+
+        void addToCells(uint32_t index) {
+            const glm::ivec4& cells = entries[index].cells;
+            for(int x = cells.x; x <= cells.z; x++)
+                for(int z = cells.y; z <= cells.w; z++)
+                    cellEntries[cellKey(x, z)].push_back(index);
+        }
+
+        void removeFromCells(uint32_t index) {
+            const glm::ivec4& cells = entries[index].cells;
+            for(int x = cells.x; x <= cells.z; x++){
+                for(int z = cells.y; z <= cells.w; z++){
+                    auto it = cellEntries.find(cellKey(x, z));
+                    if(it == cellEntries.end()) continue;
+                    auto& list = it->second;
+                    auto position = std::find(list.begin(), list.end(), index);
+                    if(position != list.end()){
+                        *position = list.back();
+                        list.pop_back();
+                    }
+                    if(list.empty()) cellEntries.erase(it);
+                }
+            }
+        }
+
+    public:
+        explicit SpatialHash(float cellSize = 8.0f) : cellSize(cellSize) {}
+
+        // Changes the cell size (in meters). It should be set before adding the entities since it clears the hash.
+        // A good cell size is around the size of the common boxes: bigger cells hold more entities, smaller cells make every box touch more cells.
+        void setCellSize(float size) {
+            clear();
+            cellSize = size;
+        }
+        float getCellSize() const { return cellSize; }
+
+        // Adds the entity with the given box or moves it if it was already added
+        void update(Entity* entity, const AABB& bounds) {
+            glm::ivec4 cells = cellRange(bounds);
+            if(auto it = entryIndices.find(entity); it != entryIndices.end()){
+                Entry& entry = entries[it->second];
+                entry.bounds = bounds;
+                // Most moves stay in the same cells, so we only touch the cells if the range changed
+                if(entry.cells != cells){
+                    removeFromCells(it->second);
+                    entry.cells = cells;
+                    addToCells(it->second);
+                }
+                return;
+            }
+            uint32_t index;
+            if(!freeEntries.empty()){
+                index = freeEntries.back();
+                freeEntries.pop_back();
+            } else {
+                index = (uint32_t)entries.size();
+                entries.emplace_back();
+            }
+            Entry& entry = entries[index];
+            entry.entity = entity;
+            entry.bounds = bounds;
+            entry.cells = cells;
+            entry.queryStamp = 0;
+            entryIndices[entity] = index;
+            addToCells(index);
+        }
+
+        // Removes the entity from the hash (it should be called before the entity is deleted)
+        void remove(Entity* entity) {
+            auto it = entryIndices.find(entity);
+            if(it == entryIndices.end()) return;
+            uint32_t index = it->second;
+            removeFromCells(index);
+            entries[index].entity = nullptr;
+            freeEntries.push_back(index);
+            entryIndices.erase(it);
+        }
+
+        // Returns whether the entity was added to the hash
+        bool contains(Entity* entity) const { return entryIndices.count(entity) != 0; }
+
+        // Calls the given function once for every entity whose box shares a cell with the given box.
+        // These are only candidates, the caller still needs to do the exact test. The function must not add or remove entities.
+        template<typename Function>
+        void query(const AABB& bounds, Function&& function) {
+            // When the stamp wraps around, we reset the stamps of the entries so that no entry is skipped by mistake
+            if(++queryStamp == 0){
+                for(auto& entry : entries) entry.queryStamp = 0;
+                queryStamp = 1;
+            }
+            glm::ivec4 cells = cellRange(bounds);
+            for(int x = cells.x; x <= cells.z; x++){
+                for(int z = cells.y; z <= cells.w; z++){
+                    auto it = cellEntries.find(cellKey(x, z));
+                    if(it == cellEntries.end()) continue;
+                    for(uint32_t index : it->second){
+                        Entry& entry = entries[index];
+                        if(entry.queryStamp == queryStamp) continue;
+                        entry.queryStamp = queryStamp;
+                        function(entry.entity, entry.bounds);
+                    }
+                }
+            }
+        }
+
+        // Returns the number of entities in the hash
+        size_t size() const { return entryIndices.size(); }
+        // Returns the number of cells that contain at least one entity
+        size_t getCellCount() const { return cellEntries.size(); }
+
+        // Removes all the entities
+        void clear() {
+            entries.clear();
+            freeEntries.clear();
+            entryIndices.clear();
+            cellEntries.clear();
+            queryStamp = 0;
+        }
+    };
+
+}
@@ -23,7 +23,17 @@ namespace our
 					{
 						{"type", "Mesh Renderer"},
 						{"mesh", "street-light"},
-						{"material", "street-light"}
+						{"material", "street-light"},
+						{"static", true}
+					},
+					{
+						// Only the thin pole (not the whole lamp) blocks the car
+						{"type", "Collider"},
+						{"size", {0.2, 0.5, 0.2}},
+						{"scaleWithEntity", false},
+						{"layer", "pole"},
+						{"collidesWith", {"car"}},
+						{"static", true}
 					}
 				})}
 			};
@@ -50,13 +60,7 @@ namespace our
     public:
         void initialize(World* world) {
 						// Get the delivery points from the world
-						Entity* lightPoints;
-						for(auto entity : world->getEntities()){
-								if(entity->name == "streetLight-position"){
-										lightPoints = entity;
-										break;
-								}
-						}
+						Entity* lightPoints = world->findByName("streetLight-position");
 
 						// Get the list of poistion point components
 						auto positionComponents = lightPoints->getComponents<PositionPointComponent>();
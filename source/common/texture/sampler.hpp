@@ -4,6 +4,8 @@
 #include <json/json.hpp>
 #include <glm/vec4.hpp>
 
+#include "../gl-state-cache.hpp"
+
 namespace our {
 
     // This class defined an OpenGL sampler
@@ -21,18 +23,19 @@ namespace our {
         ~Sampler() { 
             //TODO: (Req 6) Complete this function
 						glDeleteSamplers(1, &name);
+						GLStateCache::get().forgetSampler(name);
 				}
 
-        // This method binds this sampler to the given texture unit
+        // This method binds this sampler to the given texture unit (through the state cache)
         void bind(GLuint textureUnit) const {
             //TODO: (Req 6) Complete this function
-						glBindSampler(textureUnit, name);
+						GLStateCache::get().bindSampler(textureUnit, name);
         }
 
         // This static method ensures that no sampler is bound to the given texture unit
         static void unbind(GLuint textureUnit){
             //TODO: (Req 6) Complete this function
-						glBindSampler(textureUnit, 0);
+						GLStateCache::get().bindSampler(textureUnit, 0);
         }
 
         // This function sets a sampler paramter where the value is of type "GLint"
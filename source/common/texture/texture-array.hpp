@@ -0,0 +1,83 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/vec2.hpp>
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "texture-storage.hpp"
+#include "../gl-state-cache.hpp"
+
+namespace our {
+
+    // This class defines an OpenGL texture which will be used as a GL_TEXTURE_2D_ARRAY: a stack of same sized images (layers)
+    // that a shader samples with a "sampler2DArray" and a layer index. The materials whose textures are layers of the same array
+    // share one bind, so switching between them only changes the layer uniforms (see "LightMaterial" & "TexturedMaterial").
+    class TextureArray {
+        // The OpenGL object name of this texture
+        GLuint name = 0;
+        // The GPU memory taken by the storage of the texture in bytes (0 until the storage is allocated)
+        size_t byteCount = 0;
+        // The index of every named layer
+        std::unordered_map<std::string, int> layers;
+    public:
+        TextureArray() {
+            glGenTextures(1, &name);
+        }
+
+        ~TextureArray() {
+            glDeleteTextures(1, &name);
+            GLStateCache::get().forgetTexture(name);
+        }
+
+        GLuint getOpenGLName() {
+            return name;
+        }
+
+        // Allocates the storage of every level of every layer (immutable if the driver supports it, see "Texture2D::allocate"). The texture must be bound.
+        void allocate(GLsizei levels, GLenum internalFormat, glm::ivec2 size, GLsizei layerCount, size_t bytes) {
+            if(byteCount != 0){
+                glDeleteTextures(1, &name);
+                GLStateCache::get().forgetTexture(name);
+                glGenTextures(1, &name);
+                bind();
+            }
+            texture_storage::allocate(GL_TEXTURE_2D_ARRAY, levels, internalFormat, size, layerCount);
+            byteCount = bytes;
+        }
+
+        // Returns the GPU memory taken by the texture in bytes
+        size_t getByteCount() const { return byteCount; }
+
+        // Names the layers in order (the first name is layer 0)
+        void setLayerNames(const std::vector<std::string>& names) {
+            layers.clear();
+            for(size_t index = 0; index < names.size(); index++) layers[names[index]] = (int)index;
+        }
+
+        // Returns the index of the layer with the given name, or -1 if the array has no such layer
+        int getLayer(const std::string& layerName) const {
+            auto it = layers.find(layerName);
+            return it != layers.end() ? it->second : -1;
+        }
+
+        // Returns the number of layers
+        int getLayerCount() const { return (int)layers.size(); }
+
+        // Binds this texture to GL_TEXTURE_2D_ARRAY in the active unit (through the state cache)
+        void bind() const {
+            GLStateCache::get().bindTexture2DArray(name);
+        }
+
+        static void unbind(){
+            GLStateCache::get().bindTexture2DArray(0);
+        }
+
+        TextureArray(const TextureArray&) = delete;
+        TextureArray& operator=(const TextureArray&) = delete;
+    };
+
+}
@@ -0,0 +1,549 @@
+#include "texture-compression.hpp"
+#include "../thread-pool.hpp"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <type_traits>
+
+namespace our::texture_compression {
+
+    namespace {
+
+        struct CookedTextureHeader {
+            char magic[4];          // "CTEX"
+            uint32_t version;       // VERSION when the file was written
+            uint32_t format;        // A CompressedFormat
+            int32_t width, height;  // The size of the first level
+            uint32_t levelCount;
+            int64_t sourceTime;     // The last write time of the source image
+            uint64_t sourceSize;    // The size of the source image in bytes
+        };
+        static_assert(std::is_trivially_copyable_v<CookedTextureHeader>);
+
+        std::atomic<bool> enabled{false};
+
+        // Gets the size & the last write time of the source file (they tie the cooked texture to the current version of the source)
+        bool getSourceStamp(const std::string& source, int64_t& time, uint64_t& size) {
+            std::error_code error;
+            auto writeTime = std::filesystem::last_write_time(source, error);
+            if(error) return false;
+            auto fileSize = std::filesystem::file_size(source, error);
+            if(error) return false;
+            time = (int64_t)writeTime.time_since_epoch().count();
+            size = (uint64_t)fileSize;
+            return true;
+        }
+
+        size_t getBlockBytes(CompressedFormat format) { return format == CompressedFormat::BC1 ? 8 : 16; }
+
+        // Reads the 4x4 block whose top left pixel is (x, y), the pixels outside the image repeat the pixels on its edges
+        void readBlock(const uint8_t* pixels, glm::ivec2 size, int x, int y, glm::vec4 colors[16]) {
+            for(int row = 0; row < 4; row++){
+                for(int column = 0; column < 4; column++){
+                    const uint8_t* pixel = pixels + 4 * ((size_t)std::min(y + row, size.y - 1) * size.x + std::min(x + column, size.x - 1));
+                    colors[row * 4 + column] = glm::vec4(pixel[0], pixel[1], pixel[2], pixel[3]);
+                }
+            }
+        }
+
+        // Writes the pixels of a decoded block that are inside the image
+        void writeBlock(uint8_t* pixels, glm::ivec2 size, int x, int y, const uint8_t colors[16][4]) {
+            for(int row = 0; row < 4 && y + row < size.y; row++)
+                for(int column = 0; column < 4 && x + column < size.x; column++)
+                    std::memcpy(pixels + 4 * ((size_t)(y + row) * size.x + x + column), colors[row * 4 + column], 4);
+        }
+
+        // Finds the line that fits the colors best (it goes through their mean along their principal axis) and returns the projections
+        // of the two colors that are farthest apart on it. Only the first "channels" channels are used (3 for RGB, 4 for RGBA).
+        void fitLine(const glm::vec4 colors[16], int channels, glm::vec4& start, glm::vec4& end) {
+            glm::vec4 mask = channels == 4 ? glm::vec4(1) : glm::vec4(1, 1, 1, 0);
+            glm::vec4 mean(0), minimum(255), maximum(0);
+            for(int index = 0; index < 16; index++){
+                mean += colors[index];
+                minimum = glm::min(minimum, colors[index]);
+                maximum = glm::max(maximum, colors[index]);
+            }
+            mean = mean / 16.0f * mask;
+            glm::mat4 covariance(0);
+            for(int index = 0; index < 16; index++){
+                glm::vec4 difference = colors[index] * mask - mean;
+                covariance += glm::outerProduct(difference, difference);
+            }
+            // The principal axis is found by power iteration, starting from the diagonal of the bounding box
+            glm::vec4 axis = (maximum - minimum) * mask;
+            for(int iteration = 0; iteration < 8 && glm::dot(axis, axis) > 1e-8f; iteration++){
+                axis = covariance * axis;
+                float length = glm::length(axis);
+                if(length > 1e-8f) axis /= length;
+            }
+            if(glm::dot(axis, axis) <= 1e-8f){
+                // All the colors are the same
+                start = end = mean + colors[0] * (glm::vec4(1) - mask);
+                return;
+            }
+            float low = 1e30f, high = -1e30f;
+            for(int index = 0; index < 16; index++){
+                float projection = glm::dot(colors[index] * mask - mean, axis);
+                low = std::min(low, projection);
+                high = std::max(high, projection);
+            }
+            start = mean + axis * low;
+            end = mean + axis * high;
+        }
+
+        // Finds the two endpoints that minimize the squared error of the colors, given the weight of the second endpoint in every color
+        // (least squares). Returns false if the weights don't define the endpoints (e.g. they are all equal).
+        bool refineEndpoints(const glm::vec4 colors[16], const float weights[16], glm::vec4& start, glm::vec4& end) {
+            float aa = 0, ab = 0, bb = 0;
+            glm::vec4 ax(0), bx(0);
+            for(int index = 0; index < 16; index++){
+                float b = weights[index], a = 1.0f - b;
+                aa += a * a; ab += a * b; bb += b * b;
+                ax += a * colors[index]; bx += b * colors[index];
+            }
+            float determinant = aa * bb - ab * ab;
+            if(std::abs(determinant) < 1e-6f) return false;
+            start = glm::clamp((ax * bb - bx * ab) / determinant, glm::vec4(0), glm::vec4(255));
+            end = glm::clamp((bx * aa - ax * ab) / determinant, glm::vec4(0), glm::vec4(255));
+            return true;
+        }
+
+        float squaredDistance(const glm::vec4& a, const glm::vec4& b, int channels) {
+            glm::vec4 difference = a - b;
+            if(channels == 3) difference.a = 0;
+            return glm::dot(difference, difference);
+        }
+
+        // Picks the closest palette entry for every color and returns the total squared error
+        float pickIndices(const glm::vec4 colors[16], const glm::vec4* palette, int paletteSize, int channels, uint8_t indices[16]) {
+            float error = 0;
+            for(int index = 0; index < 16; index++){
+                float best = 1e30f;
+                for(int entry = 0; entry < paletteSize; entry++){
+                    float distance = squaredDistance(colors[index], palette[entry], channels);
+                    if(distance < best){ best = distance; indices[index] = (uint8_t)entry; }
+                }
+                error += best;
+            }
+            return error;
+        }
+
+        // A little endian bit writer & reader for the 128 bits of a BC7 block
+        struct BlockBits {
+            uint8_t* bytes;
+            int position = 0;
+            void write(uint32_t value, int count) {
+                for(int bit = 0; bit < count; bit++, position++)
+                    if(value >> bit & 1) bytes[position >> 3] |= (uint8_t)(1 << (position & 7));
+            }
+            uint32_t read(int count) {
+                uint32_t value = 0;
+                for(int bit = 0; bit < count; bit++, position++) value |= (uint32_t)(bytes[position >> 3] >> (position & 7) & 1) << bit;
+                return value;
+            }
+        };
+
+        // ------------------------------------------------------------------------------------------------------------------------------
+        // BC1 color blocks: two RGB565 endpoints and 2 bits per pixel that pick one of the endpoints or one of the 2 colors between them
+
+        uint16_t packRGB565(const glm::vec4& color) {
+            glm::vec4 clamped = glm::clamp(color, glm::vec4(0), glm::vec4(255));
+            return (uint16_t)((int)std::round(clamped.r * 31 / 255) << 11 | (int)std::round(clamped.g * 63 / 255) << 5 | (int)std::round(clamped.b * 31 / 255));
+        }
+
+        glm::ivec3 unpackRGB565(uint16_t value) {
+            int r = value >> 11 & 31, g = value >> 5 & 63, b = value & 31;
+            return {r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2};
+        }
+
+        // Fills the 4 colors of a color block. If "fourColors" is false and color0 <= color1, the block has 3 colors and black (the BC1 rule).
+        void getColorPalette(uint16_t color0, uint16_t color1, bool fourColors, glm::ivec3 palette[4], bool& transparentBlack) {
+            palette[0] = unpackRGB565(color0);
+            palette[1] = unpackRGB565(color1);
+            transparentBlack = false;
+            if(fourColors || color0 > color1){
+                palette[2] = (2 * palette[0] + palette[1]) / 3;
+                palette[3] = (palette[0] + 2 * palette[1]) / 3;
+            } else {
+                palette[2] = (palette[0] + palette[1]) / 2;
+                palette[3] = glm::ivec3(0);
+                transparentBlack = true;
+            }
+        }
+
+        // Encodes the RGB of the colors as a color block in the 4 color mode (color0 > color1), which both BC1 & BC3 can read
+        void encodeColorBlock(const glm::vec4 colors[16], uint8_t* out) {
+            uint16_t bestColors[2] = {0, 0};
+            uint8_t bestIndices[16] = {};
+            float bestError = 1e30f;
+            auto evaluate = [&](const glm::vec4& start, const glm::vec4& end) {
+                uint16_t color0 = packRGB565(end), color1 = packRGB565(start);
+                if(color0 < color1) std::swap(color0, color1);
+                uint8_t indices[16] = {};
+                float error;
+                glm::ivec3 ints[4]; bool transparentBlack;
+                getColorPalette(color0, color1, true, ints, transparentBlack);
+                glm::vec4 palette[4];
+                for(int entry = 0; entry < 4; entry++) palette[entry] = glm::vec4(glm::vec3(ints[entry]), 255);
+                // With equal endpoints, the block would be read in the 3 color mode, so only the first color is used
+                error = color0 == color1 ? pickIndices(colors, palette, 1, 3, indices) : pickIndices(colors, palette, 4, 3, indices);
+                if(error < bestError){
+                    bestError = error;
+                    bestColors[0] = color0; bestColors[1] = color1;
+                    std::memcpy(bestIndices, indices, 16);
+                }
+            };
+            glm::vec4 start, end;
+            fitLine(colors, 3, start, end);
+            evaluate(start, end);
+            // Refine the endpoints with least squares (the weight of color1 for the indices 0, 1, 2 & 3)
+            const float WEIGHTS[4] = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+            for(int iteration = 0; iteration < 2 && bestColors[0] != bestColors[1]; iteration++){
+                float weights[16];
+                for(int index = 0; index < 16; index++) weights[index] = WEIGHTS[bestIndices[index]];
+                glm::vec4 color0, color1;
+                if(!refineEndpoints(colors, weights, color0, color1)) break;
+                evaluate(color1, color0);
+            }
+            uint32_t indexBits = 0;
+            for(int index = 0; index < 16; index++) indexBits |= (uint32_t)bestIndices[index] << (2 * index);
+            out[0] = (uint8_t)bestColors[0]; out[1] = (uint8_t)(bestColors[0] >> 8);
+            out[2] = (uint8_t)bestColors[1]; out[3] = (uint8_t)(bestColors[1] >> 8);
+            std::memcpy(out + 4, &indexBits, 4);
+        }
+
+        void decodeColorBlock(const uint8_t* in, bool fourColors, uint8_t colors[16][4]) {
+            uint16_t color0 = (uint16_t)(in[0] | in[1] << 8), color1 = (uint16_t)(in[2] | in[3] << 8);
+            glm::ivec3 palette[4]; bool transparentBlack;
+            getColorPalette(color0, color1, fourColors, palette, transparentBlack);
+            uint32_t indexBits;
+            std::memcpy(&indexBits, in + 4, 4);
+            for(int index = 0; index < 16; index++){
+                const glm::ivec3& color = palette[indexBits >> (2 * index) & 3];
+                colors[index][0] = (uint8_t)color.r; colors[index][1] = (uint8_t)color.g; colors[index][2] = (uint8_t)color.b;
+                colors[index][3] = 255;
+            }
+        }
+
+        // ------------------------------------------------------------------------------------------------------------------------------
+        // BC3 alpha blocks: two 8 bit endpoints and 3 bits per pixel that pick one of the 8 alphas between them
+
+        void getAlphaPalette(int alpha0, int alpha1, int palette[8]) {
+            palette[0] = alpha0; palette[1] = alpha1;
+            if(alpha0 > alpha1){
+                for(int entry = 2; entry < 8; entry++) palette[entry] = ((8 - entry) * alpha0 + (entry - 1) * alpha1) / 7;
+            } else {
+                for(int entry = 2; entry < 6; entry++) palette[entry] = ((6 - entry) * alpha0 + (entry - 1) * alpha1) / 5;
+                palette[6] = 0; palette[7] = 255;
+            }
+        }
+
+        void encodeAlphaBlock(const glm::vec4 colors[16], uint8_t* out) {
+            int minimum = 255, maximum = 0;
+            for(int index = 0; index < 16; index++){
+                minimum = std::min(minimum, (int)colors[index].a);
+                maximum = std::max(maximum, (int)colors[index].a);
+            }
+            out[0] = (uint8_t)maximum; out[1] = (uint8_t)minimum;
+            uint64_t indexBits = 0;
+            if(maximum > minimum){
+                int palette[8];
+                getAlphaPalette(maximum, minimum, palette);
+                for(int index = 0; index < 16; index++){
+                    int best = 0, bestDistance = 1 << 30;
+                    for(int entry = 0; entry < 8; entry++){
+                        int distance = std::abs(palette[entry] - (int)colors[index].a);
+                        if(distance < bestDistance){ bestDistance = distance; best = entry; }
+                    }
+                    indexBits |= (uint64_t)best << (3 * index);
+                }
+            }
+            for(int byte = 0; byte < 6; byte++) out[2 + byte] = (uint8_t)(indexBits >> (8 * byte));
+        }
+
+        void decodeAlphaBlock(const uint8_t* in, uint8_t colors[16][4]) {
+            int palette[8];
+            getAlphaPalette(in[0], in[1], palette);
+            uint64_t indexBits = 0;
+            for(int byte = 0; byte < 6; byte++) indexBits |= (uint64_t)in[2 + byte] << (8 * byte);
+            for(int index = 0; index < 16; index++) colors[index][3] = (uint8_t)palette[indexBits >> (3 * index) & 7];
+        }
+
+        // ------------------------------------------------------------------------------------------------------------------------------
+        // BC7 mode 6 blocks: two RGBA endpoints of 7 bits per channel (plus a shared lowest bit per endpoint) and 4 bits per pixel
+        // that pick one of 16 colors between them. It is the mode that suits a single smooth gradient of colors & alphas best.
+
+        const int BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+
+        // Quantizes an endpoint to 7 bits per channel and picks the shared lowest bit that gives the smallest error
+        void quantizeBC7Endpoint(const glm::vec4& endpoint, glm::ivec4& quantized, int& pBit) {
+            float bestError = 1e30f;
+            for(int bit = 0; bit < 2; bit++){
+                glm::ivec4 candidate = glm::clamp(glm::ivec4(glm::round((endpoint - (float)bit) / 2.0f)), glm::ivec4(0), glm::ivec4(127));
+                glm::vec4 difference = glm::vec4(candidate * 2 + bit) - endpoint;
+                float error = glm::dot(difference, difference);
+                if(error < bestError){ bestError = error; quantized = candidate; pBit = bit; }
+            }
+        }
+
+        void getBC7Palette(const glm::ivec4& endpoint0, const glm::ivec4& endpoint1, glm::ivec4 palette[16]) {
+            for(int entry = 0; entry < 16; entry++)
+                palette[entry] = ((64 - BC7_WEIGHTS[entry]) * endpoint0 + BC7_WEIGHTS[entry] * endpoint1 + 32) >> 6;
+        }
+
+        void encodeBC7Block(const glm::vec4 colors[16], uint8_t* out) {
+            glm::ivec4 bestEndpoints[2];
+            int bestBits[2] = {0, 0};
+            uint8_t bestIndices[16] = {};
+            float bestError = 1e30f;
+            auto evaluate = [&](const glm::vec4& start, const glm::vec4& end) {
+                glm::ivec4 quantized[2]; int bits[2];
+                quantizeBC7Endpoint(start, quantized[0], bits[0]);
+                quantizeBC7Endpoint(end, quantized[1], bits[1]);
+                glm::ivec4 ints[16];
+                getBC7Palette(quantized[0] * 2 + bits[0], quantized[1] * 2 + bits[1], ints);
+                glm::vec4 palette[16];
+                for(int entry = 0; entry < 16; entry++) palette[entry] = glm::vec4(ints[entry]);
+                uint8_t indices[16];
+                float error = pickIndices(colors, palette, 16, 4, indices);
+                if(error < bestError){
+                    bestError = error;
+                    bestEndpoints[0] = quantized[0]; bestEndpoints[1] = quantized[1];
+                    bestBits[0] = bits[0]; bestBits[1] = bits[1];
+                    std::memcpy(bestIndices, indices, 16);
+                }
+            };
+            glm::vec4 start, end;
+            fitLine(colors, 4, start, end);
+            evaluate(start, end);
+            for(int iteration = 0; iteration < 2; iteration++){
+                float weights[16];
+                for(int index = 0; index < 16; index++) weights[index] = BC7_WEIGHTS[bestIndices[index]] / 64.0f;
+                if(!refineEndpoints(colors, weights, start, end)) break;
+                evaluate(start, end);
+            }
+            // The highest bit of the first index is not stored (it must be 0), so the endpoints are swapped if it is 1
+            if(bestIndices[0] >= 8){
+                std::swap(bestEndpoints[0], bestEndpoints[1]);
+                std::swap(bestBits[0], bestBits[1]);
+                for(auto& index : bestIndices) index = (uint8_t)(15 - index);
+            }
+            std::memset(out, 0, 16);
+            BlockBits bits{out};
+            bits.write(1 << 6, 7); // Mode 6
+            for(int channel = 0; channel < 4; channel++){
+                bits.write((uint32_t)bestEndpoints[0][channel], 7);
+                bits.write((uint32_t)bestEndpoints[1][channel], 7);
+            }
+            bits.write((uint32_t)bestBits[0], 1);
+            bits.write((uint32_t)bestBits[1], 1);
+            for(int index = 0; index < 16; index++) bits.write(bestIndices[index], index == 0 ? 3 : 4);
+        }
+
+        bool decodeBC7Block(const uint8_t* in, uint8_t colors[16][4]) {
+            // Only mode 6 is read, since it is the only mode that the encoder writes
+            if((in[0] & 0x7F) != 0x40) return false;
+            BlockBits bits{const_cast<uint8_t*>(in), 7};
+            glm::ivec4 endpoints[2];
+            for(int channel = 0; channel < 4; channel++){
+                endpoints[0][channel] = (int)bits.read(7);
+                endpoints[1][channel] = (int)bits.read(7);
+            }
+            endpoints[0] = endpoints[0] * 2 + (int)bits.read(1);
+            endpoints[1] = endpoints[1] * 2 + (int)bits.read(1);
+            glm::ivec4 palette[16];
+            getBC7Palette(endpoints[0], endpoints[1], palette);
+            for(int index = 0; index < 16; index++){
+                const glm::ivec4& color = palette[bits.read(index == 0 ? 3 : 4)];
+                for(int channel = 0; channel < 4; channel++) colors[index][channel] = (uint8_t)color[channel];
+            }
+            return true;
+        }
+
+        // ------------------------------------------------------------------------------------------------------------------------------
+
+        // Halves the image with a box filter (the last row or column of an odd size is repeated)
+        std::vector<uint8_t> downsample(const std::vector<uint8_t>& pixels, glm::ivec2 size) {
+            glm::ivec2 half = glm::max(glm::ivec2(1), size / 2);
+            std::vector<uint8_t> result((size_t)half.x * half.y * 4);
+            for(int y = 0; y < half.y; y++){
+                int y0 = std::min(2 * y, size.y - 1), y1 = std::min(2 * y + 1, size.y - 1);
+                for(int x = 0; x < half.x; x++){
+                    int x0 = std::min(2 * x, size.x - 1), x1 = std::min(2 * x + 1, size.x - 1);
+                    for(int channel = 0; channel < 4; channel++){
+                        int sum = pixels[4 * ((size_t)y0 * size.x + x0) + channel] + pixels[4 * ((size_t)y0 * size.x + x1) + channel]
+                                + pixels[4 * ((size_t)y1 * size.x + x0) + channel] + pixels[4 * ((size_t)y1 * size.x + x1) + channel];
+                        result[4 * ((size_t)y * half.x + x) + channel] = (uint8_t)((sum + 2) / 4);
+                    }
+                }
+            }
+            return result;
+        }
+
+        std::vector<uint8_t> compressLevel(const uint8_t* pixels, glm::ivec2 size, CompressedFormat format, ThreadPool* pool) {
+            if(format == CompressedFormat::RGBA8) return std::vector<uint8_t>(pixels, pixels + (size_t)size.x * size.y * 4);
+            glm::ivec2 blocks = (size + 3) / 4;
+            size_t blockBytes = getBlockBytes(format);
+            std::vector<uint8_t> data((size_t)blocks.x * blocks.y * blockBytes);
+            // Every block is compressed on its own, so the rows of blocks are spread over the threads
+            auto compressRow = [&](size_t row){
+                glm::vec4 colors[16];
+                for(int column = 0; column < blocks.x; column++){
+                    uint8_t* out = data.data() + ((size_t)row * blocks.x + column) * blockBytes;
+                    readBlock(pixels, size, column * 4, (int)row * 4, colors);
+                    switch(format){
+                        case CompressedFormat::BC1: encodeColorBlock(colors, out); break;
+                        case CompressedFormat::BC3: encodeAlphaBlock(colors, out); encodeColorBlock(colors, out + 8); break;
+                        case CompressedFormat::BC7: encodeBC7Block(colors, out); break;
+                        default: break;
+                    }
+                }
+            };
+            if(pool) pool->parallelFor((size_t)blocks.y, compressRow);
+            else for(int row = 0; row < blocks.y; row++) compressRow(row);
+            return data;
+        }
+    }
+
+    void setEnabled(bool value) { enabled = value; }
+    bool isEnabled() { return enabled; }
+
+    const char* getFormatName(CompressedFormat format) {
+        switch(format){
+            case CompressedFormat::BC1: return "BC1";
+            case CompressedFormat::BC3: return "BC3";
+            case CompressedFormat::BC7: return "BC7";
+            default: return "RGBA8";
+        }
+    }
+
+    bool parseFormatName(const std::string& name, CompressedFormat& format) {
+        std::string upper = name;
+        std::transform(upper.begin(), upper.end(), upper.begin(), [](char c){ return (char)std::toupper((unsigned char)c); });
+        for(CompressedFormat candidate : {CompressedFormat::RGBA8, CompressedFormat::BC1, CompressedFormat::BC3, CompressedFormat::BC7}){
+            if(upper == getFormatName(candidate)){
+                format = candidate;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t getLevelByteCount(CompressedFormat format, glm::ivec2 size) {
+        if(format == CompressedFormat::RGBA8) return (size_t)size.x * size.y * 4;
+        glm::ivec2 blocks = (size + 3) / 4;
+        return (size_t)blocks.x * blocks.y * getBlockBytes(format);
+    }
+
+    bool hasAlpha(const uint8_t* pixels, glm::ivec2 size) {
+        for(size_t index = 0, count = (size_t)size.x * size.y; index < count; index++)
+            if(pixels[4 * index + 3] != 255) return true;
+        return false;
+    }
+
+    CompressedImage compress(const uint8_t* pixels, glm::ivec2 size, CompressedFormat format, bool mipmaps, ThreadPool* pool) {
+        CompressedImage image;
+        image.format = format;
+        image.size = size;
+        image.levels.push_back(compressLevel(pixels, size, format, pool));
+        if(!mipmaps) return image;
+        std::vector<uint8_t> level(pixels, pixels + (size_t)size.x * size.y * 4);
+        glm::ivec2 levelSize = size;
+        while(levelSize.x > 1 || levelSize.y > 1){
+            level = downsample(level, levelSize);
+            levelSize = glm::max(glm::ivec2(1), levelSize / 2);
+            image.levels.push_back(compressLevel(level.data(), levelSize, format, pool));
+        }
+        return image;
+    }
+
+    std::vector<uint8_t> decompressLevel(CompressedFormat format, glm::ivec2 size, const std::vector<uint8_t>& data) {
+        if(data.size() != getLevelByteCount(format, size)) return {};
+        if(format == CompressedFormat::RGBA8) return data;
+        std::vector<uint8_t> pixels((size_t)size.x * size.y * 4);
+        glm::ivec2 blocks = (size + 3) / 4;
+        size_t blockBytes = getBlockBytes(format);
+        uint8_t colors[16][4];
+        for(int row = 0; row < blocks.y; row++){
+            for(int column = 0; column < blocks.x; column++){
+                const uint8_t* in = data.data() + ((size_t)row * blocks.x + column) * blockBytes;
+                switch(format){
+                    case CompressedFormat::BC1: decodeColorBlock(in, false, colors); break;
+                    case CompressedFormat::BC3: decodeColorBlock(in + 8, true, colors); decodeAlphaBlock(in, colors); break;
+                    case CompressedFormat::BC7: if(!decodeBC7Block(in, colors)) return {}; break;
+                    default: break;
+                }
+                writeBlock(pixels.data(), size, column * 4, row * 4, colors);
+            }
+        }
+        return pixels;
+    }
+
+    std::string getPath(const std::string& source) { return source + ".ctex"; }
+
+    bool read(const std::string& source, CompressedImage& image) {
+        int64_t sourceTime; uint64_t sourceSize;
+        if(!getSourceStamp(source, sourceTime, sourceSize)) return false;
+        std::ifstream file(getPath(source), std::ios::binary);
+        if(!file) return false;
+        CookedTextureHeader header;
+        if(!file.read((char*)&header, sizeof(header))) return false;
+        if(std::memcmp(header.magic, "CTEX", 4) != 0 || header.version != VERSION || header.format > (uint32_t)CompressedFormat::BC7) return false;
+        // The source changed since the texture was cooked
+        if(header.sourceTime != sourceTime || header.sourceSize != sourceSize) return false;
+        if(header.width <= 0 || header.height <= 0 || header.levelCount == 0 || header.levelCount > 32) return false;
+        image.format = (CompressedFormat)header.format;
+        image.size = {header.width, header.height};
+        image.levels.resize(header.levelCount);
+        for(size_t level = 0; level < image.levels.size(); level++){
+            image.levels[level].resize(getLevelByteCount(image.format, image.getLevelSize(level)));
+            if(!file.read((char*)image.levels[level].data(), image.levels[level].size())) return false;
+        }
+        return true;
+    }
+
+    bool write(const std::string& source, const CompressedImage& image) {
+        CookedTextureHeader header = {};
+        std::memcpy(header.magic, "CTEX", 4);
+        header.version = VERSION;
+        header.format = (uint32_t)image.format;
+        header.width = image.size.x;
+        header.height = image.size.y;
+        header.levelCount = (uint32_t)image.levels.size();
+        if(!getSourceStamp(source, header.sourceTime, header.sourceSize)){
+            std::cerr << "Failed to write the cooked texture of \"" << source << "\": the source file does not exist" << std::endl;
+            return false;
+        }
+
+        // The file is written under a temporary name then renamed, so a reader never sees a half written texture
+        std::string path = getPath(source), temporaryPath = path + ".tmp";
+        {
+            std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+            if(!file){
+                std::cerr << "Failed to write the cooked texture: couldn't open \"" << temporaryPath << "\"" << std::endl;
+                return false;
+            }
+            file.write((const char*)&header, sizeof(header));
+            for(const auto& level : image.levels) file.write((const char*)level.data(), level.size());
+            if(!file){
+                std::cerr << "Failed to write the cooked texture \"" << temporaryPath << "\"" << std::endl;
+                return false;
+            }
+        }
+        std::error_code error;
+        std::filesystem::rename(temporaryPath, path, error);
+        if(error){
+            std::cerr << "Failed to write the cooked texture \"" << path << "\": " << error.message() << std::endl;
+            std::filesystem::remove(temporaryPath, error);
+            return false;
+        }
+        return true;
+    }
+
+}
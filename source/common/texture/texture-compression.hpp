@@ -0,0 +1,75 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace our {
+
+    class ThreadPool;
+
+    // The formats of a cooked texture
+    //  - RGBA8: 4 bytes per texel (what the loader uploads when the source image is decoded at runtime)
+    //  - BC1 (DXT1): 4x4 blocks of 8 bytes (0.5 byte per texel), opaque colors only
+    //  - BC3 (DXT5): 4x4 blocks of 16 bytes (1 byte per texel), a BC1 color block with a separate alpha block
+    //  - BC7: 4x4 blocks of 16 bytes (1 byte per texel), a better quality than BC3 (our encoder only writes mode 6 blocks)
+    enum class CompressedFormat : uint32_t { RGBA8 = 0, BC1 = 1, BC3 = 2, BC7 = 3 };
+
+    // A texture with its whole mip chain in a (possibly) block compressed format
+    struct CompressedImage {
+        CompressedFormat format = CompressedFormat::RGBA8;
+        glm::ivec2 size = {0, 0};
+        std::vector<std::vector<uint8_t>> levels; // The data of every mip level, starting from the full size
+
+        // Returns the size of the given mip level (levels are never smaller than 1x1)
+        glm::ivec2 getLevelSize(size_t level) const { return glm::max(glm::ivec2(1), size >> glm::ivec2((int)level)); }
+        // Returns the number of bytes of all the levels
+        size_t getByteCount() const {
+            size_t bytes = 0;
+            for(const auto& level : levels) bytes += level.size();
+            return bytes;
+        }
+    };
+
+    // The texture compression turns RGBA8 images into block compressed textures with pre-generated mip chains, and stores them in ".ctex" files.
+    // The cooked texture of "assets/textures/road.jpg" is "assets/textures/road.jpg.ctex", it remembers the size & the last write time of its
+    // source so that a cooked texture whose source was edited is not used. The textures are cooked ahead of time by the texture cooker tool.
+    namespace texture_compression {
+
+        // Increase it whenever the layout of the file (or the output of an encoder) changes
+        constexpr uint32_t VERSION = 1;
+
+        // Enables or disables loading the cooked textures instead of their sources (it is disabled by default)
+        void setEnabled(bool enabled);
+        bool isEnabled();
+
+        // Returns the name of the format (e.g. "BC1") and parses a name back (returns false if the name is unknown)
+        const char* getFormatName(CompressedFormat format);
+        bool parseFormatName(const std::string& name, CompressedFormat& format);
+
+        // Returns the number of bytes of a level of the given size in the given format
+        size_t getLevelByteCount(CompressedFormat format, glm::ivec2 size);
+
+        // Returns true if any pixel of the RGBA8 image is not fully opaque
+        bool hasAlpha(const uint8_t* pixels, glm::ivec2 size);
+
+        // Compresses an RGBA8 image (and the mip levels generated from it with a box filter if "mipmaps" is true).
+        // If a thread pool is given, the blocks are compressed on all its threads.
+        CompressedImage compress(const uint8_t* pixels, glm::ivec2 size, CompressedFormat format, bool mipmaps, ThreadPool* pool = nullptr);
+
+        // Decompresses a level back to RGBA8 (for the GPUs that don't support the format). Returns an empty vector if the data is invalid.
+        std::vector<uint8_t> decompressLevel(CompressedFormat format, glm::ivec2 size, const std::vector<uint8_t>& data);
+
+        // Returns the path of the cooked texture of the given source image
+        std::string getPath(const std::string& source);
+
+        // Reads the cooked texture of the given source image. Returns false if there is none or if it is out of date or invalid.
+        bool read(const std::string& source, CompressedImage& image);
+
+        // Writes the cooked texture of the given source image. Returns false (and prints the reason) if the file could not be written.
+        bool write(const std::string& source, const CompressedImage& image);
+    }
+
+}
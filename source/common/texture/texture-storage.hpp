@@ -0,0 +1,73 @@
+#pragma once
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+namespace our::texture_storage {
+
+    // Returns whether the driver can allocate immutable texture storage (OpenGL 4.2 or GL_ARB_texture_storage).
+    // The application only asks for an OpenGL 3.3 context, so the storage may have to be allocated level by level instead.
+    inline bool isImmutableSupported() {
+        return (GLAD_GL_VERSION_4_2 || GLAD_GL_ARB_texture_storage) && glTexStorage2D != nullptr && glTexStorage3D != nullptr;
+    }
+
+    // Returns the bytes of a 4x4 block if the internal format is one of the block compressed formats of the texture cooker (0 otherwise)
+    inline GLsizei getCompressedBlockBytes(GLenum internalFormat) {
+        switch(internalFormat){
+            case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+                return 8;
+            case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+            case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+            case GL_COMPRESSED_RGBA_BPTC_UNORM:
+                return 16;
+            default:
+                return 0;
+        }
+    }
+
+    // Returns a pixel format & type that glTexImage accepts with the given sized internal format
+    // (a mutable allocation needs them even though no pixels are given)
+    inline void getTransferFormat(GLenum internalFormat, GLenum& format, GLenum& type) {
+        type = GL_UNSIGNED_BYTE;
+        switch(internalFormat){
+            case GL_R8: format = GL_RED; break;
+            case GL_RG8: format = GL_RG; break;
+            case GL_RGB8: case GL_SRGB8: format = GL_RGB; break;
+            case GL_DEPTH_COMPONENT16: case GL_DEPTH_COMPONENT24: case GL_DEPTH_COMPONENT32:
+                format = GL_DEPTH_COMPONENT; type = GL_UNSIGNED_INT; break;
+            case GL_DEPTH_COMPONENT32F: format = GL_DEPTH_COMPONENT; type = GL_FLOAT; break;
+            case GL_DEPTH24_STENCIL8: format = GL_DEPTH_STENCIL; type = GL_UNSIGNED_INT_24_8; break;
+            default: format = GL_RGBA; break;
+        }
+    }
+
+    // Allocates the storage of every level of the texture bound to "target" (GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY with "layers" layers).
+    // It is immutable storage if the driver supports it. Otherwise every level is allocated by glTexImage (or glCompressedTexImage) with the
+    // same sized format, and the levels the texture doesn't have are excluded by GL_TEXTURE_MAX_LEVEL, so the texture is complete either way.
+    inline void allocate(GLenum target, GLsizei levels, GLenum internalFormat, glm::ivec2 size, GLsizei layers = 1) {
+        bool array = target == GL_TEXTURE_2D_ARRAY;
+        if(isImmutableSupported()){
+            if(array) glTexStorage3D(target, levels, internalFormat, size.x, size.y, layers);
+            else glTexStorage2D(target, levels, internalFormat, size.x, size.y);
+            return;
+        }
+        GLsizei blockBytes = getCompressedBlockBytes(internalFormat);
+        GLenum format, type;
+        getTransferFormat(internalFormat, format, type);
+        for(GLsizei level = 0; level < levels; level++){
+            glm::ivec2 levelSize = glm::max(glm::ivec2(1), size >> glm::ivec2(level));
+            if(blockBytes != 0){
+                GLsizei imageSize = ((levelSize.x + 3) / 4) * ((levelSize.y + 3) / 4) * blockBytes * layers;
+                if(array) glCompressedTexImage3D(target, level, internalFormat, levelSize.x, levelSize.y, layers, 0, imageSize, nullptr);
+                else glCompressedTexImage2D(target, level, internalFormat, levelSize.x, levelSize.y, 0, imageSize, nullptr);
+            } else {
+                if(array) glTexImage3D(target, level, internalFormat, levelSize.x, levelSize.y, layers, 0, format, type, nullptr);
+                else glTexImage2D(target, level, internalFormat, levelSize.x, levelSize.y, 0, format, type, nullptr);
+            }
+        }
+        glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, 0);
+        glTexParameteri(target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    }
+
+}
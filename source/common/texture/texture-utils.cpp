@@ -5,6 +5,32 @@
 
 #include <iostream>
 #include <cmath>
+#include <algorithm>
+
+// Returns the number of levels of a full mip chain (down to 1x1)
+static GLsizei getMipLevelCount(glm::ivec2 size) {
+    return (GLsizei)std::floor(std::log2((float)std::max(size.x, size.y))) + 1;
+}
+
+// Returns the number of bytes of the first "levels" levels of a mip chain with the given texel size
+static size_t getMipChainBytes(glm::ivec2 size, GLsizei levels, size_t bytesPerTexel) {
+    size_t bytes = 0;
+    for(GLsizei level = 0; level < levels; level++)
+        bytes += (size_t)std::max(1, size.x >> level) * std::max(1, size.y >> level) * bytesPerTexel;
+    return bytes;
+}
+
+// Returns the size of a texel of the sized internal formats that the textures use
+static size_t getBytesPerTexel(GLenum format) {
+    switch(format){
+        case GL_R8: return 1;
+        case GL_RG8: return 2;
+        case GL_RGB8: return 3;
+        case GL_RGBA16F: return 8;
+        case GL_RGBA32F: return 16;
+        default: return 4; // GL_RGBA8, GL_DEPTH_COMPONENT24 (padded to 32 bits) & GL_DEPTH24_STENCIL8
+    }
+}
 
 our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size){
     our::Texture2D* texture = new our::Texture2D();
@@ -20,16 +46,36 @@ our::Texture2D* our::texture_utils::empty(GLenum format, glm::ivec2 size){
     }
     // Allocate a space without filling it with any data with the required number of levels
     // As number of levels is determined with the type of the request if it's for depth or color
-    glTexStorage2D(GL_TEXTURE_2D,numOfLevels,format,size.x,size.y);
+    texture->allocate(numOfLevels, format, size, getMipChainBytes(size, numOfLevels, getBytesPerTexel(format)));
     return texture;
 }
 
 our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool generate_mipmap) {
+    Image image;
+    if(!decodeImage(filename, image)) return nullptr;
+    // Create a texture then fill it with the image
+    our::Texture2D* texture = new our::Texture2D();
+    uploadImage(texture, image, generate_mipmap);
+    return texture;
+}
+
+bool our::texture_utils::decodeImage(const std::string& filename, Image& image, int channels) {
+    if(texture_compression::isEnabled() && channels == 0){
+        auto compressed = std::make_shared<CompressedImage>();
+        if(texture_compression::read(filename, *compressed)){
+            image.size = compressed->size;
+            image.channels = 4;
+            image.pixels = nullptr;
+            image.compressed = std::move(compressed);
+            return true;
+        }
+    }
     glm::ivec2 size;
-    int channels;
+    int fileChannels;
     //Since OpenGL puts the texture origin at the bottom left while images typically has the origin at the top left,
     //We need to till stb to flip images vertically after loading them
-    stbi_set_flip_vertically_on_load(true);
+    //(the flag is set for the calling thread only, since the images can be decoded on many threads at once)
+    stbi_set_flip_vertically_on_load_thread(true);
     //Load image data and retrieve width, height and number of channels in the image
     //The last argument is the number of channels we want and it can have the following values:
     //- 0: Keep number of channels the same as in the image file
@@ -39,20 +85,111 @@ our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool
     //- 4: RGB and Alpha (RGBA)
     //Note: channels (the 4th argument) always returns the original number of channels in the file
     // pixels that constructs the texture we want to draw, also this will be sent to the GPU memory
-    unsigned char* pixels = stbi_load(filename.c_str(), &size.x, &size.y, &channels, 4);
+    // We keep the channels of the file by default, so a grey image takes a quarter of the memory of its RGBA expansion
+    unsigned char* pixels = stbi_load(filename.c_str(), &size.x, &size.y, &fileChannels, channels);
     if(pixels == nullptr){
         std::cerr << "Failed to load image: " << filename << std::endl;
-        return nullptr;
+        return false;
     }
-    // Create a texture
-    our::Texture2D* texture = new our::Texture2D();
+    image.size = size;
+    image.channels = channels != 0 ? channels : fileChannels;
+    image.pixels = std::shared_ptr<unsigned char>(pixels, stbi_image_free); //The image data is freed with the last copy of the image
+    image.compressed = nullptr;
+    return true;
+}
+
+bool our::texture_utils::isFormatSupported(CompressedFormat format) {
+    switch(format){
+        case CompressedFormat::BC1:
+        case CompressedFormat::BC3:
+            return GLAD_GL_EXT_texture_compression_s3tc;
+        case CompressedFormat::BC7:
+            // BPTC is core since OpenGL 4.2
+            return GLAD_GL_ARB_texture_compression_bptc || GLAD_GL_VERSION_4_2;
+        default:
+            return true;
+    }
+}
+
+// Uploads every level of a cooked texture to the given (bound) texture. The levels are sent as they are if the GPU supports their format,
+// otherwise they are decompressed to RGBA8 on the CPU (the texture still looks the same, it just takes 4 to 8 times the memory).
+static void uploadCompressedImage(our::Texture2D* texture, const our::CompressedImage& image, bool generate_mipmap) {
+    using namespace our;
+    GLenum internalFormat = 0;
+    switch(image.format){
+        case CompressedFormat::BC1: internalFormat = GL_COMPRESSED_RGB_S3TC_DXT1_EXT; break;
+        case CompressedFormat::BC3: internalFormat = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT; break;
+        case CompressedFormat::BC7: internalFormat = GL_COMPRESSED_RGBA_BPTC_UNORM; break;
+        default: break;
+    }
+    bool supported = internalFormat != 0 && texture_utils::isFormatSupported(image.format);
+    // Without mipmaps, only the first level is used
+    size_t levelCount = generate_mipmap ? image.levels.size() : 1;
+    if(supported){
+        size_t bytes = 0;
+        for(size_t level = 0; level < levelCount; level++) bytes += image.levels[level].size();
+        texture->allocate((GLsizei)levelCount, internalFormat, image.size, bytes);
+        for(size_t level = 0; level < levelCount; level++){
+            glm::ivec2 size = image.getLevelSize(level);
+            const std::vector<uint8_t>& data = image.levels[level];
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, size.x, size.y, internalFormat, (GLsizei)data.size(), data.data());
+        }
+        return;
+    }
+
+    // The levels are decompressed before the storage is allocated, so that only the levels that could be decompressed are allocated
+    // (the storage never has a level that the sampler could read without it being uploaded)
+    std::vector<std::vector<uint8_t>> levels;
+    for(size_t level = 0; level < levelCount; level++){
+        std::vector<uint8_t> pixels = texture_compression::decompressLevel(image.format, image.getLevelSize(level), image.levels[level]);
+        if(pixels.empty()){
+            std::cerr << "Failed to decompress level " << level << " of a " << texture_compression::getFormatName(image.format) << " texture" << std::endl;
+            break;
+        }
+        levels.push_back(std::move(pixels));
+    }
+    if(levels.empty()){
+        // Without its first level, the texture has nothing to show so it stays a grey pixel
+        texture_utils::fillPlaceholder(texture);
+        return;
+    }
+    texture->allocate((GLsizei)levels.size(), GL_RGBA8, image.size, getMipChainBytes(image.size, (GLsizei)levels.size(), 4));
+    for(size_t level = 0; level < levels.size(); level++){
+        glm::ivec2 size = image.getLevelSize(level);
+        glTexSubImage2D(GL_TEXTURE_2D, (GLint)level, 0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, levels[level].data());
+    }
+}
+
+void our::texture_utils::uploadImage(Texture2D* texture, const Image& image, bool generate_mipmap) {
     //Bind the texture such that we upload the image data to its storage
     if (texture) {
 		  texture->bind();
     }
+    if(image.compressed){
+        uploadCompressedImage(texture, *image.compressed, generate_mipmap);
+        texture->unbind();
+        return;
+    }
+    // The smallest sized format that holds the channels of the image, the missing channels are filled by the swizzle:
+    //  - grey (R8) is read as (r, r, r, 1) and grey & alpha (RG8) as (r, r, r, g)
+    //  - RGB8 is read with an alpha of 1 (RGB8 is used instead of SRGB8 since the shaders do their math on the stored values as they are)
+    const GLenum INTERNAL_FORMATS[4] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    const GLenum PIXEL_FORMATS[4] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    int channels = std::clamp(image.channels, 1, 4);
+    GLenum internalFormat = INTERNAL_FORMATS[channels - 1];
+    // Immutable storage needs the number of levels up front
+    GLsizei levels = generate_mipmap ? getMipLevelCount(image.size) : 1;
+    texture->allocate(levels, internalFormat, image.size, getMipChainBytes(image.size, levels, getBytesPerTexel(internalFormat)));
+    if(channels <= 2){
+        const GLint swizzle[4] = {GL_RED, GL_RED, GL_RED, channels == 1 ? GL_ONE : GL_GREEN};
+        glTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+    }
     //TODO: (Req 5) Finish this function to fill the texture with the data found in "pixels"
     //used to make a 2d matrix in the GPU memory to draw the given pixels
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.x, size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    // The rows of 1, 2 & 3 channel images are tightly packed, but OpenGL expects every row to start at a multiple of 4 bytes by default
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.size.x, image.size.y, PIXEL_FORMATS[channels - 1], GL_UNSIGNED_BYTE, image.pixels.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
 		// Check if we need to generate mipmaps for this texture
 		if (generate_mipmap) {
@@ -61,7 +198,119 @@ our::Texture2D* our::texture_utils::loadImage(const std::string& filename, bool
 
 		//Unbind the texture after uploading the data
 		texture->unbind();
+}
 
-    stbi_image_free(pixels); //Free image data after uploading to GPU
-    return texture;
-}
\ No newline at end of file
+void our::texture_utils::fillPlaceholder(Texture2D* texture) {
+    const unsigned char grey[4] = {128, 128, 128, 255};
+    texture->bind();
+    texture->allocate(1, GL_RGBA8, {1, 1}, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    texture->unbind();
+}
+
+our::texture_utils::Image our::texture_utils::resizeImage(const Image& image, glm::ivec2 size) {
+    // For every destination pixel along an axis, the source pixels it covers & their weights (the filter is computed once per axis)
+    struct Tap { int index; float weight; };
+    auto getTaps = [](int source, int destination){
+        std::vector<std::vector<Tap>> taps(destination);
+        float scale = (float)source / destination;
+        float radius = std::max(1.0f, scale);
+        for(int pixel = 0; pixel < destination; pixel++){
+            float center = (pixel + 0.5f) * scale - 0.5f;
+            float total = 0;
+            for(int sample = (int)std::ceil(center - radius); sample <= (int)std::floor(center + radius); sample++){
+                float weight = 1.0f - std::abs(sample - center) / radius;
+                if(weight <= 0) continue;
+                taps[pixel].push_back({std::clamp(sample, 0, source - 1), weight});
+                total += weight;
+            }
+            for(auto& tap : taps[pixel]) tap.weight /= total;
+        }
+        return taps;
+    };
+    auto horizontalTaps = getTaps(image.size.x, size.x), verticalTaps = getTaps(image.size.y, size.y);
+    int channels = image.channels;
+    const unsigned char* source = image.pixels.get();
+
+    // The filter is separable, so the rows are resized first then the columns
+    std::vector<unsigned char> rows((size_t)size.x * image.size.y * channels);
+    for(int y = 0; y < image.size.y; y++){
+        for(int x = 0; x < size.x; x++){
+            for(int channel = 0; channel < channels; channel++){
+                float value = 0;
+                for(const Tap& tap : horizontalTaps[x]) value += tap.weight * source[((size_t)y * image.size.x + tap.index) * channels + channel];
+                rows[((size_t)y * size.x + x) * channels + channel] = (unsigned char)std::clamp(value + 0.5f, 0.0f, 255.0f);
+            }
+        }
+    }
+    unsigned char* pixels = new unsigned char[(size_t)size.x * size.y * channels];
+    for(int y = 0; y < size.y; y++){
+        for(int x = 0; x < size.x; x++){
+            for(int channel = 0; channel < channels; channel++){
+                float value = 0;
+                for(const Tap& tap : verticalTaps[y]) value += tap.weight * rows[((size_t)tap.index * size.x + x) * channels + channel];
+                pixels[((size_t)y * size.x + x) * channels + channel] = (unsigned char)std::clamp(value + 0.5f, 0.0f, 255.0f);
+            }
+        }
+    }
+    Image resized;
+    resized.size = size;
+    resized.channels = channels;
+    resized.pixels = std::shared_ptr<unsigned char>(pixels, std::default_delete<unsigned char[]>());
+    return resized;
+}
+
+std::vector<our::texture_utils::Image> our::texture_utils::decodeArrayLayers(const std::vector<std::string>& filenames, glm::ivec2 size) {
+    // The layers of an array share one format, so they get an alpha channel only if one of the images has it
+    int channels = 3;
+    for(const std::string& filename : filenames){
+        int width, height, fileChannels;
+        if(stbi_info(filename.c_str(), &width, &height, &fileChannels) && (fileChannels == 2 || fileChannels == 4)) channels = 4;
+    }
+    std::vector<Image> layers(filenames.size());
+    for(size_t index = 0; index < filenames.size(); index++){
+        Image image;
+        if(decodeImage(filenames[index], image, channels)){
+            layers[index] = image.size == size ? image : resizeImage(image, size);
+        } else {
+            size_t byteCount = (size_t)size.x * size.y * channels;
+            unsigned char* grey = new unsigned char[byteCount];
+            std::fill(grey, grey + byteCount, (unsigned char)128);
+            layers[index].size = size;
+            layers[index].channels = channels;
+            layers[index].pixels = std::shared_ptr<unsigned char>(grey, std::default_delete<unsigned char[]>());
+        }
+    }
+    return layers;
+}
+
+void our::texture_utils::uploadArray(TextureArray* array, const std::vector<Image>& layers, bool generate_mipmap) {
+    if(layers.empty()) return;
+    glm::ivec2 size = layers[0].size;
+    int channels = layers[0].channels;
+    GLenum internalFormat = channels == 4 ? GL_RGBA8 : GL_RGB8;
+    GLsizei levels = generate_mipmap ? getMipLevelCount(size) : 1;
+    array->bind();
+    array->allocate(levels, internalFormat, size, (GLsizei)layers.size(), getMipChainBytes(size, levels, getBytesPerTexel(internalFormat)) * layers.size());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(size_t layer = 0; layer < layers.size(); layer++)
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)layer, size.x, size.y, 1, channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, layers[layer].pixels.get());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if(generate_mipmap) glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+    TextureArray::unbind();
+}
+
+our::TextureArray* our::texture_utils::loadArray(const std::vector<std::string>& filenames, glm::ivec2 size, bool generate_mipmap) {
+    TextureArray* array = new TextureArray();
+    uploadArray(array, decodeArrayLayers(filenames, size), generate_mipmap);
+    return array;
+}
+
+void our::texture_utils::fillArrayPlaceholder(TextureArray* array, int layerCount) {
+    std::vector<unsigned char> grey;
+    for(int layer = 0; layer < std::max(layerCount, 1); layer++) grey.insert(grey.end(), {128, 128, 128, 255});
+    array->bind();
+    array->allocate(1, GL_RGBA8, {1, 1}, std::max(layerCount, 1), grey.size());
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, 0, 1, 1, std::max(layerCount, 1), GL_RGBA, GL_UNSIGNED_BYTE, grey.data());
+    TextureArray::unbind();
+}
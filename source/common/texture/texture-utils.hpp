@@ -1,7 +1,11 @@
 #pragma once
 
 #include "texture2d.hpp"
+#include "texture-array.hpp"
+#include "texture-compression.hpp"
+#include <memory>
 #include <string>
+#include <vector>
 
 #include <glad/gl.h>
 #include <glm/vec2.hpp>
@@ -11,4 +15,44 @@ namespace our::texture_utils {
     Texture2D* empty(GLenum format, glm::ivec2 size);
     // This function loads an image and sends its data to the given Texture2D 
     Texture2D* loadImage(const std::string& filename, bool generate_mipmap = true);
+
+    // The pixels of a decoded image (8 bits per channel, the first row is the bottom row as OpenGL expects)
+    // The image keeps the channels of its file: 1 (grey), 2 (grey & alpha), 3 (RGB) or 4 (RGBA).
+    // If the image was read from a cooked texture (see "texture_compression"), "compressed" holds its mip chain instead of the pixels.
+    struct Image {
+        glm::ivec2 size = {0, 0};
+        int channels = 4;
+        std::shared_ptr<unsigned char> pixels;
+        std::shared_ptr<const CompressedImage> compressed;
+
+        // Returns the number of bytes that the upload sends to the GPU
+        size_t getByteCount() const { return compressed ? compressed->getByteCount() : (size_t)size.x * size.y * channels; }
+    };
+    // Decodes an image file without touching OpenGL, so it can be called from any thread. Returns false if the file could not be read.
+    // If the cooked textures are enabled and the image has an up to date cooked texture, the cooked texture is read instead
+    // (unless the channels are forced, since the pixels of a cooked texture are block compressed).
+    // "channels" forces the number of channels of the decoded pixels (0 keeps the channels of the file).
+    bool decodeImage(const std::string& filename, Image& image, int channels = 0);
+    // Sends the pixels of the image to the given texture (replacing whatever it held)
+    // The texture gets immutable storage with the smallest format that holds the channels of the image (R8, RG8, RGB8 or RGBA8),
+    // and the grey images are swizzled so that the shaders still read them as grey (not red) colors.
+    // A compressed image is uploaded as is with its own mip levels, or decompressed first if the GPU doesn't support its format.
+    void uploadImage(Texture2D* texture, const Image& image, bool generate_mipmap = true);
+    // Fills the given texture with a single grey pixel, it is shown until the real image is uploaded
+    void fillPlaceholder(Texture2D* texture);
+    // Resizes the pixels of an image (a tent filter that widens when shrinking, so every source pixel contributes)
+    Image resizeImage(const Image& image, glm::ivec2 size);
+
+    // Decodes the images of the layers of a texture array and resizes them to the size of the array, without touching OpenGL.
+    // The layers all get 3 channels, or 4 if any image has an alpha channel. A layer whose image could not be read is grey.
+    std::vector<Image> decodeArrayLayers(const std::vector<std::string>& filenames, glm::ivec2 size);
+    // Sends the layers to the given texture array (replacing whatever it held), they must all have the same size & channels
+    void uploadArray(TextureArray* array, const std::vector<Image>& layers, bool generate_mipmap = true);
+    // Decodes the images and creates a texture array from them
+    TextureArray* loadArray(const std::vector<std::string>& filenames, glm::ivec2 size, bool generate_mipmap = true);
+    // Fills every layer of the given texture array with a single grey pixel (see "fillPlaceholder")
+    void fillArrayPlaceholder(TextureArray* array, int layerCount);
+
+    // Returns true if the GPU can sample textures of the given compressed format
+    bool isFormatSupported(CompressedFormat format);
 }
\ No newline at end of file
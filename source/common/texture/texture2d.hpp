@@ -1,6 +1,11 @@
 #pragma once
 
 #include <glad/gl.h>
+#include <glm/vec2.hpp>
+#include <cstddef>
+
+#include "texture-storage.hpp"
+#include "../gl-state-cache.hpp"
 
 namespace our {
 
@@ -8,6 +13,8 @@ namespace our {
     class Texture2D {
         // The OpenGL object name of this texture 
         GLuint name = 0;
+        // The GPU memory taken by the storage of the texture in bytes (0 until the storage is allocated)
+        size_t byteCount = 0;
     public:
         // This constructor creates an OpenGL texture and saves its object name in the member variable "name" 
         Texture2D() {
@@ -19,6 +26,8 @@ namespace our {
         ~Texture2D() { 
             //TODO: (Req 5) Complete this function
 						glDeleteTextures(1, &name);
+						// OpenGL unbinds the deleted texture and could give its name to a new texture, so the cache must forget it
+						GLStateCache::get().forgetTexture(name);
         }
 
         // Get the internal OpenGL name of the texture which is useful for use with framebuffers
@@ -26,16 +35,34 @@ namespace our {
             return name;
         }
 
-        // This method binds this texture to GL_TEXTURE_2D
+        // Allocates immutable storage for the texture (every mip level at once, with a sized internal format) and remembers its size in bytes.
+        // Without immutable storage (OpenGL < 4.2), the levels are allocated one by one with the same format (see "texture_storage::allocate").
+        // The texture must be bound. Immutable storage can't be allocated twice, so a texture that already has storage (e.g. a placeholder)
+        // gets a new OpenGL texture first (the pointers to this object stay valid, only the name returned by "getOpenGLName" changes).
+        void allocate(GLsizei levels, GLenum internalFormat, glm::ivec2 size, size_t bytes) {
+            if(byteCount != 0){
+                glDeleteTextures(1, &name);
+                GLStateCache::get().forgetTexture(name);
+                glGenTextures(1, &name);
+                bind();
+            }
+            texture_storage::allocate(GL_TEXTURE_2D, levels, internalFormat, size);
+            byteCount = bytes;
+        }
+
+        // Returns the GPU memory taken by the texture in bytes (as computed from its format, drivers may pad some formats such as RGB8)
+        size_t getByteCount() const { return byteCount; }
+
+        // This method binds this texture to GL_TEXTURE_2D (through the state cache, so binding the texture that is already bound costs nothing)
         void bind() const {
             //TODO: (Req 5) Complete this function
-						glBindTexture(GL_TEXTURE_2D, name);
+						GLStateCache::get().bindTexture2D(name);
         }
 
         // This static method ensures that no texture is bound to GL_TEXTURE_2D
         static void unbind(){
             //TODO: (Req 5) Complete this function
-						glBindTexture(GL_TEXTURE_2D, 0);
+						GLStateCache::get().bindTexture2D(0);
         }
 
         Texture2D(const Texture2D&) = delete;
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace our {
+
+    // A fixed set of worker threads that run the submitted jobs in the order they were submitted.
+    // The jobs must not touch OpenGL (the context belongs to the main thread), they should only do CPU work such as decoding & parsing files.
+    class ThreadPool {
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+        std::mutex mutex;
+        std::condition_variable jobAvailable, jobsDone;
+        size_t runningJobs = 0;
+        bool stopping = false;
+
+        void work() {
+            while(true){
+                std::function<void()> job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    jobAvailable.wait(lock, [this]{ return stopping || !jobs.empty(); });
+                    if(jobs.empty()) return; // Only reached when stopping
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                    runningJobs++;
+                }
+                job();
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    runningJobs--;
+                    if(jobs.empty() && runningJobs == 0) jobsDone.notify_all();
+                }
+            }
+        }
+
+    public:
+        // Starts the given number of workers (0 means one per hardware thread, minus one for the main thread)
+        explicit ThreadPool(size_t threadCount = 0) {
+            if(threadCount == 0) threadCount = std::max(1u, std::thread::hardware_concurrency()) - 1;
+            threadCount = std::max<size_t>(threadCount, 1);
+            for(size_t index = 0; index < threadCount; index++)
+                workers.emplace_back([this]{ work(); });
+        }
+
+        // Finishes the submitted jobs then stops the workers
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            jobAvailable.notify_all();
+            for(auto& worker : workers) worker.join();
+        }
+
+        // Adds a job to the queue, it will run on the first free worker
+        void submit(std::function<void()> job) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobs.push_back(std::move(job));
+            }
+            jobAvailable.notify_one();
+        }
+
+        // Blocks until all the submitted jobs are done
+        void wait() {
+            std::unique_lock<std::mutex> lock(mutex);
+            jobsDone.wait(lock, [this]{ return jobs.empty() && runningJobs == 0; });
+        }
+
+        // Runs "job(index)" for every index in [0, count) on the workers and on the calling thread, and returns once they are all done.
+        // Unlike "wait", it only waits for its own indices, so other jobs can be running on the pool at the same time.
+        // Since the calling thread takes indices too, it makes progress even if every worker is busy.
+        void parallelFor(size_t count, const std::function<void(size_t)>& job) {
+            if(count == 0) return;
+            struct Batch {
+                std::atomic<size_t> next{0};
+                size_t done = 0;
+                std::mutex mutex;
+                std::condition_variable finished;
+            };
+            auto batch = std::make_shared<Batch>();
+            // A helper that starts after all the indices were taken returns without touching "job" (which may be gone by then)
+            auto run = [batch, count, &job]{
+                size_t finished = 0;
+                for(size_t index; (index = batch->next.fetch_add(1)) < count; finished++) job(index);
+                if(finished == 0) return;
+                std::lock_guard<std::mutex> lock(batch->mutex);
+                batch->done += finished;
+                if(batch->done == count) batch->finished.notify_all();
+            };
+            size_t helpers = std::min(count - 1, workers.size());
+            for(size_t helper = 0; helper < helpers; helper++) submit(run);
+            run();
+            std::unique_lock<std::mutex> lock(batch->mutex);
+            batch->finished.wait(lock, [&]{ return batch->done == count; });
+        }
+
+        // Returns the number of worker threads
+        size_t getThreadCount() const { return workers.size(); }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+    };
+
+    // A lock-free queue with many producers and a single consumer (Vyukov's intrusive MPSC queue with a stub node).
+    // Any thread can push without ever waiting for another, and only one thread (e.g. the OpenGL thread) may pop.
+    // A push costs one atomic exchange, so the workers hand their results over without fighting over a lock with the consumer.
+    template<typename T>
+    class MPSCQueue {
+        struct Node {
+            std::atomic<Node*> next{nullptr};
+            T value;
+        };
+        std::atomic<Node*> head; // The last pushed node (the producers' end)
+        Node* tail;              // The stub node that precedes the next node to pop (the consumer's end)
+    public:
+        MPSCQueue() {
+            tail = new Node();
+            head.store(tail, std::memory_order_relaxed);
+        }
+
+        ~MPSCQueue() {
+            T value;
+            while(pop(value));
+            delete tail;
+        }
+
+        // Can be called from any thread
+        void push(T value) {
+            Node* node = new Node();
+            node->value = std::move(value);
+            Node* previous = head.exchange(node, std::memory_order_acq_rel);
+            // Until this store, the consumer sees the queue as ending at "previous" (it will get the node in a later pop)
+            previous->next.store(node, std::memory_order_release);
+        }
+
+        // Must only be called from the consumer thread. Returns false if the queue is empty.
+        bool pop(T& value) {
+            Node* next = tail->next.load(std::memory_order_acquire);
+            if(!next) return false;
+            value = std::move(next->value);
+            // The popped node becomes the new stub
+            delete tail;
+            tail = next;
+            return true;
+        }
+
+        MPSCQueue(const MPSCQueue&) = delete;
+        MPSCQueue& operator=(const MPSCQueue&) = delete;
+    };
+
+}
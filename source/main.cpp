@@ -20,6 +20,14 @@
 #include "states/entity-test-state.hpp"
 #include "states/renderer-test-state.hpp"
 
+#include "states/uniform-benchmark-state.hpp"
+#include "states/light-benchmark-state.hpp"
+#include "states/collision-benchmark-state.hpp"
+#include "states/instancing-benchmark-state.hpp"
+#include "states/bvh-benchmark-state.hpp"
+#include "states/mesh-cache-benchmark-state.hpp"
+#include "states/obj-parser-benchmark-state.hpp"
+
 int main(int argc, char** argv) {
     
     flags::args args(argc, argv); // Parse the command line arguments
@@ -61,6 +69,15 @@ int main(int argc, char** argv) {
     app.registerState<EntityTestState>("entity-test");
     app.registerState<RendererTestState>("renderer-test");
 
+		// Benchmark states
+    app.registerState<UniformBenchmarkState>("uniform-benchmark");
+    app.registerState<LightBenchmarkState>("light-benchmark");
+    app.registerState<CollisionBenchmarkState>("collision-benchmark");
+    app.registerState<InstancingBenchmarkState>("instancing-benchmark");
+    app.registerState<BVHBenchmarkState>("bvh-benchmark");
+    app.registerState<MeshCacheBenchmarkState>("mesh-cache-benchmark");
+    app.registerState<ObjParserBenchmarkState>("obj-parser-benchmark");
+
     // Then choose the state to run based on the option "start-scene" in the config
     if(app_config.contains(std::string{"start-scene"})){
         app.changeState(app_config["start-scene"].get<std::string>());
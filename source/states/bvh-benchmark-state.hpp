@@ -0,0 +1,182 @@
+#pragma once
+
+#include <ecs/world.hpp>
+#include <systems/bvh.hpp>
+#include <systems/frustum-culling.hpp>
+#include <systems/spatial-hash.hpp>
+#include <application.hpp>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <vector>
+
+// This state is a benchmark for the bounding volume hierarchy (see "common/systems/bvh.hpp").
+// It builds a city of static boxes (buildings & poles) and a crowd of moving boxes, then for a number of frames it moves a camera
+// around the city and runs every kind of query both through the trees and the way they were done before:
+// 1- Frustum culling: walking the static tree vs testing every box with the frustum culler
+// 2- Box overlaps (the car box): the static tree vs the spatial hash vs testing every box
+// 3- Ray casts from the car: the static tree vs testing every box
+// 4- Moving boxes: refitting the dynamic tree vs rebuilding it every frame
+// It prints the build time, the average time per frame of every query, checks that both ways found the same results, then closes.
+class BVHBenchmarkState: public our::State {
+
+    our::World world;
+
+    using Clock = std::chrono::high_resolution_clock;
+    static double milliseconds(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    void onInitialize() override {
+        // First of all, we get the scene configuration from the app config
+        auto& config = getApp()->getConfig()["scene"];
+        int buildingCount = config.value("buildings", 10000);
+        int movingCount = config.value("moving", 1000);
+        float spacing = config.value("spacing", 22.0f);
+        int frames = config.value("frames", 300);
+        int raysPerFrame = config.value("rays", 64);
+        float cellSize = config.value("cell-size", 16.0f);
+
+        // Build the city: a square grid of buildings with varying footprints, and a street pole next to every building
+        std::vector<our::AABB> staticBounds;
+        int side = (int)std::ceil(std::sqrt((float)buildingCount));
+        for(int i = 0; i < buildingCount; i++){
+            glm::vec2 cell = glm::vec2(i % side, i / side) - (side - 1) * 0.5f;
+            glm::vec3 position(cell.x * spacing, 10, cell.y * spacing);
+            glm::vec3 size(6 + (i % 4), 10 + (i % 7), 6 + ((i / 4) % 4));
+            staticBounds.push_back({position - size, position + size});
+            glm::vec3 pole(cell.x * spacing + 10, 2, cell.y * spacing + 10);
+            staticBounds.push_back({pole - glm::vec3(0.2f, 2, 0.2f), pole + glm::vec3(0.2f, 2, 0.2f)});
+        }
+        float cityRadius = side * spacing * 0.5f;
+
+        // The build time is averaged over a few builds since a single build is short
+        our::BVH staticTree;
+        const int builds = 5;
+        auto buildStart = Clock::now();
+        for(int build = 0; build < builds; build++) staticTree.build(staticBounds);
+        double buildTime = milliseconds(buildStart, Clock::now()) / builds;
+
+        // The spatial hash stores entities, so every box gets an (empty) entity
+        our::SpatialHash hash(cellSize);
+        for(const our::AABB& bounds : staticBounds) hash.update(world.add(), bounds);
+
+        // The moving boxes walk on circles of different radii and speeds
+        std::vector<our::AABB> movingBounds(movingCount);
+        auto moveBoxes = [&](int frame){
+            for(int index = 0; index < movingCount; index++){
+                float radius = cityRadius * (0.1f + 0.9f * (index % 97) / 97.0f);
+                float angle = index * 0.37f + frame * 0.002f * (1 + index % 5);
+                glm::vec3 center(std::cos(angle) * radius, 1, std::sin(angle) * radius);
+                movingBounds[index] = {center - glm::vec3(1), center + glm::vec3(1)};
+            }
+        };
+        moveBoxes(0);
+        our::BVH dynamicTree, rebuiltTree;
+        dynamicTree.build(movingBounds);
+
+        our::FrustumCuller culler;
+        double treeCullTime = 0, linearCullTime = 0, treeOverlapTime = 0, hashOverlapTime = 0, linearOverlapTime = 0;
+        double treeRayTime = 0, linearRayTime = 0, refitTime = 0, rebuildTime = 0;
+        size_t treeVisible = 0, linearVisible = 0, treeOverlaps = 0, hashOverlaps = 0, linearOverlaps = 0, rayMismatches = 0, dynamicRebuilds = 0;
+        glm::mat4 projection = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, 300.0f);
+
+        for(int frame = 0; frame < frames; frame++){
+            // Drive the car on a circle that passes between (and through) the buildings, the camera follows it
+            float angle = 6.2831853f * frame / frames;
+            glm::vec3 car(std::cos(angle) * cityRadius * 0.6f, 1.12f, std::sin(angle) * cityRadius * 0.6f);
+            glm::vec3 heading(-std::sin(angle), 0, std::cos(angle));
+            glm::mat4 VP = projection * glm::lookAt(car - heading * 8.0f + glm::vec3(0, 6, 0), car + heading * 20.0f, glm::vec3(0, 1, 0));
+            our::Frustum frustum = our::Frustum::fromMatrix(VP);
+
+            // 1- Frustum culling (the linear culler fills its boxes every frame like the renderer used to do for every mesh)
+            auto start = Clock::now();
+            staticTree.cull(frustum, [&](uint32_t){ treeVisible++; });
+            auto middle = Clock::now();
+            culler.clear();
+            for(const our::AABB& bounds : staticBounds) culler.add(bounds, glm::mat4(1.0f));
+            linearVisible += culler.cull(frustum);
+            auto end = Clock::now();
+            treeCullTime += milliseconds(start, middle);
+            linearCullTime += milliseconds(middle, end);
+
+            // 2- Box overlaps
+            our::AABB carBounds = {car - glm::vec3(1.5f, 1, 1.5f), car + glm::vec3(1.5f, 1, 1.5f)};
+            start = Clock::now();
+            staticTree.query(carBounds, [&](uint32_t){ treeOverlaps++; });
+            middle = Clock::now();
+            hash.query(carBounds, [&](our::Entity*, const our::AABB& bounds){ if(carBounds.overlaps(bounds)) hashOverlaps++; });
+            auto last = Clock::now();
+            for(const our::AABB& bounds : staticBounds) if(carBounds.overlaps(bounds)) linearOverlaps++;
+            end = Clock::now();
+            treeOverlapTime += milliseconds(start, middle);
+            hashOverlapTime += milliseconds(middle, last);
+            linearOverlapTime += milliseconds(last, end);
+
+            // 3- Ray casts in a fan around the car
+            for(int ray = 0; ray < raysPerFrame; ray++){
+                float rayAngle = angle + 6.2831853f * ray / raysPerFrame;
+                our::Ray cast = {car, glm::vec3(std::cos(rayAngle), -0.02f, std::sin(rayAngle))};
+                float maxDistance = 200.0f;
+                start = Clock::now();
+                float treeDistance = staticTree.raycast(cast, maxDistance, [](uint32_t, float distance, float){ return distance; });
+                middle = Clock::now();
+                float linearDistance = maxDistance;
+                glm::vec3 inverseDirection = 1.0f / cast.direction;
+                for(const our::AABB& bounds : staticBounds){
+                    float distance = our::BVH::intersect(cast, inverseDirection, bounds.min, bounds.max, linearDistance);
+                    if(distance >= 0.0f && distance < linearDistance) linearDistance = distance;
+                }
+                end = Clock::now();
+                treeRayTime += milliseconds(start, middle);
+                linearRayTime += milliseconds(middle, end);
+                if(treeDistance != linearDistance) rayMismatches++;
+            }
+
+            // 4- Moving boxes (the refitted tree is rebuilt when it gets too loose, like the crashing system does)
+            moveBoxes(frame + 1);
+            start = Clock::now();
+            dynamicTree.refit(movingBounds);
+            if(dynamicTree.getQuality() > 1.5f){
+                dynamicTree.build(movingBounds);
+                dynamicRebuilds++;
+            }
+            middle = Clock::now();
+            rebuiltTree.build(movingBounds);
+            end = Clock::now();
+            refitTime += milliseconds(start, middle);
+            rebuildTime += milliseconds(middle, end);
+        }
+
+        std::cout << "BVH benchmark (" << staticBounds.size() << " static boxes, " << movingCount << " moving boxes, " << frames << " frames, "
+                  << raysPerFrame << " rays/frame)" << std::endl;
+        std::cout << "  static build            : " << buildTime << " ms (" << staticTree.getNodeCount() << " nodes)" << std::endl;
+        std::cout << "  frustum culling  tree   : " << treeCullTime / frames << " ms/frame" << std::endl;
+        std::cout << "                   linear : " << linearCullTime / frames << " ms/frame ("
+                  << (treeVisible == linearVisible ? "match" : "MISMATCH") << ", " << (double)treeVisible / frames << " visible/frame)" << std::endl;
+        std::cout << "  box overlaps     tree   : " << treeOverlapTime / frames << " ms/frame" << std::endl;
+        std::cout << "                   hash   : " << hashOverlapTime / frames << " ms/frame" << std::endl;
+        std::cout << "                   linear : " << linearOverlapTime / frames << " ms/frame ("
+                  << (treeOverlaps == linearOverlaps && hashOverlaps == linearOverlaps ? "match" : "MISMATCH") << ")" << std::endl;
+        std::cout << "  ray casts        tree   : " << treeRayTime / frames << " ms/frame" << std::endl;
+        std::cout << "                   linear : " << linearRayTime / frames << " ms/frame ("
+                  << (rayMismatches == 0 ? "match" : "MISMATCH") << ")" << std::endl;
+        std::cout << "  moving boxes     refit  : " << refitTime / frames << " ms/frame (" << dynamicRebuilds << " rebuilds, quality "
+                  << dynamicTree.getQuality() << ")" << std::endl;
+        std::cout << "                   rebuild: " << rebuildTime / frames << " ms/frame" << std::endl;
+
+        // The benchmark is done, no need to keep the window open
+        getApp()->close();
+    }
+
+    void onDraw(double deltaTime) override {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    void onDestroy() override {
+        world.clear();
+    }
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <ecs/world.hpp>
+#include <systems/spatial-hash.hpp>
+#include <components/collider.hpp>
+#include <application.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// This state is a benchmark for the collision broad-phase of the crashing system.
+// It fills a world with a city of buildings (and a few entities of other kinds) then drives a car box around it for a number of frames.
+// In every frame, it finds the buildings the car crashes into in two ways:
+// 1- Scanning all the entities and comparing their names (how the crashing system used to work)
+// 2- Querying the spatial hash of the collider bounds then testing only the candidates whose layers match (how the crashing system works now)
+// It prints the average collision time per frame of both, checks that they found the same crashes, then closes.
+class CollisionBenchmarkState: public our::State {
+
+    our::World world;
+
+    // Returns the crash box of a building the way the crashing system used to compute it (from the scale, patched by the name)
+    static our::AABB getBuildingBounds(our::Entity* entity) {
+        glm::vec3 position = entity->localTransform.getPosition();
+        glm::vec3 size = entity->localTransform.getScale() + glm::vec3(0.2, 0, 0.2);
+        return {position - size, position + size};
+    }
+
+    void onInitialize() override {
+        // First of all, we get the scene configuration from the app config
+        auto& config = getApp()->getConfig()["scene"];
+        int buildingCount = config.value("buildings", 10000);
+        float spacing = config.value("spacing", 22.0f);
+        int frames = config.value("frames", 1000);
+        float cellSize = config.value("cell-size", 16.0f);
+
+        // Build the city: a square grid of buildings with varying footprints, plus some poles & lights that are not buildings
+        int side = (int)std::ceil(std::sqrt((float)buildingCount));
+        for(int i = 0; i < buildingCount; i++){
+            glm::vec2 cell = glm::vec2(i % side, i / side) - (side - 1) * 0.5f;
+            our::Entity* building = world.add();
+            building->setName("building");
+            building->localTransform.setPosition(glm::vec3(cell.x * spacing, 10, cell.y * spacing));
+            building->localTransform.setScale(glm::vec3(6 + (i % 4), 10, 6 + ((i / 4) % 4)));
+            our::ColliderComponent* collider = building->addComponent<our::ColliderComponent>();
+            collider->deserialize({{"padding", {0.2, 0, 0.2}}, {"layer", "building"}, {"collidesWith", {"car"}}, {"static", true}});
+            // Every building has a street pole next to it
+            our::Entity* pole = world.add();
+            pole->setName("StreetPole");
+            pole->localTransform.setPosition(glm::vec3(cell.x * spacing + 10, 0, cell.y * spacing + 10));
+        }
+        our::Entity* car = world.add();
+        car->setName("car");
+        our::ColliderComponent* carCollider = car->addComponent<our::ColliderComponent>();
+        carCollider->deserialize({{"layer", "car"}});
+
+        our::SpatialHash colliders(cellSize);
+        for(auto [entity, collider] : world.query<our::ColliderComponent>())
+            if(collider != carCollider) colliders.update(entity, collider->getWorldBounds());
+
+        // The names checked by the crashing system before it reached the buildings
+        const std::string names[] = {"car", "delivery", "knife", "arrow", "StreetPole", "battery", "building"};
+
+        double bruteForceTime = 0, broadPhaseTime = 0;
+        size_t bruteForceCrashes = 0, broadPhaseCrashes = 0, candidates = 0;
+        float radius = side * spacing * 0.3f;
+        for(int frame = 0; frame < frames; frame++){
+            // Drive the car on a circle that passes between (and through) the buildings
+            float angle = 6.2831853f * frame / frames;
+            car->localTransform.setPosition(glm::vec3(std::cos(angle) * radius, 1.12f, std::sin(angle) * radius));
+            our::AABB carBounds = {car->localTransform.getPosition() - car->localTransform.getScale(), car->localTransform.getPosition() + car->localTransform.getScale()};
+
+            auto start = std::chrono::high_resolution_clock::now();
+            for(auto entity : world.getEntities()){
+                // Like the old crashing system, every entity is compared against the names one by one
+                for(const std::string& name : names){
+                    if(entity->name != name) continue;
+                    if(name == "building" && carBounds.overlaps(getBuildingBounds(entity))) bruteForceCrashes++;
+                    break;
+                }
+            }
+            auto middle = std::chrono::high_resolution_clock::now();
+            colliders.query(carCollider->getWorldBounds(), [&](our::Entity* entity, const our::AABB&){
+                our::ColliderComponent* collider = entity->getComponent<our::ColliderComponent>();
+                if(!carCollider->canCollideWith(collider)) return;
+                candidates++;
+                if(carCollider->intersects(collider)) broadPhaseCrashes++;
+            });
+            auto end = std::chrono::high_resolution_clock::now();
+
+            bruteForceTime += std::chrono::duration<double, std::milli>(middle - start).count();
+            broadPhaseTime += std::chrono::duration<double, std::milli>(end - middle).count();
+        }
+
+        std::cout << "Collision benchmark (" << world.getEntities().size() << " entities, " << buildingCount << " buildings, "
+                  << frames << " frames, " << colliders.getCellCount() << " cells of " << cellSize << "m)" << std::endl;
+        std::cout << "  name scan + box tests   : " << bruteForceTime / frames << " ms/frame" << std::endl;
+        std::cout << "  spatial hash + box tests: " << broadPhaseTime / frames << " ms/frame ("
+                  << (double)candidates / frames << " candidates/frame)" << std::endl;
+        std::cout << "  crashes found           : " << bruteForceCrashes << " vs " << broadPhaseCrashes
+                  << (bruteForceCrashes == broadPhaseCrashes ? " (match)" : " (MISMATCH)") << std::endl;
+
+        // The benchmark is done, no need to keep the window open
+        getApp()->close();
+    }
+
+    void onDraw(double deltaTime) override {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    void onDestroy() override {
+        world.clear();
+    }
+};
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <asset-loader.hpp>
+#include <ecs/world.hpp>
+#include <systems/forward-renderer.hpp>
+#include <application.hpp>
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+
+// This state is a benchmark for the instanced draw calls of the forward renderer.
+// It loads the world from the config then fills a square city with buildings that share the same mesh & material.
+// It renders a number of frames with instancing, then the same number of frames without it (one draw call per building),
+// and prints the average frame time & draw calls of both before it closes.
+class InstancingBenchmarkState: public our::State {
+
+    our::World world;
+    our::ForwardRenderer renderer;
+
+    int frames = 0, frame = 0;
+    // The measurements of the two runs: 0 = instanced, 1 = one draw call per object
+    double totalFrameTime[2] = {0, 0};
+    size_t totalDrawCalls[2] = {0, 0};
+
+    void onInitialize() override {
+        // First of all, we get the scene configuration from the app config
+        auto& config = getApp()->getConfig()["scene"];
+        // If we have assets in the scene config, we deserialize them
+        if(config.contains("assets")){
+            our::deserializeAllAssets(config["assets"]);
+        }
+        // If we have a world in the scene config, we use it to populate our world
+        if(config.contains("world")){
+            world.deserialize(config["world"]);
+        }
+
+        // Then we add the buildings in a square grid around the origin
+        int buildingCount = config.value("buildings", 10000);
+        float spacing = config.value("spacing", 4.0f);
+        int side = (int)std::ceil(std::sqrt((float)buildingCount));
+        for(int i = 0; i < buildingCount; i++){
+            glm::vec2 cell = (glm::vec2(i % side, i / side) - (side - 1) * 0.5f) * spacing;
+            float height = 1.0f + (i * 7 % 5) * 0.5f;
+            our::Entity* building = world.add();
+            building->deserialize({
+                {"name", "building"},
+                {"position", {cell.x, height, cell.y}},
+                {"scale", {1.2, height, 1.2}},
+                {"components", {{{"type", "Mesh Renderer"}, {"mesh", "cube"}, {"material", "building"}}}}
+            });
+        }
+
+        frames = config.value("frames", 300);
+        glm::ivec2 size = getApp()->getFrameBufferSize();
+        renderer.initialize(size, config["renderer"]);
+    }
+
+    void onDraw(double deltaTime) override {
+        // The first half of the frames is instanced, the second half is not (each half starts with 10 warmup frames)
+        int run = frame < frames + 10 ? 0 : 1;
+        renderer.setInstancing(run == 0);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        renderer.render(&world);
+        // Wait for the GPU so that the measured time includes the drawing
+        glFinish();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        int runFrame = ++frame - run * (frames + 10);
+        if(runFrame > 10){
+            totalFrameTime[run] += std::chrono::duration<double, std::milli>(end - start).count();
+            totalDrawCalls[run] += renderer.getStatistics().drawCalls;
+        }
+
+        if(frame >= 2 * (frames + 10)){
+            std::cout << "Instancing benchmark (" << renderer.getVisibleCount() << " visible objects, " << frames << " frames)" << std::endl;
+            std::cout << "  instanced : " << totalFrameTime[0] / frames << " ms (" << (double)totalDrawCalls[0] / frames << " draw calls)" << std::endl;
+            std::cout << "  one by one: " << totalFrameTime[1] / frames << " ms (" << (double)totalDrawCalls[1] / frames << " draw calls)" << std::endl;
+            std::cout << "  frame ring: " << renderer.getFrameRing().getRegionSize() / 1024 << " KB per frame, "
+                      << renderer.getFrameRing().getStallCount() << " stalls" << std::endl;
+            getApp()->close();
+        }
+    }
+
+    void onDestroy() override {
+        renderer.destroy();
+        world.clear();
+        our::clearAllAssets();
+    }
+};
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <asset-loader.hpp>
+#include <ecs/world.hpp>
+#include <systems/forward-renderer.hpp>
+#include <application.hpp>
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+// This state is a benchmark for the clustered forward lighting.
+// It loads the world from the config then scatters a grid of point & spot lights over it
+// and renders a number of frames while measuring the frame time and the time spent assigning the lights to the clusters.
+// When it is done, it prints the averages and closes.
+class LightBenchmarkState: public our::State {
+
+    our::World world;
+    our::ForwardRenderer renderer;
+
+    int frames = 0, frame = 0;
+    double totalFrameTime = 0, totalBuildTime = 0;
+    size_t totalAssignments = 0;
+    size_t totalDrawCalls = 0, totalShaderSwitches = 0, totalMaterialSwitches = 0;
+    size_t totalIssuedStateCalls = 0, totalElidedStateCalls = 0, totalStreamedBytes = 0;
+
+    // Creates the json of a light entity at the given position (every other light is a spot light pointing down)
+    static nlohmann::json generateLight(glm::vec3 position, bool spot, float range) {
+        // The light falls to ~1/64 of its intensity at "range" meters
+        float quadratic = 64.0f / (range * range);
+        nlohmann::json light = {
+            {"type", "Light"},
+            {"lightType", spot ? "spot" : "point"},
+            {"direction", {0, -1, 0}},
+            {"diffuse", {0.6, 0.5, 0.35}},
+            {"specular", {0.6, 0.6, 0.6}},
+            {"attenuation", {quadratic, 0, 1}},
+            {"cone_angles", {0.6, 0.9}}
+        };
+        return {
+            {"name", spot ? "SpotLight" : "PointLight"},
+            {"position", {position.x, position.y, position.z}},
+            {"components", nlohmann::json::array({light})}
+        };
+    }
+
+    void onInitialize() override {
+        // First of all, we get the scene configuration from the app config
+        auto& config = getApp()->getConfig()["scene"];
+        // If we have assets in the scene config, we deserialize them
+        if(config.contains("assets")){
+            our::deserializeAllAssets(config["assets"]);
+        }
+        // If we have a world in the scene config, we use it to populate our world
+        if(config.contains("world")){
+            world.deserialize(config["world"]);
+        }
+
+        // Then we add the lights in a square grid that covers "area" meters around the origin
+        int lightCount = config.value("lights", 512);
+        float area = config.value("area", 200.0f);
+        float range = config.value("range", 12.0f);
+        int side = (int)std::ceil(std::sqrt((float)lightCount));
+        for(int i = 0; i < lightCount; i++){
+            glm::vec2 cell = glm::vec2(i % side, i / side) + 0.5f;
+            glm::vec2 position = (cell / (float)side - 0.5f) * area;
+            our::Entity* entity = world.add();
+            entity->deserialize(generateLight({position.x, 4.0f, position.y}, i % 2 == 1, range));
+        }
+
+        frames = config.value("frames", 300);
+        glm::ivec2 size = getApp()->getFrameBufferSize();
+        renderer.initialize(size, config["renderer"]);
+    }
+
+    void onDraw(double deltaTime) override {
+        our::GLStateCache::get().resetCounters();
+        auto start = std::chrono::high_resolution_clock::now();
+        renderer.render(&world);
+        // Wait for the GPU so that the measured time includes the shading
+        glFinish();
+        auto end = std::chrono::high_resolution_clock::now();
+
+        // The first frames are skipped since they include the driver warmup
+        if(++frame <= 10) return;
+        const our::LightClusters& clusters = renderer.getLightClusters();
+        totalFrameTime += std::chrono::duration<double, std::milli>(end - start).count();
+        totalBuildTime += clusters.getBuildTime();
+        totalAssignments += clusters.getAssignmentCount();
+        const our::RenderStatistics& statistics = renderer.getStatistics();
+        totalDrawCalls += statistics.drawCalls;
+        totalShaderSwitches += statistics.shaderSwitches;
+        totalMaterialSwitches += statistics.materialSwitches;
+        totalStreamedBytes += statistics.streamedBytes;
+        totalIssuedStateCalls += our::GLStateCache::get().getCounters().issued;
+        totalElidedStateCalls += our::GLStateCache::get().getCounters().elided;
+
+        if(frame - 10 >= frames){
+            glm::ivec3 clusterCount = clusters.getClusterCount();
+            std::cout << "Light benchmark (" << clusters.getLightCount() << " lights, "
+                      << clusterCount.x << "x" << clusterCount.y << "x" << clusterCount.z << " clusters, " << frames << " frames)" << std::endl;
+            std::cout << "  frame time            : " << totalFrameTime / frames << " ms" << std::endl;
+            std::cout << "  light assignment time : " << totalBuildTime / frames << " ms" << std::endl;
+            std::cout << "  lights per cluster    : " << (double)totalAssignments / frames / (clusterCount.x * clusterCount.y * clusterCount.z) << std::endl;
+            std::cout << "  draw calls            : " << (double)totalDrawCalls / frames
+                      << " (" << (double)totalShaderSwitches / frames << " shader switches, "
+                      << (double)totalMaterialSwitches / frames << " material switches)" << std::endl;
+            std::cout << "  GL state calls        : " << (double)totalIssuedStateCalls / frames << " issued, "
+                      << (double)totalElidedStateCalls / frames << " skipped by the state cache" << std::endl;
+            std::cout << "  streamed data         : " << (double)totalStreamedBytes / frames / 1024 << " KB ("
+                      << renderer.getFrameRing().getStallCount() << " stalls, "
+                      << (renderer.getFrameRing().isPersistent() ? "persistent mapping" : "mapped every frame") << ")" << std::endl;
+            getApp()->close();
+        }
+    }
+
+    void onDestroy() override {
+        renderer.destroy();
+        world.clear();
+        our::clearAllAssets();
+    }
+};
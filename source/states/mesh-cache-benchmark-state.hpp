@@ -0,0 +1,81 @@
+#pragma once
+
+#include <application.hpp>
+#include <mesh/mesh-utils.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+// This state is a benchmark for the binary mesh cache (see "common/mesh/mesh-cache.hpp").
+// For every ".obj" model in a directory, it measures the average time to parse the text file (what "loadOBJ" did on every launch)
+// and the time to read its binary cache, checks that both give the same vertices & elements, then closes.
+// The measured times only include the CPU work, since the upload to the GPU is the same in both cases.
+class MeshCacheBenchmarkState: public our::State {
+
+    using Clock = std::chrono::high_resolution_clock;
+    static double milliseconds(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    void onInitialize() override {
+        // First of all, we get the scene configuration from the app config
+        auto& config = getApp()->getConfig()["scene"];
+        std::string directory = config.value("directory", "assets/models");
+        int repeats = std::max(1, config.value("repeats", 10));
+
+        std::vector<std::string> models;
+        std::error_code error;
+        for(const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+            if(entry.is_regular_file() && entry.path().extension() == ".obj") models.push_back(entry.path().generic_string());
+
+        std::cout << "Mesh cache benchmark (" << models.size() << " models in \"" << directory << "\", " << repeats << " repeats)" << std::endl;
+        double totalParseTime = 0, totalWriteTime = 0, totalReadTime = 0;
+        size_t totalSourceBytes = 0, totalCacheBytes = 0;
+        bool allMatch = true;
+        for(const std::string& path : models){
+            std::vector<our::Vertex> parsedVertices, cachedVertices;
+            std::vector<GLuint> parsedElements, cachedElements;
+            std::vector<our::Submesh> submeshes;
+
+            auto start = Clock::now();
+            for(int repeat = 0; repeat < repeats; repeat++){
+                parsedVertices.clear(); parsedElements.clear(); submeshes.clear();
+                our::mesh_utils::parseOBJ(path, parsedVertices, parsedElements, &submeshes);
+            }
+            double parseTime = milliseconds(start, Clock::now()) / repeats;
+
+            start = Clock::now();
+            bool written = our::mesh_cache::write(path, parsedVertices, parsedElements, submeshes);
+            double writeTime = milliseconds(start, Clock::now());
+
+            bool read = written;
+            start = Clock::now();
+            for(int repeat = 0; read && repeat < repeats; repeat++)
+                read = our::mesh_cache::read(path, cachedVertices, cachedElements);
+            double readTime = milliseconds(start, Clock::now()) / repeats;
+
+            bool match = read && parsedVertices == cachedVertices && parsedElements == cachedElements;
+            allMatch = allMatch && match;
+            totalParseTime += parseTime; totalWriteTime += writeTime; totalReadTime += readTime;
+            totalSourceBytes += std::filesystem::file_size(path, error);
+            if(written) totalCacheBytes += std::filesystem::file_size(our::mesh_cache::getPath(path), error);
+
+            std::cout << "  " << path << ": parse " << parseTime << " ms, cache read " << readTime << " ms (write " << writeTime << " ms, "
+                      << parsedVertices.size() << " vertices, " << parsedElements.size() << " elements, " << (match ? "match" : "MISMATCH") << ")" << std::endl;
+        }
+        std::cout << "  total: parse " << totalParseTime << " ms, cache read " << totalReadTime << " ms ("
+                  << (totalReadTime > 0 ? totalParseTime / totalReadTime : 0) << "x faster), write " << totalWriteTime << " ms" << std::endl;
+        std::cout << "  size : " << totalSourceBytes / 1024 << " KB of .obj, " << totalCacheBytes / 1024 << " KB of cache ("
+                  << (allMatch ? "match" : "MISMATCH") << ")" << std::endl;
+
+        // The benchmark is done, no need to keep the window open
+        getApp()->close();
+    }
+
+    void onDraw(double deltaTime) override {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+};
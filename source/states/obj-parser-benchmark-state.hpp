@@ -0,0 +1,120 @@
+#pragma once
+
+#include <application.hpp>
+#include <mesh/mesh-utils.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// This state is a benchmark for the parallel OBJ parser (see "mesh_utils::parseOBJ").
+// It parses every ".obj" model in a directory and a big generated model, both with Tiny OBJ Loader (the old single threaded loader)
+// and with the parallel parser, checks that both give the same vertices & elements, prints the average times, then closes.
+class ObjParserBenchmarkState: public our::State {
+
+    using Clock = std::chrono::high_resolution_clock;
+    static double milliseconds(Clock::time_point start, Clock::time_point end) {
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+
+    // Writes a terrain-like grid of about "megabytes" MB: it has positions, texture coordinates & normals, a mix of triangles & quads,
+    // relative indices and a new object every few rows (like the models exported by Blender)
+    static bool writeSyntheticOBJ(const std::string& path, size_t megabytes) {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if(!file) return false;
+        const int columns = 512;
+        size_t targetBytes = megabytes * 1024 * 1024;
+        int row = 0;
+        file << "# Synthetic model for the obj parser benchmark\n";
+        while((size_t)file.tellp() < targetBytes){
+            if(row % 64 == 0) file << "o strip_" << row / 64 << "\n";
+            // A row of vertices (the heights repeat so that many vertices are shared)
+            for(int column = 0; column <= columns; column++){
+                float height = std::round(std::sin(column * 0.1f) * std::cos(row * 0.1f) * 16.0f) / 16.0f;
+                file << "v " << column << " " << height << " " << row << "\n";
+                file << "vt " << column / (float)columns << " " << (row % 16) / 16.0f << "\n";
+                file << "vn 0 1 0\n";
+            }
+            // Faces between this row and the previous one, using relative indices
+            if(row > 0){
+                int stride = columns + 1;
+                for(int column = 0; column < columns; column++){
+                    int a = -2 * stride + column, b = a + 1, c = -stride + column + 1, d = -stride + column;
+                    if(column % 2 == 0){
+                        file << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " "
+                             << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+                    } else {
+                        file << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " " << c << "/" << c << "/" << c << "\n";
+                        file << "f " << a << "/" << a << "/" << a << " " << c << "/" << c << "/" << c << " " << d << "/" << d << "/" << d << "\n";
+                    }
+                }
+            }
+            row++;
+        }
+        return (bool)file;
+    }
+
+    void onInitialize() override {
+        // First of all, we get the scene configuration from the app config
+        auto& config = getApp()->getConfig()["scene"];
+        std::string directory = config.value("directory", "assets/models");
+        int repeats = std::max(1, config.value("repeats", 5));
+        size_t syntheticMegabytes = config.value("synthetic-megabytes", 100);
+
+        std::vector<std::string> models;
+        std::error_code error;
+        for(const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+            if(entry.is_regular_file() && entry.path().extension() == ".obj") models.push_back(entry.path().generic_string());
+        std::sort(models.begin(), models.end());
+
+        std::string syntheticPath;
+        if(syntheticMegabytes > 0){
+            syntheticPath = (std::filesystem::temp_directory_path(error) / "obj-parser-benchmark.obj").string();
+            if(writeSyntheticOBJ(syntheticPath, syntheticMegabytes)) models.push_back(syntheticPath);
+            else std::cerr << "Failed to write the synthetic model to: " << syntheticPath << std::endl;
+        }
+
+        std::cout << "OBJ parser benchmark (" << models.size() << " models, " << repeats << " repeats)" << std::endl;
+        bool allMatch = true;
+        for(const std::string& path : models){
+            std::vector<our::Vertex> referenceVertices, vertices;
+            std::vector<GLuint> referenceElements, elements;
+            // The big model is only parsed once by each parser
+            int modelRepeats = path == syntheticPath ? 1 : repeats;
+
+            auto start = Clock::now();
+            for(int repeat = 0; repeat < modelRepeats; repeat++){
+                referenceVertices.clear(); referenceElements.clear();
+                our::mesh_utils::parseOBJWithTinyObj(path, referenceVertices, referenceElements);
+            }
+            double referenceTime = milliseconds(start, Clock::now()) / modelRepeats;
+
+            start = Clock::now();
+            for(int repeat = 0; repeat < modelRepeats; repeat++){
+                vertices.clear(); elements.clear();
+                our::mesh_utils::parseOBJ(path, vertices, elements);
+            }
+            double time = milliseconds(start, Clock::now()) / modelRepeats;
+
+            bool match = referenceVertices == vertices && referenceElements == elements;
+            allMatch = allMatch && match;
+            std::cout << "  " << path << " (" << std::filesystem::file_size(path, error) / 1024 << " KB): tiny obj " << referenceTime
+                      << " ms, parallel " << time << " ms (" << (time > 0 ? referenceTime / time : 0) << "x, " << vertices.size() << " vertices, "
+                      << elements.size() << " elements, " << (match ? "match" : "MISMATCH") << ")" << std::endl;
+        }
+        std::cout << "  " << (allMatch ? "all models match" : "MISMATCH") << std::endl;
+
+        if(!syntheticPath.empty()) std::filesystem::remove(syntheticPath, error);
+
+        // The benchmark is done, no need to keep the window open
+        getApp()->close();
+    }
+
+    void onDraw(double deltaTime) override {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+};
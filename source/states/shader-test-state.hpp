@@ -54,12 +54,13 @@ class ShaderTestState: public our::State {
         glClear(GL_COLOR_BUFFER_BIT);
         // Use the shader then draw the mesh
         shader->use();
-        glBindVertexArray(vertex_array);
+        our::GLStateCache::get().bindVertexArray(vertex_array);
         glDrawArrays(GL_TRIANGLES, 0, 3);
     }
 
     void onDestroy() override {
         delete shader;
+        our::GLStateCache::get().forgetVertexArray(vertex_array);
         glDeleteVertexArrays(1, &vertex_array);
     }
 };
\ No newline at end of file
@@ -44,7 +44,7 @@ class TextureTestState: public our::State {
         glClear(GL_COLOR_BUFFER_BIT);
         shader->use();
         // Here we set the active texture unit to 0 then bind the texture to it
-        glActiveTexture(GL_TEXTURE0);
+        our::GLStateCache::get().activeTexture(0);
         if (texture) {
             texture->bind();
         }
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <shader/shader.hpp>
+#include <application.hpp>
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// This state is a microbenchmark that compares the different ways to set uniforms:
+// 1- Asking the driver for the location on every call (how ShaderProgram::set used to work)
+// 2- Building the uniform name string on every call then looking it up in the cached uniform table
+// 3- Looking up prebuilt names in the cached uniform table
+// 4- Using pre-resolved uniform handles (no lookup at all)
+// It sets the material samplers of the lit shader for a number of draws (like the forward renderer does for every lit draw),
+// prints the timings and closes. (The lights are not set by name anymore since they live in a uniform buffer.)
+class UniformBenchmarkState: public our::State {
+
+    our::ShaderProgram* shader;
+
+    // Runs the given function "iterations" times and returns the average time of a single uniform set in nanoseconds
+    static double measure(int iterations, int setsPerIteration, const std::function<void()>& function) {
+        auto start = std::chrono::high_resolution_clock::now();
+        for(int iteration = 0; iteration < iterations; iteration++) function();
+        glFinish();
+        auto end = std::chrono::high_resolution_clock::now();
+        double totalNs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+        return totalNs / ((double)iterations * setsPerIteration);
+    }
+
+    void onInitialize() override {
+        // First of all, we get the scene configuration from the app config
+        auto& config = getApp()->getConfig()["scene"];
+        int iterations = config.value("iterations", 1000);
+        int drawCount = config.value("draws", 30);
+
+        shader = new our::ShaderProgram();
+        shader->setDefines(config.value("defines", our::ShaderDefines()));
+        shader->attach(config.value("vertex-shader", "assets/shaders/lighted.vert"), GL_VERTEX_SHADER);
+        shader->attach(config.value("fragment-shader", "assets/shaders/lighted.frag"), GL_FRAGMENT_SHADER);
+        shader->link();
+        shader->use();
+
+        const char* attributes[] = {"albedo", "specular", "roughness", "ambient_occlusion", "emissive"};
+        const int attributeCount = sizeof(attributes) / sizeof(attributes[0]);
+        const int setsPerIteration = drawCount * attributeCount;
+        GLint value = 0;
+
+        // Prepare the prebuilt names and the handles once
+        std::vector<std::string> names;
+        std::vector<our::UniformHandle> handles;
+        for(int draw = 0; draw < drawCount; draw++){
+            for(auto attribute : attributes){
+                names.push_back(std::string("material.") + attribute);
+                handles.push_back(shader->getUniform(names.back()));
+            }
+        }
+
+        // The program is in use, so we can read its name back instead of exposing it from ShaderProgram
+        GLint program = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+        double driverLookup = measure(iterations, setsPerIteration, [&](){
+            for(auto& name : names)
+                glUniform1i(glGetUniformLocation((GLuint)program, name.c_str()), value);
+        });
+        double builtNames = measure(iterations, setsPerIteration, [&](){
+            for(int draw = 0; draw < drawCount; draw++){
+                std::string prefix = "material.";
+                for(auto attribute : attributes)
+                    shader->set(prefix + attribute, value);
+            }
+        });
+        double cachedNames = measure(iterations, setsPerIteration, [&](){
+            for(auto& name : names)
+                shader->set(name, value);
+        });
+        double handleSets = measure(iterations, setsPerIteration, [&](){
+            for(auto handle : handles)
+                shader->set(handle, value);
+        });
+
+        std::cout << "Uniform benchmark (" << iterations << " iterations x " << setsPerIteration << " sets, "
+                  << shader->getCachedUniformCount() << " cached uniforms)" << std::endl;
+        std::cout << "  glGetUniformLocation per set : " << driverLookup << " ns/set" << std::endl;
+        std::cout << "  built name + cached lookup   : " << builtNames << " ns/set" << std::endl;
+        std::cout << "  prebuilt name + cached lookup: " << cachedNames << " ns/set" << std::endl;
+        std::cout << "  uniform handle               : " << handleSets << " ns/set" << std::endl;
+
+        // The benchmark is done, no need to keep the window open
+        getApp()->close();
+    }
+
+    void onDraw(double deltaTime) override {
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+
+    void onDestroy() override {
+        delete shader;
+    }
+};
@@ -0,0 +1,52 @@
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <flags/flags.h>
+
+#include <mesh/mesh-utils.hpp>
+
+// The mesh converter writes the binary cache (see "common/mesh/mesh-cache.hpp") of every ".obj" model in a directory ahead of time,
+// so the first launch of the game does not have to parse the models either.
+// Usage: MESH_CONVERTER [-d <directory>] [--force]
+//      -d: the directory that is searched (recursively) for models. Default: "assets/models"
+//      --force: rewrites the caches that are already up to date
+int main(int argc, char** argv) {
+
+    flags::args args(argc, argv);
+    std::string directory = args.get<std::string>("d", "assets/models");
+    bool force = args.get<bool>("force", false);
+
+    std::error_code error;
+    if(!std::filesystem::is_directory(directory, error)){
+        std::cerr << "Couldn't find the directory: " << directory << std::endl;
+        return -1;
+    }
+
+    int converted = 0, skipped = 0, failed = 0;
+    for(const auto& entry : std::filesystem::recursive_directory_iterator(directory)){
+        if(!entry.is_regular_file() || entry.path().extension() != ".obj") continue;
+        std::string path = entry.path().generic_string();
+
+        std::vector<our::Vertex> vertices;
+        std::vector<GLuint> elements;
+        std::vector<our::Submesh> submeshes;
+        // A cache that can be read is up to date with its source
+        if(!force && our::mesh_cache::read(path, vertices, elements)){
+            skipped++;
+            continue;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        if(!our::mesh_utils::parseOBJ(path, vertices, elements, &submeshes) || !our::mesh_cache::write(path, vertices, elements, submeshes)){
+            failed++;
+            continue;
+        }
+        double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        std::cout << path << " -> " << our::mesh_cache::getPath(path) << " (" << vertices.size() << " vertices, "
+                  << elements.size() << " elements, " << submeshes.size() << " submeshes, " << time << " ms)" << std::endl;
+        converted++;
+    }
+
+    std::cout << "Converted " << converted << " models (" << skipped << " up to date, " << failed << " failed)" << std::endl;
+    return failed == 0 ? 0 : -1;
+}
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <filesystem>
+#include <chrono>
+#include <cmath>
+#include <flags/flags.h>
+
+#include <thread-pool.hpp>
+#include <texture/texture-utils.hpp>
+#include <texture/texture-compression.hpp>
+
+// The texture cooker compresses every image in a directory into a cooked texture (see "common/texture/texture-compression.hpp")
+// with its whole mip chain, so the game uploads block compressed textures instead of decoding the images at runtime.
+// Usage: TEXTURE_COOKER [-d <directory>] [-f <format>] [--force]
+//      -d: the directory that is searched (recursively) for ".png", ".jpg" & ".jpeg" images. Default: "assets/textures"
+//      -f: the format of the cooked textures: "bc1", "bc3", "bc7" or "auto" (BC3 for images with transparent pixels, BC1 otherwise). Default: "auto"
+//      --force: cooks the textures that are already up to date
+int main(int argc, char** argv) {
+
+    flags::args args(argc, argv);
+    std::string directory = args.get<std::string>("d", "assets/textures");
+    std::string formatName = args.get<std::string>("f", "auto");
+    bool force = args.get<bool>("force", false);
+
+    bool automatic = formatName == "auto";
+    our::CompressedFormat requestedFormat = our::CompressedFormat::BC1;
+    if(!automatic && (!our::texture_compression::parseFormatName(formatName, requestedFormat) || requestedFormat == our::CompressedFormat::RGBA8)){
+        std::cerr << "Unknown format: " << formatName << " (expected auto, bc1, bc3 or bc7)" << std::endl;
+        return -1;
+    }
+
+    std::error_code error;
+    if(!std::filesystem::is_directory(directory, error)){
+        std::cerr << "Couldn't find the directory: " << directory << std::endl;
+        return -1;
+    }
+
+    // The blocks of every level are compressed on all the cores
+    our::ThreadPool pool;
+
+    int cooked = 0, skipped = 0, failed = 0;
+    for(const auto& entry : std::filesystem::recursive_directory_iterator(directory)){
+        if(!entry.is_regular_file()) continue;
+        std::string extension = entry.path().extension().string();
+        if(extension != ".png" && extension != ".jpg" && extension != ".jpeg") continue;
+        std::string path = entry.path().generic_string();
+
+        // A cooked texture that can be read is up to date with its source
+        our::CompressedImage existing;
+        if(!force && our::texture_compression::read(path, existing)){
+            skipped++;
+            continue;
+        }
+
+        // The encoders read RGBA pixels
+        our::texture_utils::Image image;
+        if(!our::texture_utils::decodeImage(path, image, 4)){
+            failed++;
+            continue;
+        }
+        const uint8_t* pixels = image.pixels.get();
+        our::CompressedFormat format = requestedFormat;
+        if(automatic) format = our::texture_compression::hasAlpha(pixels, image.size) ? our::CompressedFormat::BC3 : our::CompressedFormat::BC1;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        our::CompressedImage compressed = our::texture_compression::compress(pixels, image.size, format, true, &pool);
+        double time = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+        if(!our::texture_compression::write(path, compressed)){
+            failed++;
+            continue;
+        }
+
+        // The quality of the first level (the PSNR of the decompressed pixels, higher is better, above 35 dB is usually hard to tell apart)
+        std::vector<uint8_t> decompressed = our::texture_compression::decompressLevel(format, image.size, compressed.levels[0]);
+        double squaredError = 0;
+        for(size_t index = 0; index < decompressed.size(); index++){
+            double difference = (double)decompressed[index] - pixels[index];
+            squaredError += difference * difference;
+        }
+        double meanSquaredError = squaredError / std::max<size_t>(decompressed.size(), 1);
+        double psnr = meanSquaredError > 0 ? 10.0 * std::log10(255.0 * 255.0 / meanSquaredError) : INFINITY;
+
+        size_t sourceBytes = (size_t)image.size.x * image.size.y * 4;
+        std::cout << path << " -> " << our::texture_compression::getPath(path) << " (" << our::texture_compression::getFormatName(format) << ", "
+                  << image.size.x << "x" << image.size.y << ", " << compressed.levels.size() << " levels, " << compressed.getByteCount() / 1024
+                  << " KB instead of " << sourceBytes * 4 / 3 / 1024 << " KB, " << psnr << " dB, " << time << " ms)" << std::endl;
+        cooked++;
+    }
+
+    std::cout << "Cooked " << cooked << " textures (" << skipped << " up to date, " << failed << " failed)" << std::endl;
+    return failed == 0 ? 0 : -1;
+}